@@ -5,8 +5,30 @@
 // last update: 14.08.2022
 //----------------------------------//
 
+#ifndef ADSR
+#define ADSR
+
 // Use Arduino timing functions internally
+#if defined(ARDUINO)
 #include "Arduino.h"
+#else
+// Host builds (benchmarks, offline tools): provide the few Arduino bits used here
+#include <stddef.h>
+#include <stdint.h>
+#include <math.h>
+#include <chrono>
+
+inline unsigned long micros()
+{
+    static const std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+    return (unsigned long)std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - t0).count();
+}
+
+inline unsigned long millis()
+{
+    return micros() / 1000UL;
+}
+#endif
 
 // Select timebase:
 // 1 -> use micros() internally (high resolution)
@@ -14,288 +36,1959 @@
 #ifndef ADSR_BEZIER_USE_MICROS
 #define ADSR_BEZIER_USE_MICROS 1
 #endif
-// #include <math.h>
+// #include <math.h>
+
+// for array for lookup table
+#ifndef ARRAY_SIZE
+#define ARRAY_SIZE 1024
+#endif
+
+// Element type of the curve tables. Must hold maxVal of the generated tables:
+// int (default, the original layout), uint16_t up to 65535 at half the memory,
+// uint8_t for low-resolution targets (maxVal <= 255).
+#ifndef ADSR_BEZIER_TABLE_T
+#define ADSR_BEZIER_TABLE_T int
+#endif
+
+// Table lookup:
+// 0 -> nearest lower table entry (truncated index)
+// 1 -> keep ADSR_BEZIER_FRAC_BITS of the time->index product and blend the two
+//      neighbouring entries in fixed point, so much smaller tables stay accurate
+#ifndef ADSR_BEZIER_INTERPOLATE
+#define ADSR_BEZIER_INTERPOLATE 0
+#endif
+#if ADSR_BEZIER_INTERPOLATE
+#ifndef ADSR_BEZIER_FRAC_BITS
+#define ADSR_BEZIER_FRAC_BITS 8
+#endif
+#else
+#undef ADSR_BEZIER_FRAC_BITS
+#define ADSR_BEZIER_FRAC_BITS 0
+#endif
+
+// Stages up to this length (in internal ticks) use a Q24 time scale, longer ones Q40
+#ifndef ADSR_BEZIER_Q24_MAX_TICKS
+#if ADSR_BEZIER_USE_MICROS
+#define ADSR_BEZIER_Q24_MAX_TICKS 2000000UL // 2 seconds in µs
+#else
+#define ADSR_BEZIER_Q24_MAX_TICKS 2000UL    // 2 seconds in ms
+#endif
+#endif
+
+// Exponential mode (adsr constructed with exponential = true): table-free
+// one-pole curves, one multiply and add per step. getWave() / renderBlock()
+// step the recurrence every ADSR_BEZIER_EXP_STEP_TICKS ticks (tick() once per
+// call). ADSR_BEZIER_EXP_ONLY 1 forces exponential mode for every adsr and
+// leaves the curve tables out of the build (AdsrBank needs them).
+#ifndef ADSR_BEZIER_EXP_STEP_TICKS
+#if ADSR_BEZIER_USE_MICROS
+#define ADSR_BEZIER_EXP_STEP_TICKS 20UL     // 50 kHz
+#else
+#define ADSR_BEZIER_EXP_STEP_TICKS 1UL      // 1 kHz
+#endif
+#endif
+#ifndef ADSR_BEZIER_EXP_ONLY
+#define ADSR_BEZIER_EXP_ONLY 0
+#endif
+
+// Instrumentation counters (see adsr::getStats()):
+// 0 -> compiled out (default)
+// 1 -> every adsr counts samples per phase, phase changes, slow-path samples,
+//      clamped outputs, retriggers, noteOff() underflows and selections of
+//      curves left out of ADSR_BEZIER_CURVE_MASK.
+//      ADSR_BEZIER_STATS_GLOBAL 1 also sums them over all instances
+//      (adsrStatsGlobal(); plain counters, so render from one thread or set 0),
+//      ADSR_BEZIER_STATS_CYCLES N (power of two) times every Nth getWave() /
+//      tick() with ADSR_BEZIER_STATS_CLOCK()
+#ifndef ADSR_BEZIER_STATS
+#define ADSR_BEZIER_STATS 0
+#endif
+#ifndef ADSR_BEZIER_STATS_GLOBAL
+#define ADSR_BEZIER_STATS_GLOBAL 1
+#endif
+#ifndef ADSR_BEZIER_STATS_CYCLES
+#define ADSR_BEZIER_STATS_CYCLES 0
+#endif
+
+// Trace recording (see adsr::setTrace() and ADSR_Bezier_Trace.h):
+// 0 -> compiled out (default)
+// 1 -> an adsr with a trace sink logs its note events, setters and outputs as
+//      16-byte AdsrTraceRecords, with a keyframe of its whole state every
+//      1024 events (by default), for replay on a host
+#ifndef ADSR_BEZIER_TRACE
+#define ADSR_BEZIER_TRACE 0
+#endif
+
+// Gain kernels of applyBlock() (envelope x signal buffer):
+// ADSR_BEZIER_GAIN_SIMD 1 (default on x86-64 hosts with SSE4.1 or AVX2) uses
+// SIMD loops, 0 the scalar ones (same results). ADSR_BEZIER_GAIN_CHUNK levels
+// are rendered at a time into a stack buffer.
+#ifndef ADSR_BEZIER_GAIN_SIMD
+#if defined(__x86_64__) && (defined(__AVX2__) || defined(__SSE4_1__))
+#define ADSR_BEZIER_GAIN_SIMD 1
+#else
+#define ADSR_BEZIER_GAIN_SIMD 0
+#endif
+#endif
+#ifndef ADSR_BEZIER_GAIN_CHUNK
+#define ADSR_BEZIER_GAIN_CHUNK 64
+#endif
+#if ADSR_BEZIER_GAIN_SIMD
+#include <immintrin.h>
+#endif
+
+// Largest control-rate decimation of renderBlockDecimated() (a power of two)
+#ifndef ADSR_BEZIER_RAMP_MAX
+#define ADSR_BEZIER_RAMP_MAX 256
+#endif
+
+// number of time points
+// #define ATTACK_ALPHA 0.997                  // varies between 0.9 (steep curve) and 0.9995 (straight line)
+// #define ATTACK_DECAY_RELEASE 0.997          // fits to ARRAY_SIZE 1024
+
+// #define ARRAY_SIZE 1024                   // number of time points
+// #define ATTACK_ALPHA 0.9975           // varies between 0.9 (steep curve) and 0.9995 (straight line)
+// #define ATTACK_DECAY_RELEASE 0.9975
+
+// Curve tables:
+// 0 -> tables live in RAM and are filled at startup by adsrBezierInitTables()
+// 1 -> tables are generated at compile time into read-only storage (needs C++14).
+//      ADSR_BEZIER_TABLE_MAX_VALUE sets maxVal, ADSR_BEZIER_CURVE_MASK selects the curves
+//      compiled in (bit i -> curve i); unused curve indices read the lowest compiled-in curve
+//      (check with adsrBezierCurveCompiled(), counted in AdsrStats::missing_curves).
+#ifndef ADSR_BEZIER_CONSTEXPR_TABLES
+#define ADSR_BEZIER_CONSTEXPR_TABLES 0
+#endif
+#ifndef ADSR_BEZIER_TABLE_MAX_VALUE
+#define ADSR_BEZIER_TABLE_MAX_VALUE 4095
+#endif
+#ifndef ADSR_BEZIER_CURVE_MASK
+#define ADSR_BEZIER_CURVE_MASK 0xFF
+#endif
+
+// Control points of the curves (built-in and user-defined):
+// 0 -> used as given, in table units (original behaviour, default)
+// 1 -> given in a 0..4095 design space and scaled to the maxVal of the tables, so
+//      every curve keeps its shape at any resolution. Changes every table whose
+//      maxVal is not 4095; use it for uint8_t tables (maxVal <= 255).
+#ifndef ADSR_BEZIER_SCALE_CONTROL_POINTS
+#define ADSR_BEZIER_SCALE_CONTROL_POINTS 0
+#endif
+
+#if __cplusplus >= 201402L
+#define ADSR_BEZIER_CONSTEXPR14 constexpr
+#else
+#define ADSR_BEZIER_CONSTEXPR14 inline
+#if ADSR_BEZIER_CONSTEXPR_TABLES
+#error "ADSR_BEZIER_CONSTEXPR_TABLES requires C++14 or newer"
+#endif
+#endif
+
+#if ADSR_BEZIER_EXP_ONLY && ADSR_BEZIER_CONSTEXPR_TABLES
+#error "ADSR_BEZIER_EXP_ONLY builds have no curve tables"
+#endif
+
+// ---------------------------------------------------------------------------
+// Bézier table generation helpers
+// ---------------------------------------------------------------------------
+
+typedef ADSR_BEZIER_TABLE_T adsr_curve_t;
+
+// Lightweight point type used for table generation
+struct ADSRBezierPoint
+{
+    float x, y;
+};
+
+// Control points of the 8 built-in curves, designed for maxVal 4095
+ADSR_BEZIER_CONSTEXPR14 ADSRBezierPoint adsrBezierControlP1(int curve)
+{
+    const ADSRBezierPoint P1[8] = {
+        {250.0f, 1500.0f}, {840.0f, 1780.0f}, {400.0f, 430.0f},  {2170.0f, 3610.0f},
+        {400.0f, 1380.0f}, {1140.0f, 3750.0f}, {200.0f, 2700.0f}, {0.0f, 4095.0f}};
+    return P1[curve];
+}
+
+ADSR_BEZIER_CONSTEXPR14 ADSRBezierPoint adsrBezierControlP2(int curve)
+{
+    const ADSRBezierPoint P2[8] = {
+        {1500.0f, 250.0f}, {1160.0f, 210.0f}, {920.0f, 420.0f},  {3730.0f, 2610.0f},
+        {3830.0f, 2890.0f}, {1850.0f, 1080.0f}, {720.0f, 3050.0f}, {4095.0f, 0.0f}};
+    return P2[curve];
+}
+
+// Control point in table units for tables of maxVal (ADSR_BEZIER_SCALE_CONTROL_POINTS)
+ADSR_BEZIER_CONSTEXPR14 ADSRBezierPoint adsrBezierControlPoint(ADSRBezierPoint p, float maxVal)
+{
+#if ADSR_BEZIER_SCALE_CONTROL_POINTS
+    return ADSRBezierPoint{p.x * (maxVal / 4095.0f), p.y * (maxVal / 4095.0f)};
+#else
+    (void)maxVal;
+    return p;
+#endif
+}
+
+// Evaluate a cubic Bézier at parameter t in [0, 1]
+ADSR_BEZIER_CONSTEXPR14 ADSRBezierPoint adsrBezierCubic(const ADSRBezierPoint &A,
+                                                        const ADSRBezierPoint &P1,
+                                                        const ADSRBezierPoint &P2,
+                                                        const ADSRBezierPoint &B,
+                                                        float t)
+{
+    float one_minus_t = 1.0f - t;
+    float one_minus_t_squared = one_minus_t * one_minus_t;
+    float t_squared = t * t;
+
+    float x = one_minus_t_squared * one_minus_t * A.x +
+              3.0f * one_minus_t_squared * t * P1.x +
+              3.0f * one_minus_t * t_squared * P2.x +
+              t_squared * t * B.x;
+
+    float y = one_minus_t_squared * one_minus_t * A.y +
+              3.0f * one_minus_t_squared * t * P1.y +
+              3.0f * one_minus_t * t_squared * P2.y +
+              t_squared * t * B.y;
+
+    return {x, y};
+}
+
+// Find y for a given x on the cubic Bézier using binary search on t
+ADSR_BEZIER_CONSTEXPR14 float adsrBezierFindYForX(const ADSRBezierPoint &A,
+                                                  const ADSRBezierPoint &P1,
+                                                  const ADSRBezierPoint &P2,
+                                                  const ADSRBezierPoint &B,
+                                                  float xTarget,
+                                                  float tol = 1e-5f)
+{
+    float tLow = 0.0f;
+    float tHigh = 1.0f;
+    float tMid = 0.0f;
+
+    while ((tHigh - tLow) > tol)
+    {
+        tMid = (tLow + tHigh) * 0.5f;
+        ADSRBezierPoint midPoint = adsrBezierCubic(A, P1, P2, B, tMid);
+        if (midPoint.x < xTarget)
+        {
+            tLow = tMid;
+        }
+        else
+        {
+            tHigh = tMid;
+        }
+    }
+
+    ADSRBezierPoint resultPoint = adsrBezierCubic(A, P1, P2, B, tMid);
+    return resultPoint.y;
+}
+
+// Table entry i of a built-in curve (same math as adsrBezierInitTables)
+ADSR_BEZIER_CONSTEXPR14 float adsrBezierCurveY(int curve, float maxVal, int numPoints, int i)
+{
+    ADSRBezierPoint A = {0.0f, maxVal};
+    ADSRBezierPoint B = {maxVal, 0.0f};
+    ADSRBezierPoint P1 = adsrBezierControlPoint(adsrBezierControlP1(curve), maxVal);
+    ADSRBezierPoint P2 = adsrBezierControlPoint(adsrBezierControlP2(curve), maxVal);
+    float multiplier = (float)(maxVal + 1.0f) / (float)(numPoints - 1);
+    return adsrBezierFindYForX(A, P1, P2, B, multiplier * (float)i);
+}
+
+// Saturate a rounded curve value into the table element type
+template <typename T>
+constexpr T adsrBezierToTable(int v)
+{
+    return v < 0 ? (T)0 : ((T)-1 > 0 && (unsigned long)v > (unsigned long)(T)-1) ? (T)-1 : (T)v;
+}
+
+#if !ADSR_BEZIER_EXP_ONLY
+
+// ---------------------------------------------------------------------------
+// Global Bézier lookup tables shared by all ADSR instances.
+// ARRAY_SIZE is provided by the including project before this header.
+// The storage is a static member of a class template so it can be defined in
+// this header and still be shared by every translation unit including it.
+// ---------------------------------------------------------------------------
+
+#if ADSR_BEZIER_CONSTEXPR_TABLES
+
+// roundf() that can run at compile time
+constexpr int adsrBezierRound(float v)
+{
+    return v >= 0.0f ? (int)(v + 0.5f) : -(int)(-v + 0.5f);
+}
+
+// One built-in curve generated at compile time. Only instantiated for the
+// curves selected by ADSR_BEZIER_CURVE_MASK.
+template <int Curve>
+struct ADSRBezierConstTable
+{
+    struct Data
+    {
+        adsr_curve_t v[ARRAY_SIZE];
+    };
+
+    static constexpr Data make()
+    {
+        Data d{};
+        for (int i = 0; i < ARRAY_SIZE; ++i)
+            d.v[i] = adsrBezierToTable<adsr_curve_t>(adsrBezierRound(adsrBezierCurveY(Curve, (float)ADSR_BEZIER_TABLE_MAX_VALUE, ARRAY_SIZE, i)));
+        return d;
+    }
+
+    static constexpr Data data = make();
+};
+
+template <int Curve>
+constexpr typename ADSRBezierConstTable<Curve>::Data ADSRBezierConstTable<Curve>::data;
+
+constexpr int adsrBezierFirstCurve(int mask, int i = 0)
+{
+    return (i >= 7 || ((mask >> i) & 1)) ? i : adsrBezierFirstCurve(mask, i + 1);
+}
+
+// Table used for curve index Curve: its own data if compiled in, otherwise the lowest compiled-in curve
+template <int Curve, bool Used = ((ADSR_BEZIER_CURVE_MASK >> Curve) & 1) != 0>
+struct ADSRBezierConstCurve
+{
+    static constexpr const adsr_curve_t *table() { return ADSRBezierConstTable<Curve>::data.v; }
+};
+
+template <int Curve>
+struct ADSRBezierConstCurve<Curve, false>
+{
+    static constexpr const adsr_curve_t *table() { return ADSRBezierConstTable<adsrBezierFirstCurve(ADSR_BEZIER_CURVE_MASK)>::data.v; }
+};
+
+template <typename T = void>
+struct ADSRBezierTableStorage
+{
+    static constexpr const adsr_curve_t *pointers[8] = {
+        ADSRBezierConstCurve<0>::table(), ADSRBezierConstCurve<1>::table(),
+        ADSRBezierConstCurve<2>::table(), ADSRBezierConstCurve<3>::table(),
+        ADSRBezierConstCurve<4>::table(), ADSRBezierConstCurve<5>::table(),
+        ADSRBezierConstCurve<6>::table(), ADSRBezierConstCurve<7>::table()};
+};
+
+template <typename T>
+constexpr const adsr_curve_t *ADSRBezierTableStorage<T>::pointers[8];
+
+static constexpr const adsr_curve_t *const (&_curve_tables)[8] = ADSRBezierTableStorage<>::pointers;
+
+#else
+
+template <typename T = void>
+struct ADSRBezierTableStorage
+{
+    static adsr_curve_t tables[8][ARRAY_SIZE];
+    static adsr_curve_t *pointers[8];
+};
+
+template <typename T>
+adsr_curve_t ADSRBezierTableStorage<T>::tables[8][ARRAY_SIZE];
+
+template <typename T>
+adsr_curve_t *ADSRBezierTableStorage<T>::pointers[8] = {
+    tables[0], tables[1], tables[2], tables[3],
+    tables[4], tables[5], tables[6], tables[7]};
+
+static constexpr adsr_curve_t (&_curve0_table)[ARRAY_SIZE] = ADSRBezierTableStorage<>::tables[0];
+static constexpr adsr_curve_t (&_curve1_table)[ARRAY_SIZE] = ADSRBezierTableStorage<>::tables[1];
+static constexpr adsr_curve_t (&_curve2_table)[ARRAY_SIZE] = ADSRBezierTableStorage<>::tables[2];
+static constexpr adsr_curve_t (&_curve3_table)[ARRAY_SIZE] = ADSRBezierTableStorage<>::tables[3];
+static constexpr adsr_curve_t (&_curve4_table)[ARRAY_SIZE] = ADSRBezierTableStorage<>::tables[4];
+static constexpr adsr_curve_t (&_curve5_table)[ARRAY_SIZE] = ADSRBezierTableStorage<>::tables[5];
+static constexpr adsr_curve_t (&_curve6_table)[ARRAY_SIZE] = ADSRBezierTableStorage<>::tables[6];
+static constexpr adsr_curve_t (&_curve7_table)[ARRAY_SIZE] = ADSRBezierTableStorage<>::tables[7];
+
+static constexpr adsr_curve_t *(&_curve_tables)[8] = ADSRBezierTableStorage<>::pointers;
+
+#endif
+
+// Whether curve index curveType has a table of its own. With compile-time
+// tables the indices left out of ADSR_BEZIER_CURVE_MASK do not: they read the
+// lowest compiled-in curve, and adsr counts their selection in missing_curves.
+constexpr bool adsrBezierCurveCompiled(uint8_t curveType)
+{
+#if ADSR_BEZIER_CONSTEXPR_TABLES
+    return curveType < 8 && ((ADSR_BEZIER_CURVE_MASK >> curveType) & 1) != 0;
+#else
+    return curveType < 8;
+#endif
+}
+
+#endif // !ADSR_BEZIER_EXP_ONLY
+
+// ---------------------------------------------------------------------------
+// Stage lookup helpers
+// Time->table position and table->value steps shared by every envelope type.
+// Positions are in 1/2^ADSR_BEZIER_FRAC_BITS table entries.
+// ---------------------------------------------------------------------------
+
+// Fixed-point scale for the time->index mapping of a stage. Stages up to
+// ADSR_BEZIER_Q24_MAX_TICKS use Q24, longer ones Q40, so every length keeps
+// enough scale bits and maps with one multiply and a shift, without a division.
+// Long stages are approximate: the truncated Q40 scale can put a lookup one
+// entry before the exact division the 1.2 releases used (+-1 LSB of output).
+inline uint64_t adsrStageScale(unsigned long ticks, int numPoints = ARRAY_SIZE)
+{
+    if (ticks == 0)
+        return 0;
+    if (ticks <= ADSR_BEZIER_Q24_MAX_TICKS)
+        return (((uint64_t)(numPoints - 1)) << 24) / (uint64_t)ticks;
+    return (((uint64_t)(numPoints - 1)) << 40) / (uint64_t)ticks;
+}
+
+// Right shift taking delta * scale to a table position
+inline unsigned adsrStageShift(unsigned long duration)
+{
+    return duration <= ADSR_BEZIER_Q24_MAX_TICKS ? 24 - ADSR_BEZIER_FRAC_BITS : 40 - ADSR_BEZIER_FRAC_BITS;
+}
+
+// Last table position
+inline uint32_t adsrStagePositionMax(int numPoints = ARRAY_SIZE)
+{
+    return (uint32_t)(numPoints - 1) << ADSR_BEZIER_FRAC_BITS;
+}
+
+// Table position delta ticks into a running stage (delta < duration).
+// delta * scale stays below (numPoints - 1) << 40, so the product never overflows.
+inline uint32_t adsrStagePosition(unsigned long delta, unsigned long duration, uint64_t scale, int numPoints = ARRAY_SIZE)
+{
+    uint32_t pos = (uint32_t)(((uint64_t)delta * scale) >> adsrStageShift(duration));
+    if (pos > adsrStagePositionMax(numPoints))
+        pos = adsrStagePositionMax(numPoints);
+    return pos;
+}
+
+// Curve value at a table position
+template <typename T>
+inline int adsrCurveLookup(const T *table, uint32_t pos, int numPoints = ARRAY_SIZE)
+{
+#if ADSR_BEZIER_INTERPOLATE
+    uint32_t idx = pos >> ADSR_BEZIER_FRAC_BITS;
+    int32_t frac = (int32_t)(pos & ((1UL << ADSR_BEZIER_FRAC_BITS) - 1));
+    int32_t a = table[idx];
+    if (frac == 0 || idx >= (uint32_t)(numPoints - 1))
+        return (int)a;
+    int32_t b = table[idx + 1];
+    return (int)(a + (((b - a) * frac) >> ADSR_BEZIER_FRAC_BITS));
+#else
+    (void)numPoints;
+    return table[pos];
+#endif
+}
+
+// Morph weight (Q15, 0..ADSR_MORPH_ONE) for an amount 0..65535:
+// 0 -> first curve, 65535 -> second curve
+static constexpr int32_t ADSR_MORPH_ONE = 32768;
+
+inline int32_t adsrMorphWeight(uint16_t amount)
+{
+    return ((int32_t)amount + 1) >> 1;
+}
+
+// Blend of two curve tables at one position, weight in Q15. Weight 0 reads
+// only table a; ADSR_MORPH_ONE returns table b exactly.
+template <typename T>
+inline int adsrCurveLookupMorph(const T *a, const T *b, uint32_t pos, int32_t weight, int numPoints = ARRAY_SIZE)
+{
+    int32_t va = adsrCurveLookup(a, pos, numPoints);
+    if (weight == 0)
+        return (int)va;
+    int32_t vb = adsrCurveLookup(b, pos, numPoints);
+    return (int)(va + (((vb - va) * weight) >> 15));
+}
+
+// Delta into a stage of new_duration at the same table position as delta
+// into a running stage of old_duration (delta < old_duration): changing a
+// stage time while it runs keeps the output continuous. Multiplies only.
+inline unsigned long adsrStageRescale(unsigned long delta, unsigned long old_duration, uint64_t old_scale, unsigned long new_duration)
+{
+    // Position with 16 extra fraction bits, then its Q32 fraction of the last position
+    static constexpr uint64_t recip = ((uint64_t)1 << 32) / ((uint64_t)(ARRAY_SIZE - 1) << ADSR_BEZIER_FRAC_BITS);
+    unsigned shift = adsrStageShift(old_duration);
+    uint64_t product = (uint64_t)delta * old_scale;
+    uint64_t pos16 = shift >= 16 ? product >> (shift - 16) : product << (16 - shift);
+    uint64_t frac = (pos16 * recip) >> 16;
+    if (frac > 0xFFFFFFFFULL)
+        frac = 0xFFFFFFFFULL;
+    return (unsigned long)((frac * new_duration) >> 32);
+}
+
+// Reciprocal of the vertical resolution for adsrRangeScaleQ16(), computed once
+inline uint32_t adsrRangeReciprocal(int vertical_resolution)
+{
+    return vertical_resolution > 0 ? 0xFFFFFFFFUL / (uint32_t)vertical_resolution : 0;
+}
+
+// Q16 output range scale (range << 16) / vertical_resolution without a
+// division: the reciprocal product is exact or slightly low, and a compare
+// corrects it (at most once for resolutions below 65536)
+inline int32_t adsrRangeScaleQ16(int32_t range, int vertical_resolution, uint32_t recip)
+{
+    if (range <= 0 || vertical_resolution <= 0)
+        return 0;
+    uint64_t target = (uint64_t)range << 16;
+    uint64_t q = ((uint64_t)(uint32_t)range * recip) >> 16;
+    while ((q + 1) * (uint32_t)vertical_resolution <= target)
+        q++;
+    return (int32_t)q;
+}
+
+// Curve value 0..65535 scaled by a Q16 range scale 0..65536. Both are never
+// negative, so the product (< 2^32) is exact in 32 unsigned bits: no 64-bit
+// multiply, and no int32 overflow for curve values above 32767
+constexpr int32_t adsrRangeMapQ16(int32_t curveVal, int32_t range_q16)
+{
+    return (int32_t)(((uint32_t)curveVal * (uint32_t)range_q16) >> 16);
+}
+
+// ---------------------------------------------------------------------------
+// Gain kernels
+// Envelope level -> Q15 gain and the buffer x gain loops of adsr::applyBlock().
+// Rounded to nearest: int16_t / int32_t y = (x * g + 2^14) >> 15,
+// float y = x * (g / 2^15). The SIMD loops give the same results.
+// ---------------------------------------------------------------------------
+
+// Gain of a full-level envelope (unity)
+static constexpr int32_t ADSR_GAIN_ONE = 32768;
+
+// Multiplier for adsrGainQ15(): ceil(2^31 / vertical_resolution), computed once
+inline uint32_t adsrGainReciprocal(int vertical_resolution)
+{
+    return vertical_resolution > 0 ? (uint32_t)((0x80000000ULL + (uint32_t)vertical_resolution - 1) / (uint32_t)vertical_resolution) : 0;
+}
+
+// Q15 gain of a level 0..vertical_resolution (up to 65535): 0 -> 0 and
+// vertical_resolution -> ADSR_GAIN_ONE exactly, one multiply and shift
+inline int32_t adsrGainQ15(int level, uint32_t recip)
+{
+    return (int32_t)(((uint32_t)level * recip) >> 16);
+}
+
+inline int16_t adsrGainSample(int16_t x, int32_t gain)
+{
+    return (int16_t)((x * gain + (1 << 14)) >> 15);
+}
+
+inline int32_t adsrGainSample(int32_t x, int32_t gain)
+{
+    return (int32_t)(((int64_t)x * gain + (1 << 14)) >> 15);
+}
+
+inline float adsrGainSample(float x, int32_t gain)
+{
+    return x * ((float)gain * (1.0f / 32768.0f));
+}
+
+#if ADSR_BEZIER_GAIN_SIMD
+// 4 gains from 4 levels (levels * recip < 2^32, so the low product half is exact)
+inline __m128i adsrGainQ15x4(const int *levels, __m128i recip)
+{
+    return _mm_srli_epi32(_mm_mullo_epi32(_mm_loadu_si128((const __m128i *)levels), recip), 16);
+}
+
+// (x * g + 2^14) >> 15 for full int32 x with 32-bit multiplies:
+// x = hi * 2^15 + lo, so the result is hi * g + ((lo * g + 2^14) >> 15)
+inline __m128i adsrGainMul32x4(__m128i x, __m128i g)
+{
+    __m128i hi = _mm_mullo_epi32(_mm_srai_epi32(x, 15), g);
+    __m128i lo = _mm_mullo_epi32(_mm_and_si128(x, _mm_set1_epi32(0x7FFF)), g);
+    return _mm_add_epi32(hi, _mm_srli_epi32(_mm_add_epi32(lo, _mm_set1_epi32(1 << 14)), 15));
+}
+
+#if defined(__AVX2__)
+inline __m256i adsrGainQ15x8(const int *levels, __m256i recip)
+{
+    return _mm256_srli_epi32(_mm256_mullo_epi32(_mm256_loadu_si256((const __m256i *)levels), recip), 16);
+}
+
+inline __m256i adsrGainMul32x8(__m256i x, __m256i g)
+{
+    __m256i hi = _mm256_mullo_epi32(_mm256_srai_epi32(x, 15), g);
+    __m256i lo = _mm256_mullo_epi32(_mm256_and_si256(x, _mm256_set1_epi32(0x7FFF)), g);
+    return _mm256_add_epi32(hi, _mm256_srli_epi32(_mm256_add_epi32(lo, _mm256_set1_epi32(1 << 14)), 15));
+}
+#endif
+#endif
+
+// buf[i] = buf[i] x gain of levels[i]
+inline void adsrGainApply(int16_t *buf, const int *levels, size_t n, uint32_t recip)
+{
+    size_t i = 0;
+#if ADSR_BEZIER_GAIN_SIMD
+#if defined(__AVX2__)
+    const __m256i recip8 = _mm256_set1_epi32((int)recip);
+    const __m256i round8 = _mm256_set1_epi32(1 << 14);
+    for (; i + 8 <= n; i += 8)
+    {
+        __m256i x = _mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i *)(buf + i)));
+        __m256i y = _mm256_srai_epi32(_mm256_add_epi32(_mm256_mullo_epi32(x, adsrGainQ15x8(levels + i, recip8)), round8), 15);
+        _mm_storeu_si128((__m128i *)(buf + i), _mm_packs_epi32(_mm256_castsi256_si128(y), _mm256_extracti128_si256(y, 1)));
+    }
+#endif
+    const __m128i recip4 = _mm_set1_epi32((int)recip);
+    const __m128i round4 = _mm_set1_epi32(1 << 14);
+    for (; i + 4 <= n; i += 4)
+    {
+        __m128i x = _mm_cvtepi16_epi32(_mm_loadl_epi64((const __m128i *)(buf + i)));
+        __m128i y = _mm_srai_epi32(_mm_add_epi32(_mm_mullo_epi32(x, adsrGainQ15x4(levels + i, recip4)), round4), 15);
+        _mm_storel_epi64((__m128i *)(buf + i), _mm_packs_epi32(y, y));
+    }
+#endif
+    for (; i < n; ++i)
+        buf[i] = adsrGainSample(buf[i], adsrGainQ15(levels[i], recip));
+}
+
+inline void adsrGainApply(int32_t *buf, const int *levels, size_t n, uint32_t recip)
+{
+    size_t i = 0;
+#if ADSR_BEZIER_GAIN_SIMD
+#if defined(__AVX2__)
+    const __m256i recip8 = _mm256_set1_epi32((int)recip);
+    for (; i + 8 <= n; i += 8)
+    {
+        __m256i x = _mm256_loadu_si256((const __m256i *)(buf + i));
+        _mm256_storeu_si256((__m256i *)(buf + i), adsrGainMul32x8(x, adsrGainQ15x8(levels + i, recip8)));
+    }
+#endif
+    const __m128i recip4 = _mm_set1_epi32((int)recip);
+    for (; i + 4 <= n; i += 4)
+    {
+        __m128i x = _mm_loadu_si128((const __m128i *)(buf + i));
+        _mm_storeu_si128((__m128i *)(buf + i), adsrGainMul32x4(x, adsrGainQ15x4(levels + i, recip4)));
+    }
+#endif
+    for (; i < n; ++i)
+        buf[i] = adsrGainSample(buf[i], adsrGainQ15(levels[i], recip));
+}
+
+inline void adsrGainApply(float *buf, const int *levels, size_t n, uint32_t recip)
+{
+    size_t i = 0;
+#if ADSR_BEZIER_GAIN_SIMD
+#if defined(__AVX2__)
+    const __m256i recip8 = _mm256_set1_epi32((int)recip);
+    const __m256 unit8 = _mm256_set1_ps(1.0f / 32768.0f);
+    for (; i + 8 <= n; i += 8)
+    {
+        __m256 g = _mm256_mul_ps(_mm256_cvtepi32_ps(adsrGainQ15x8(levels + i, recip8)), unit8);
+        _mm256_storeu_ps(buf + i, _mm256_mul_ps(_mm256_loadu_ps(buf + i), g));
+    }
+#endif
+    const __m128i recip4 = _mm_set1_epi32((int)recip);
+    const __m128 unit4 = _mm_set1_ps(1.0f / 32768.0f);
+    for (; i + 4 <= n; i += 4)
+    {
+        __m128 g = _mm_mul_ps(_mm_cvtepi32_ps(adsrGainQ15x4(levels + i, recip4)), unit4);
+        _mm_storeu_ps(buf + i, _mm_mul_ps(_mm_loadu_ps(buf + i), g));
+    }
+#endif
+    for (; i < n; ++i)
+        buf[i] = adsrGainSample(buf[i], adsrGainQ15(levels[i], recip));
+}
+
+// buf[i] = buf[i] x gain: unity leaves buf untouched, 0 writes zeros
+template <typename T>
+inline void adsrGainApplyConstant(T *buf, size_t n, int32_t gain)
+{
+    if (gain == ADSR_GAIN_ONE)
+        return;
+    if (gain == 0)
+    {
+        for (size_t i = 0; i < n; ++i)
+            buf[i] = 0;
+        return;
+    }
+    for (size_t i = 0; i < n; ++i)
+        buf[i] = adsrGainSample(buf[i], gain);
+}
+
+// Stage times for modulation (LFO, CC, velocity, ...): Steps + 1 log-spaced
+// times from min_ms to max_ms with their time->index scales, computed once
+// (float math and divisions) in the constructor. lookup() maps a 16-bit
+// control value to a time by interpolating the two neighbouring entries,
+// with one table read and a few multiplies, so adsr::modAttack() and friends
+// can change a stage time every control tick without dividing.
+// Entry i sits at value i * 65536 / Steps: 0 maps to min_ms, 65535 to max_ms.
+template <size_t Steps = 256>
+class AdsrTimeTable
+{
+public:
+    static_assert(Steps >= 1 && Steps <= 65536 && (Steps & (Steps - 1)) == 0, "Steps must be a power of two up to 65536");
+
+    AdsrTimeTable(float min_ms, float max_ms)
+    {
+#if ADSR_BEZIER_USE_MICROS
+        const float ticks_per_ms = 1000.0f;
+#else
+        const float ticks_per_ms = 1.0f;
+#endif
+        float lo = min_ms * ticks_per_ms;
+        float hi = max_ms * ticks_per_ms;
+        if (lo < 1.0f)
+            lo = 1.0f;
+        if (hi < lo)
+            hi = lo;
+
+        float log_ratio = logf(hi / lo) * (65536.0f / 65535.0f);
+        for (size_t i = 0; i <= Steps; ++i)
+        {
+            unsigned long ticks = (unsigned long)(lo * expf(log_ratio * (float)i / (float)Steps) + 0.5f);
+            if (ticks < 1)
+                ticks = 1;
+            _ticks[i] = ticks;
+            _scale[i] = ((uint64_t)(ARRAY_SIZE - 1) << 40) / (uint64_t)ticks;
+        }
+    }
+
+    // Stage time (ticks) and its adsrStageScale() for a control value
+    void lookup(uint16_t value, unsigned long &ticks, uint64_t &scale) const
+    {
+        uint32_t pos = (uint32_t)value * (uint32_t)Steps;
+        size_t i = pos >> 16;
+        uint32_t frac = pos & 0xFFFF;
+
+        ticks = _ticks[i] + (unsigned long)(((uint64_t)(_ticks[i + 1] - _ticks[i]) * frac) >> 16);
+        uint64_t scale40 = _scale[i] - ((_scale[i] - _scale[i + 1]) >> 16) * frac;
+        scale = ticks <= ADSR_BEZIER_Q24_MAX_TICKS ? scale40 >> 16 : scale40;
+    }
+
+    unsigned long ticks(uint16_t value) const
+    {
+        unsigned long t;
+        uint64_t scale;
+        lookup(value, t, scale);
+        return t;
+    }
+
+    static constexpr size_t steps() { return Steps; }
+
+private:
+    unsigned long _ticks[Steps + 1];
+    uint64_t _scale[Steps + 1]; // Q40
+};
+
+// ---------------------------------------------------------------------------
+// Instrumentation (ADSR_BEZIER_STATS)
+// ---------------------------------------------------------------------------
+
+#if ADSR_BEZIER_STATS
+
+#include <stdio.h>
+
+#if ADSR_BEZIER_STATS_CYCLES
+#if (ADSR_BEZIER_STATS_CYCLES & (ADSR_BEZIER_STATS_CYCLES - 1)) != 0
+#error "ADSR_BEZIER_STATS_CYCLES must be a power of two"
+#endif
+// Free-running 32-bit counter: TSC on x86 hosts, DWT->CYCCNT on Cortex-M3/M4/M7/M33
+// (enable it first), micros() elsewhere (RP2040). Define your own to override.
+#ifndef ADSR_BEZIER_STATS_CLOCK
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define ADSR_BEZIER_STATS_CLOCK() ((uint32_t)__rdtsc())
+#elif defined(__ARM_ARCH_7M__) || defined(__ARM_ARCH_7EM__) || defined(__ARM_ARCH_8M_MAIN__)
+#define ADSR_BEZIER_STATS_CLOCK() (*(volatile uint32_t *)0xE0001004UL)
+#else
+#define ADSR_BEZIER_STATS_CLOCK() ((uint32_t)micros())
+#endif
+#endif
+#endif
+
+struct AdsrStats
+{
+    uint32_t calls[5];       // samples computed per phase, indexed by adsr::ADSRPhase
+    uint32_t transitions;    // phase changes
+    uint32_t slow_path;      // samples on the Q40 stage mapping, exponential catch-ups after a gap
+    uint32_t clamps;         // outputs clamped to 0 or vertical_resolution
+    uint32_t retriggers;     // noteOn() while the envelope was not idle
+    uint32_t underflows;     // noteOff() with no note pressed
+    uint32_t missing_curves; // adsrCurve*() indices not compiled in (ADSR_BEZIER_CURVE_MASK)
+    uint32_t cycle_samples;  // timed getWave() / tick() calls (ADSR_BEZIER_STATS_CYCLES)
+    uint32_t cycles_min;     // ADSR_BEZIER_STATS_CLOCK() units
+    uint32_t cycles_max;
+    uint64_t cycles_total;
+};
+
+inline void adsrStatsClear(AdsrStats &stats)
+{
+    stats = AdsrStats();
+    stats.cycles_min = 0xFFFFFFFFUL;
+}
+
+template <typename T = void>
+struct AdsrStatsStorage
+{
+    static AdsrStats global;
+};
+
+template <typename T>
+AdsrStats AdsrStatsStorage<T>::global = {{0, 0, 0, 0, 0}, 0, 0, 0, 0, 0, 0, 0, 0xFFFFFFFFUL, 0, 0};
+
+// Snapshot of the counters summed over every adsr (ADSR_BEZIER_STATS_GLOBAL)
+inline AdsrStats adsrStatsGlobal()
+{
+    return AdsrStatsStorage<>::global;
+}
+
+inline void adsrStatsResetGlobal()
+{
+    adsrStatsClear(AdsrStatsStorage<>::global);
+}
+
+// One line of "name=value" pairs into buf (snprintf semantics), e.g. for Serial.println()
+inline int adsrStatsFormat(const AdsrStats &stats, char *buf, size_t len)
+{
+    unsigned long avg = stats.cycle_samples ? (unsigned long)(stats.cycles_total / stats.cycle_samples) : 0;
+    unsigned long min = stats.cycle_samples ? (unsigned long)stats.cycles_min : 0;
+    return snprintf(buf, len,
+                    "idle=%lu attack=%lu decay=%lu sustain=%lu release=%lu transitions=%lu slow_path=%lu "
+                    "clamps=%lu retriggers=%lu underflows=%lu missing_curves=%lu cycles=%lu/%lu/%lu (min/avg/max, %lu samples)",
+                    (unsigned long)stats.calls[0], (unsigned long)stats.calls[1], (unsigned long)stats.calls[2],
+                    (unsigned long)stats.calls[3], (unsigned long)stats.calls[4], (unsigned long)stats.transitions,
+                    (unsigned long)stats.slow_path, (unsigned long)stats.clamps, (unsigned long)stats.retriggers,
+                    (unsigned long)stats.underflows, (unsigned long)stats.missing_curves, min, avg, (unsigned long)stats.cycles_max,
+                    (unsigned long)stats.cycle_samples);
+}
+
+// Adds n to one counter of the instance (and the global sum); only used inside adsr
+#if ADSR_BEZIER_STATS_GLOBAL
+#define ADSR_BEZIER_STAT(field, n) (_stats.field += (uint32_t)(n), AdsrStatsStorage<>::global.field += (uint32_t)(n))
+#else
+#define ADSR_BEZIER_STAT(field, n) (_stats.field += (uint32_t)(n))
+#endif
+
+#else
+#define ADSR_BEZIER_STAT(field, n) ((void)0)
+#endif // ADSR_BEZIER_STATS
+
+// ---------------------------------------------------------------------------
+// Trace recording (ADSR_BEZIER_TRACE)
+// ---------------------------------------------------------------------------
+
+#if ADSR_BEZIER_TRACE
+
+#include <string.h>
+
+// Record types. Ticks are stored as their low 32 bits (the replay unwraps them).
+enum AdsrTraceOp : uint8_t
+{
+    ADSR_TRACE_NOTE_ON = 1,     // tick
+    ADSR_TRACE_NOTE_OFF,        // tick
+    ADSR_TRACE_GET_WAVE,        // tick, a = output
+    ADSR_TRACE_BLOCK,           // renderBlock(): tick = start, a = tick_step, b = adsrTraceHash() of the outputs,
+                                // n = samples, sub = log2(k) of renderBlockDecimated() (0: renderBlock()),
+                                // plus ADSR_TRACE_BLOCK_MORE when the next record continues the same call
+    ADSR_TRACE_TICK,            // tick() in fixed-rate mode: a = output
+    ADSR_TRACE_STAGE,           // stage time: tick = when it was set, sub = phase, a = ticks,
+                                // n = 1 when the preceding STAGE_SCALE gives the scale
+    ADSR_TRACE_STAGE_SCALE,     // sub = phase, a / b = low / high half of a scale that is not adsrStageScale(ticks)
+    ADSR_TRACE_SUSTAIN,         // a = level, b = Q16 decay range scale it gives
+    ADSR_TRACE_CURVE,           // sub = phase, n = 0 (table) or 1 (second table of a morph),
+                                // a = built-in curve or ADSR_TRACE_TABLE_*, b = adsrTraceHash() of an external table
+    ADSR_TRACE_MORPH,           // sub = phase, a = Q15 morph weight
+    ADSR_TRACE_RESET_ATTACK,    // sub = setResetAttack() flag
+    ADSR_TRACE_TICK_RATE,       // a = setTickRate() rate
+
+    // Keyframe: the whole envelope from KEY_BEGIN to KEY_END (setter records for the settings)
+    ADSR_TRACE_KEY_BEGIN,       // tick = last getWave() tick, a = vertical resolution, sub = 1 in exponential mode
+    ADSR_TRACE_KEY_EXP,         // a / b = float bits of the attack / decay-release curvature (exponential mode)
+    ADSR_TRACE_KEY_STATE,       // sub = phase, tick = phase start, a = output, b = pressed notes
+    ADSR_TRACE_KEY_LEVELS,      // a = attack start level, b = release start level
+    ADSR_TRACE_KEY_TICK_ACC,    // a / b = low / high half of the fixed-rate accumulator, sub = stage end flag
+    ADSR_TRACE_KEY_EXP_STATE,   // tick = next exponential step, a = Q30 state
+    ADSR_TRACE_KEY_END
+};
+
+// ADSR_TRACE_BLOCK flag: longer calls are split into records of ADSR_BEZIER_TRACE_BLOCK_MAX samples
+static constexpr uint8_t ADSR_TRACE_BLOCK_MORE = 0x80;
+
+// ADSR_TRACE_CURVE tables that are not built-in curves
+static constexpr uint32_t ADSR_TRACE_TABLE_NONE = 0xFFFFFFFEUL;     // no table (exponential only build)
+static constexpr uint32_t ADSR_TRACE_TABLE_EXTERNAL = 0xFFFFFFFFUL; // identified by its hash
+
+struct AdsrTraceRecord
+{
+    uint8_t op;                 // AdsrTraceOp
+    uint8_t sub;
+    uint16_t n;
+    uint32_t tick;
+    uint32_t a;
+    uint32_t b;
+};
+
+static_assert(sizeof(AdsrTraceRecord) == 16, "AdsrTraceRecord should stay 16 bytes");
+
+// Destination of the records of an adsr (AdsrTraceRing, AdsrTraceFile or your own).
+// write() runs inside noteOn() / getWave() / renderBlock() etc.
+class AdsrTraceSink
+{
+public:
+    virtual void write(const AdsrTraceRecord &record) = 0;
+
+protected:
+    ~AdsrTraceSink() {}
+};
+
+// FNV-1a style hash with one multiply per 32-bit value, start with
+// ADSR_TRACE_HASH_INIT. Each step is a bijection of h, so a run that differs
+// in a single value always hashes differently.
+static constexpr uint32_t ADSR_TRACE_HASH_INIT = 2166136261UL;
+
+inline uint32_t adsrTraceHash(uint32_t h, uint32_t value)
+{
+    return (h ^ value) * 16777619UL;
+}
+
+// Longest run of samples in one ADSR_TRACE_BLOCK record
+#define ADSR_BEZIER_TRACE_BLOCK_MAX 32768
+
+class AdsrTraceReplay;
+
+// Calls a trace helper when a sink is attached; only used inside adsr
+#define ADSR_BEZIER_TRACE_HOOK(call) \
+    do                               \
+    {                                \
+        if (_trace != nullptr)       \
+            call;                    \
+    } while (0)
+
+#else
+#define ADSR_BEZIER_TRACE_HOOK(call) ((void)0)
+#endif // ADSR_BEZIER_TRACE
+
+// Midi trigger -> on/off
+class adsr
+{
+#if ADSR_BEZIER_TRACE
+    friend class AdsrTraceReplay;
+#endif
+
+public:
+    // constructor
+
+    struct Point
+    {
+        float x, y;
+    };
+
+    // Envelope phase, see getPhase()
+    enum ADSRPhase
+    {
+        ADSR_PHASE_IDLE = 0,
+        ADSR_PHASE_ATTACK,
+        ADSR_PHASE_DECAY,
+        ADSR_PHASE_SUSTAIN,
+        ADSR_PHASE_RELEASE
+    };
+
+    // bezier is kept for compatibility and ignored, as it always was: the
+    // stages read the curve tables unless exponential is set
+    adsr(int l_vertical_resolution, float attack_alpha, float attack_decay_release, bool bezier, int bezier_attack_type, int bezier_decay_type, int bezier_release_type,
+         bool exponential = false)
+    {
+        (void)bezier;
+        _vertical_resolution = l_vertical_resolution; // store vertical resolution (DAC_Size)
+        _attack = 100000;                             // take 100ms as initial value for Attack
+        _sustain = l_vertical_resolution / 2;         // take half the DAC_size as initial value for sustain
+        _decay = 100000;                              // take 100ms as initial value for Decay
+        _release = 100000;                            // take 100ms as initial value for Release
+#if ADSR_BEZIER_EXP_ONLY
+        (void)exponential;
+        (void)bezier_attack_type;
+        (void)bezier_decay_type;
+        (void)bezier_release_type;
+#else
+        _attack_table = _curve_tables[bezier_attack_type];   // curve index into _curve_tables for each stage
+        _decay_table = _curve_tables[bezier_decay_type];
+        _release_table = _curve_tables[bezier_release_type];
+        _exponential = exponential;
+#endif
+        _attack_table_b = _attack_table;
+        _decay_table_b = _decay_table;
+        _release_table_b = _release_table;
+
+        _vres_recip = adsrRangeReciprocal(_vertical_resolution);
+        _gain_recip = adsrGainReciprocal(_vertical_resolution);
+        _attack_scale = adsrStageScale(_attack);
+        _decay_scale = adsrStageScale(_decay);
+        _release_scale = adsrStageScale(_release);
+
+        // Exponential mode: the old per-entry coefficients (0.9 steep .. 0.9995
+        // almost straight, for 1024 entries) give the curvature of each stage
+        _exp_attack_curve = _expCurve(attack_alpha);
+        _exp_decay_release_curve = _expCurve(attack_decay_release);
+        _expUpdateCoefficients();
+#if ADSR_BEZIER_STATS
+        adsrStatsClear(_stats);
+#if !ADSR_BEZIER_EXP_ONLY
+        ADSR_BEZIER_STAT(missing_curves, !adsrBezierCurveCompiled((uint8_t)bezier_attack_type) +
+                                             !adsrBezierCurveCompiled((uint8_t)bezier_decay_type) +
+                                             !adsrBezierCurveCompiled((uint8_t)bezier_release_type));
+#endif
+#endif
+    }
+
+    // void adsrCreateTables(float maxVal, int numPoints)
+    //{
+
+    // Point A = {0, maxVal}; // Punto inicial
+    // Point B = {maxVal, 0};
+    // Point P1[8] = {{250, 1500}, {840, 1780}, {400, 430}, {2170, 3610}, {400, 1380}, {1140, 3750}, {200, 2700}, {0, 4095}};
+    // Point P2[8] = {{1500, 250}, {1160, 210}, {920, 420}, {3730, 2610}, {3830, 2890}, {1850, 1080}, {720, 3050}, {4095, 0}};
+
+    // for (int j = 0; j < 8; j++)
+    // {
+
+    //     float multiplier = (float)(maxVal + 1) / (float)(numPoints - 1);
+
+    //     // Imprimir los puntos de la curva
+    //     for (float i = 0; i < numPoints; i++)
+    //     {
+    //         float xTarget = multiplier * i;
+    //         float yResult = findYForX(A, P1[j], P2[j], B, xTarget);
+
+    //         _curve_tables[j][(int)i] = (int)round(yResult);
+    //     }
+    // }
+    //}
+
+#if !ADSR_BEZIER_EXP_ONLY
+    void adsrCurveAttack(uint8_t curveType)
+    {
+        ADSR_BEZIER_STAT(missing_curves, !adsrBezierCurveCompiled(curveType));
+        adsrCurveAttackTable(_curve_tables[curveType]);
+    }
+
+    void adsrCurveDecay(uint8_t curveType)
+    {
+        ADSR_BEZIER_STAT(missing_curves, !adsrBezierCurveCompiled(curveType));
+        adsrCurveDecayTable(_curve_tables[curveType]);
+    }
+
+    void adsrCurveRelease(uint8_t curveType)
+    {
+        ADSR_BEZIER_STAT(missing_curves, !adsrBezierCurveCompiled(curveType));
+        adsrCurveReleaseTable(_curve_tables[curveType]);
+    }
+
+    // Blend of two built-in curves, read at lookup time: amount 0 -> from,
+    // 65535 -> to (26214 = 40 %). No table is generated; the amount can move
+    // at any time with setAttackMorph() etc.
+    void adsrCurveAttackMorph(uint8_t from, uint8_t to, uint16_t amount)
+    {
+        ADSR_BEZIER_STAT(missing_curves, !adsrBezierCurveCompiled(from) + !adsrBezierCurveCompiled(to));
+        adsrCurveAttackMorphTables(_curve_tables[from], _curve_tables[to], amount);
+    }
+
+    void adsrCurveDecayMorph(uint8_t from, uint8_t to, uint16_t amount)
+    {
+        ADSR_BEZIER_STAT(missing_curves, !adsrBezierCurveCompiled(from) + !adsrBezierCurveCompiled(to));
+        adsrCurveDecayMorphTables(_curve_tables[from], _curve_tables[to], amount);
+    }
+
+    void adsrCurveReleaseMorph(uint8_t from, uint8_t to, uint16_t amount)
+    {
+        ADSR_BEZIER_STAT(missing_curves, !adsrBezierCurveCompiled(from) + !adsrBezierCurveCompiled(to));
+        adsrCurveReleaseMorphTables(_curve_tables[from], _curve_tables[to], amount);
+    }
+#else
+    // No curve tables in this build: every stage is exponential
+    void adsrCurveAttack(uint8_t)
+    {
+    }
+
+    void adsrCurveAttackMorph(uint8_t, uint8_t, uint16_t)
+    {
+    }
+
+    void adsrCurveDecay(uint8_t)
+    {
+    }
+
+    void adsrCurveDecayMorph(uint8_t, uint8_t, uint16_t)
+    {
+    }
+
+    void adsrCurveRelease(uint8_t)
+    {
+    }
+
+    void adsrCurveReleaseMorph(uint8_t, uint8_t, uint16_t)
+    {
+    }
+#endif
+
+    // Use any table of ARRAY_SIZE entries (e.g. from AdsrCurveRegistry) instead of a built-in curve.
+    // The table must stay valid while the stage can run. Selecting one curve ends a morph.
+    void adsrCurveAttackTable(const adsr_curve_t *table)
+    {
+        _attack_table = table;
+        _attack_table_b = table;
+        _attack_morph = 0;
+        ADSR_BEZIER_TRACE_HOOK(_traceCurve(ADSR_PHASE_ATTACK));
+    }
+
+    void adsrCurveDecayTable(const adsr_curve_t *table)
+    {
+        _decay_table = table;
+        _decay_table_b = table;
+        _decay_morph = 0;
+        ADSR_BEZIER_TRACE_HOOK(_traceCurve(ADSR_PHASE_DECAY));
+    }
+
+    void adsrCurveReleaseTable(const adsr_curve_t *table)
+    {
+        _release_table = table;
+        _release_table_b = table;
+        _release_morph = 0;
+        ADSR_BEZIER_TRACE_HOOK(_traceCurve(ADSR_PHASE_RELEASE));
+    }
+
+    // Same with any two tables of ARRAY_SIZE entries
+    void adsrCurveAttackMorphTables(const adsr_curve_t *from, const adsr_curve_t *to, uint16_t amount)
+    {
+        _attack_table = from;
+        _attack_table_b = to;
+        _attack_morph = adsrMorphWeight(amount);
+        ADSR_BEZIER_TRACE_HOOK(_traceCurve(ADSR_PHASE_ATTACK));
+    }
+
+    void adsrCurveDecayMorphTables(const adsr_curve_t *from, const adsr_curve_t *to, uint16_t amount)
+    {
+        _decay_table = from;
+        _decay_table_b = to;
+        _decay_morph = adsrMorphWeight(amount);
+        ADSR_BEZIER_TRACE_HOOK(_traceCurve(ADSR_PHASE_DECAY));
+    }
+
+    void adsrCurveReleaseMorphTables(const adsr_curve_t *from, const adsr_curve_t *to, uint16_t amount)
+    {
+        _release_table = from;
+        _release_table_b = to;
+        _release_morph = adsrMorphWeight(amount);
+        ADSR_BEZIER_TRACE_HOOK(_traceCurve(ADSR_PHASE_RELEASE));
+    }
+
+    // Morph amount of a stage (0 .. 65535), takes effect at the next sample
+    void setAttackMorph(uint16_t amount)
+    {
+        _attack_morph = adsrMorphWeight(amount);
+        ADSR_BEZIER_TRACE_HOOK(_traceEvent(ADSR_TRACE_MORPH, ADSR_PHASE_ATTACK, 0, 0, (uint32_t)_attack_morph, 0));
+    }
+
+    void setDecayMorph(uint16_t amount)
+    {
+        _decay_morph = adsrMorphWeight(amount);
+        ADSR_BEZIER_TRACE_HOOK(_traceEvent(ADSR_TRACE_MORPH, ADSR_PHASE_DECAY, 0, 0, (uint32_t)_decay_morph, 0));
+    }
+
+    void setReleaseMorph(uint16_t amount)
+    {
+        _release_morph = adsrMorphWeight(amount);
+        ADSR_BEZIER_TRACE_HOOK(_traceEvent(ADSR_TRACE_MORPH, ADSR_PHASE_RELEASE, 0, 0, (uint32_t)_release_morph, 0));
+    }
+
+    void setResetAttack(bool l_reset_attack)
+    {
+        _reset_attack = l_reset_attack;
+        ADSR_BEZIER_TRACE_HOOK(_traceEvent(ADSR_TRACE_RESET_ATTACK, _reset_attack ? 1 : 0, 0, 0, 0, 0));
+    }
+
+    // Attack time in milliseconds (same external semantics as millis-based ADSR)
+    void setAttack(unsigned long l_attack_ms)
+    {
+        setAttack(l_attack_ms, _t_last);
+    }
+
+    // Same, for a change made at tick now rather than at the last getWave():
+    // a running attack keeps the position it has at now (queued events)
+    void setAttack(unsigned long l_attack_ms, unsigned long now)
+    {
+        // Convert to internal timebase (ticks)
+#if ADSR_BEZIER_USE_MICROS
+        unsigned long attack_ticks = l_attack_ms * 1000UL; // µs
+#else
+        unsigned long attack_ticks = l_attack_ms;          // ms
+#endif
+        // Precompute fixed-point scale for fast time->index mapping (Q24, Q40 for long stages)
+        // idx ~= delta_ticks * ((ARRAY_SIZE-1) / _attack)
+        _setAttackTicks(attack_ticks, adsrStageScale(attack_ticks), now);
+    }
+
+    // Decay time in milliseconds
+    void setDecay(unsigned long l_decay_ms)
+    {
+        setDecay(l_decay_ms, _t_last);
+    }
+
+    void setDecay(unsigned long l_decay_ms, unsigned long now)
+    {
+        // Convert to internal timebase (ticks)
+#if ADSR_BEZIER_USE_MICROS
+        unsigned long decay_ticks = l_decay_ms * 1000UL; // µs
+#else
+        unsigned long decay_ticks = l_decay_ms;          // ms
+#endif
+        _setDecayTicks(decay_ticks, adsrStageScale(decay_ticks), now);
+    }
+
+    void setSustain(int l_sustain)
+    {
+        if (l_sustain < 0)
+            l_sustain = 0;
+        if (l_sustain >= _vertical_resolution)
+            l_sustain = _vertical_resolution;
+        _sustain = l_sustain;
+
+        // Precompute decay output range scale: from sustain up to full level
+        // out = sustain + curveVal * (vertical_resolution - sustain) / vertical_resolution
+        _decay_range_scale_q16 = adsrRangeScaleQ16((int32_t)_vertical_resolution - (int32_t)_sustain, _vertical_resolution, _vres_recip);
+        ADSR_BEZIER_TRACE_HOOK(_traceEvent(ADSR_TRACE_SUSTAIN, 0, 0, 0, (uint32_t)_sustain, (uint32_t)_decay_range_scale_q16));
+    }
+
+    // Release time in milliseconds
+    void setRelease(unsigned long l_release_ms)
+    {
+        setRelease(l_release_ms, _t_last);
+    }
+
+    void setRelease(unsigned long l_release_ms, unsigned long now)
+    {
+        // Convert to internal timebase (ticks)
+#if ADSR_BEZIER_USE_MICROS
+        unsigned long release_ticks = l_release_ms * 1000UL; // µs
+#else
+        unsigned long release_ticks = l_release_ms;          // ms
+#endif
+        _setReleaseTicks(release_ticks, adsrStageScale(release_ticks), now);
+    }
+
+    // Stage times from a control value (0..65535 over the table's range), for
+    // modulation at control rate: no division in Bézier mode (exponential mode
+    // recomputes its coefficients in float). Like the setters, changing the
+    // time of the running stage keeps its current position.
+    template <size_t Steps>
+    void modAttack(const AdsrTimeTable<Steps> &times, uint16_t value)
+    {
+        unsigned long ticks;
+        uint64_t scale;
+        times.lookup(value, ticks, scale);
+        _setAttackTicks(ticks, scale, _t_last);
+    }
+
+    template <size_t Steps>
+    void modDecay(const AdsrTimeTable<Steps> &times, uint16_t value)
+    {
+        unsigned long ticks;
+        uint64_t scale;
+        times.lookup(value, ticks, scale);
+        _setDecayTicks(ticks, scale, _t_last);
+    }
+
+    template <size_t Steps>
+    void modRelease(const AdsrTimeTable<Steps> &times, uint16_t value)
+    {
+        unsigned long ticks;
+        uint64_t scale;
+        times.lookup(value, ticks, scale);
+        _setReleaseTicks(ticks, scale, _t_last);
+    }
+
+    // Use current micros() timestamp internally
+    void noteOn()
+    {
+        noteOn(_now());
+    }
+
+    // Trigger at an explicit timestamp (ticks in the compiled timebase)
+    void noteOn(unsigned long now)
+    {
+        ADSR_BEZIER_STAT(retriggers, _phase != ADSR_PHASE_IDLE);
+        ADSR_BEZIER_STAT(transitions, _phase != ADSR_PHASE_ATTACK);
+        _t_note_on = now; // set new timestamp for note_on
+        if (_reset_attack)     // set start value new Attack
+            _attack_start = 0; // if _reset_attack equals true, a new trigger starts with 0
+        else
+            _attack_start = _adsr_output; // if _reset_attack equals false, a new trigger starts with the current value
+        _notes_pressed++;                 // increase number of pressed notes with one
+
+        // Start attack phase
+        _phase = ADSR_PHASE_ATTACK;
+        _t_phase_start = now;
+        _tick_acc = 0;
+        _tick_stage_end = false;
+        _expStart(now);
+
+        // Precompute attack output range scale: from attack_start up to full level
+        // out = attack_start + curveVal * (vertical_resolution - attack_start) / vertical_resolution
+        _attack_range_scale_q16 = adsrRangeScaleQ16((int32_t)_vertical_resolution - (int32_t)_attack_start, _vertical_resolution, _vres_recip);
+        ADSR_BEZIER_TRACE_HOOK(_traceEvent(ADSR_TRACE_NOTE_ON, 0, 0, now, 0, 0));
+    }
+
+    void noteOff()
+    {
+        noteOff(_now());
+    }
+
+    // Release at an explicit timestamp (ticks in the compiled timebase)
+    void noteOff(unsigned long now)
+    {
+        ADSR_BEZIER_STAT(underflows, _notes_pressed <= 0);
+        _notes_pressed--;
+        if (_notes_pressed <= 0)
+        {                                  // if all notes are depressed - start release
+            ADSR_BEZIER_STAT(transitions, _phase != ADSR_PHASE_RELEASE);
+            _t_note_off = now;             // set timestamp for note off
+            _release_start = _adsr_output; // set start value for release
+            _notes_pressed = 0;
+
+            // Start release phase
+            _phase = ADSR_PHASE_RELEASE;
+            _t_phase_start = now;
+            _tick_acc = 0;
+            _tick_stage_end = false;
+            _expStart(now);
+
+            // Precompute release output range scale: from release_start down to 0
+            // out = curveVal * release_start / vertical_resolution
+            int32_t rs = (int32_t)_release_start;
+            if (rs > _vertical_resolution)
+                rs = _vertical_resolution;
+            _release_range_scale_q16 = adsrRangeScaleQ16(rs, _vertical_resolution, _vres_recip);
+        }
+        ADSR_BEZIER_TRACE_HOOK(_traceEvent(ADSR_TRACE_NOTE_OFF, 0, 0, now, 0, 0));
+    }
+
+    // Compute ADSR value based on current timebase (micros or millis)
+    int getWave()
+    {
+        return getWave(_now());
+    }
+
+    // Compute ADSR value at an explicit timestamp (ticks in the compiled timebase)
+    int getWave(unsigned long l_ticks)
+    {
+        _getWave(l_ticks);
+        ADSR_BEZIER_TRACE_HOOK(_traceEvent(ADSR_TRACE_GET_WAVE, 0, 0, l_ticks, (uint32_t)_adsr_output, 0));
+        return _adsr_output;
+    }
+
+    // Render n envelope values into out, sampling at start_tick, start_tick + tick_step, ...
+    // The result (and the internal state afterwards) is identical to calling
+    // getWave(t) once per sample, but each phase runs in a tight inner loop and
+    // only the samples that cross a phase boundary go through the state machine.
+    void renderBlock(int *out, size_t n, unsigned long start_tick, unsigned long tick_step)
+    {
+        _renderBlock<false>(out, n, start_tick, tick_step, 0);
+        ADSR_BEZIER_TRACE_HOOK(_traceBlock(out, 0, n, start_tick, tick_step, 0));
+    }
+
+    // renderBlock() at control rate: inside attack, decay and release the curve
+    // is looked up at the first sample and every k-th sample after it (k a power
+    // of two up to ADSR_BEZIER_RAMP_MAX, others round down), and the samples in
+    // between follow a linear ramp (one multiply and shift each). Those exact
+    // points are spaced from the start of the block, so the output depends on
+    // the block boundaries as well as the ticks. Samples within k of a stage end are
+    // exact, and phase changes, sustain, idle and the state afterwards are the
+    // same as renderBlock(): note events between blocks and stage ends land on
+    // their tick. Exponential mode renders at full rate. k = 1 is renderBlock().
+    void renderBlockDecimated(int *out, size_t n, unsigned long start_tick, unsigned long tick_step, unsigned k)
+    {
+        unsigned ramp_shift = 0;
+        while ((2U << ramp_shift) <= k && (2U << ramp_shift) <= ADSR_BEZIER_RAMP_MAX)
+            ramp_shift++;
+        if (ramp_shift == 0)
+            _renderBlock<false>(out, n, start_tick, tick_step, 0);
+        else
+            _renderBlock<true>(out, n, start_tick, tick_step, ramp_shift);
+        ADSR_BEZIER_TRACE_HOOK(_traceBlock(out, 0, n, start_tick, tick_step, ramp_shift));
+    }
+
+    // Multiply a signal block in place by the envelope: buf[i] x level / vertical_resolution
+    // (Q15 gain, see adsrGainQ15()) for the levels renderBlock(out, n, start_tick,
+    // tick_step) would give, leaving the same state. T is int16_t, int32_t or float.
+    // Levels are rendered ADSR_BEZIER_GAIN_CHUNK at a time into a stack buffer,
+    // so buf is read and written once. Sustain and idle need no levels: a
+    // full-level sustain leaves buf untouched and idle writes zeros.
+    template <typename T>
+    void applyBlock(T *buf, size_t n, unsigned long start_tick, unsigned long tick_step)
+    {
+        int levels[ADSR_BEZIER_GAIN_CHUNK];
+        size_t i = 0;
+
+        while (i < n)
+        {
+            if (!_isExponential() && (_phase == ADSR_PHASE_SUSTAIN || _phase == ADSR_PHASE_IDLE))
+            {
+                // Constant until the next noteOn()/noteOff(), as in renderBlock()
+                int level = (_phase == ADSR_PHASE_SUSTAIN) ? _sustain : 0;
+                ADSR_BEZIER_STAT(calls[_phase], n - i);
+                _adsr_output = level;
+                _t_last = start_tick + (unsigned long)(n - 1) * tick_step;
+                adsrGainApplyConstant(buf + i, n - i, adsrGainQ15(level, _gain_recip));
+                ADSR_BEZIER_TRACE_HOOK(_traceBlock(nullptr, level, n - i, start_tick + (unsigned long)i * tick_step, tick_step, 0));
+                return;
+            }
+
+            size_t m = n - i < (size_t)ADSR_BEZIER_GAIN_CHUNK ? n - i : (size_t)ADSR_BEZIER_GAIN_CHUNK;
+            renderBlock(levels, m, start_tick + (unsigned long)i * tick_step, tick_step);
+            adsrGainApply(buf + i, levels, m, _gain_recip);
+            i += m;
+        }
+    }
+
+    // Current phase (updated by noteOn()/noteOff() and by getWave()/renderBlock()/tick() at stage ends)
+    ADSRPhase getPhase() const
+    {
+        return _phase;
+    }
+
+    // True in attack, decay and release, where the output moves on its own.
+    // In sustain and idle it stays constant until the next noteOn()/noteOff(),
+    // so a voice loop can skip the envelope.
+    bool isActive() const
+    {
+        return _phase == ADSR_PHASE_ATTACK || _phase == ADSR_PHASE_DECAY || _phase == ADSR_PHASE_RELEASE;
+    }
+
+    // Tick at which the running stage ends: the first getWave(now) with now at
+    // or after it moves to the next phase. Returns false in sustain and idle,
+    // which have no scheduled change.
+    bool nextChange(unsigned long &tick) const
+    {
+        switch (_phase)
+        {
+        case ADSR_PHASE_ATTACK:
+            tick = _t_phase_start + _attack;
+            return true;
+        case ADSR_PHASE_DECAY:
+            tick = _t_phase_start + _decay;
+            return true;
+        case ADSR_PHASE_RELEASE:
+            tick = _t_phase_start + _release;
+            return true;
+        default:
+            return false;
+        }
+    }
+
+#if ADSR_BEZIER_STATS
+    // Snapshot of this envelope's instrumentation counters (see adsrStatsFormat())
+    AdsrStats getStats() const
+    {
+        return _stats;
+    }
+
+    void resetStats()
+    {
+        adsrStatsClear(_stats);
+        _stat_calls = 0;
+    }
+#endif
 
-#ifndef ADSR
-#define ADSR
+#if ADSR_BEZIER_TRACE
+    // Log every note event, setter, getWave() / renderBlock() / tick() output
+    // to sink (nullptr stops), starting with a keyframe of the whole state and
+    // repeating it every keyframe_interval events (0: only the first).
+    // AdsrTraceReplay starts at the first complete keyframe, so a ring that
+    // overwrites old records should hold more than one interval.
+    void setTrace(AdsrTraceSink *sink, uint32_t keyframe_interval = 1024)
+    {
+        _trace = sink;
+        _trace_interval = keyframe_interval;
+        _trace_events = 0;
+        if (sink != nullptr)
+            _traceKeyframe(*sink);
+    }
 
-// for array for lookup table
-#ifndef ARRAY_SIZE
-#define ARRAY_SIZE 1024
+    AdsrTraceSink *getTrace() const
+    {
+        return _trace;
+    }
 #endif
 
-// number of time points
-// #define ATTACK_ALPHA 0.997                  // varies between 0.9 (steep curve) and 0.9995 (straight line)
-// #define ATTACK_DECAY_RELEASE 0.997          // fits to ARRAY_SIZE 1024
+    // Fixed-rate mode: tick() is called rate_hz times per second (e.g. from a
+    // timer interrupt) instead of getWave(). Each stage runs a DDS-style phase
+    // accumulator that spans 2^48 over the stage; tick() adds the increment
+    // precomputed by the setters and the stage ends when the accumulator
+    // overflows its 48 bits. Per call that is one 64-bit add, a compare and a
+    // 32-bit multiply on the high word: no clock read and no wide multiply.
+    // noteOn()/noteOff() start the stages as usual (tick() ignores their timestamp).
+    //
+    // In exponential mode the recurrence then steps once per tick() call, and
+    // getWave() steps every 1 / rate_hz seconds (rounded to whole ticks).
+    void setTickRate(unsigned long rate_hz)
+    {
+        _tick_rate = rate_hz;
+        _attack_inc = _tickIncrement(_attack);
+        _decay_inc = _tickIncrement(_decay);
+        _release_inc = _tickIncrement(_release);
 
-// #define ARRAY_SIZE 1024                   // number of time points
-// #define ATTACK_ALPHA 0.9975           // varies between 0.9 (steep curve) and 0.9995 (straight line)
-// #define ATTACK_DECAY_RELEASE 0.9975
+        _exp_period = ADSR_BEZIER_EXP_STEP_TICKS;
+        if (rate_hz > 0)
+        {
+            _exp_period = (_ticksPerSecond() + rate_hz / 2) / rate_hz;
+            if (_exp_period == 0)
+                _exp_period = 1;
+        }
+        _expUpdateCoefficients();
+        ADSR_BEZIER_TRACE_HOOK(_traceEvent(ADSR_TRACE_TICK_RATE, 0, 0, 0, (uint32_t)_tick_rate, 0));
+    }
 
-// Global curve table pointer (defined later in this header)
-extern int *_curve_tables[8];
+    // Next envelope value in fixed-rate mode; same state machine as getWave()
+    int tick()
+    {
+        const ADSRPhase phase_in = _phase;
+        const uint32_t stat_t0 = _statEnter();
 
-// Midi trigger -> on/off
-class adsr
-{
+        switch (_phase)
+        {
+        case ADSR_PHASE_ATTACK:
+        {
+            if (_attack_inc == 0 || _tick_stage_end)
+            {
+                // End of attack -> full level
+                _adsr_output = _vertical_resolution;
+                _phase = (_decay_inc != 0) ? ADSR_PHASE_DECAY : ADSR_PHASE_SUSTAIN;
+                // This call is the first decay sample (position 0), like getWave()
+                _tick_acc = 0;
+                _tick_stage_end = false;
+                _tickAdvance(_decay_inc);
+                _exp_u = ADSR_EXP_ONE;
+                _expStep(_decay_exp_k, _decay_exp_b);
+                break;
+            }
 
-public:
-    // constructor
+            if (_isExponential())
+            {
+                _adsr_output = _expOutput(_attack_start, _vertical_resolution);
+                _expStep(_attack_exp_k, _attack_exp_b);
+            }
+            else
+            {
+                // Attack curve runs "backwards" through the table
+                int curveVal = adsrCurveLookupMorph(_attack_table, _attack_table_b, adsrStagePositionMax() - _tickPosition(), _attack_morph);
+                _adsr_output = _stageOutput(curveVal, _attack_start, _attack_range_scale_q16);
+            }
+            _tickAdvance(_attack_inc);
+            break;
+        }
 
-    struct Point
-    {
-        float x, y;
-    };
+        case ADSR_PHASE_DECAY:
+        {
+            if (_decay_inc == 0 || _tick_stage_end)
+            {
+                // End of decay -> sustain
+                _adsr_output = _sustain;
+                _phase = ADSR_PHASE_SUSTAIN;
+                break;
+            }
 
-    adsr(int l_vertical_resolution, float attack_alpha, float attack_decay_release, bool bezier, int bezier_attack_type, int bezier_decay_type, int bezier_release_type)
-    {
-        _vertical_resolution = l_vertical_resolution; // store vertical resolution (DAC_Size)
-        _attack = 100000;                             // take 100ms as initial value for Attack
-        _sustain = l_vertical_resolution / 2;         // take half the DAC_size as initial value for sustain
-        _decay = 100000;                              // take 100ms as initial value for Decay
-        _release = 100000;                            // take 100ms as initial value for Release
+            if (_isExponential())
+            {
+                _adsr_output = _expOutput(_vertical_resolution, _sustain);
+                _expStep(_decay_exp_k, _decay_exp_b);
+            }
+            else
+            {
+                int curveVal = adsrCurveLookupMorph(_decay_table, _decay_table_b, _tickPosition(), _decay_morph);
+                _adsr_output = _stageOutput(curveVal, _sustain, _decay_range_scale_q16);
+            }
+            _tickAdvance(_decay_inc);
+            break;
+        }
 
-        if (bezier == true)
+        case ADSR_PHASE_SUSTAIN:
         {
-            // for (int i = 0; i < ARRAY_SIZE; i++)
-            // { // Create look-up table for Attack
-            //     _attack_table[i] = i;
-            //     _decay_release_table[i] = _vertical_resolution - i;
-            // }
+            _adsr_output = _sustain;
+            break;
+        }
 
-            // for (int i = 0; i < ARRAY_SIZE - 1; i++)
-            // { // Create look-up table for Decay
-            //     _attack_table[i + 1] = (1.0 - attack_alpha) * (_vertical_resolution) + attack_alpha * _attack_table[i];
-            //     _decay_release_table[i + 1] = attack_decay_release * _decay_release_table[i];
-            // }
+        case ADSR_PHASE_RELEASE:
+        {
+            if (_release_inc == 0 || _tick_stage_end)
+            {
+                _adsr_output = 0;
+                _phase = ADSR_PHASE_IDLE;
+                break;
+            }
 
-            // for (int i = 0; i < ARRAY_SIZE; i++)
-            // { // normalize table to min and max
-            //     _attack_table[i] = map(_attack_table[i], 0, _attack_table[ARRAY_SIZE - 1], 0, _vertical_resolution);
-            //     _decay_release_table[i] = map(_decay_release_table[i], _decay_release_table[ARRAY_SIZE - 1], _decay_release_table[0], 0, _vertical_resolution);
-            // }
+            if (_isExponential())
+            {
+                _adsr_output = _expOutput(_release_start, 0);
+                _expStep(_release_exp_k, _release_exp_b);
+            }
+            else
+            {
+                int curveVal = adsrCurveLookupMorph(_release_table, _release_table_b, _tickPosition(), _release_morph);
+                _adsr_output = _stageOutput(curveVal, 0, _release_range_scale_q16);
+            }
+            _tickAdvance(_release_inc);
+            break;
         }
-        else
-        {
 
-            // adsrCreateTables(l_vertical_resolution, ARRAY_SIZE);
+        case ADSR_PHASE_IDLE:
+        default:
+        {
+            _adsr_output = 0;
+            break;
         }
+        }
+        _statLeave(phase_in, stat_t0);
+        ADSR_BEZIER_TRACE_HOOK(_traceEvent(ADSR_TRACE_TICK, 0, 0, 0, (uint32_t)_adsr_output, 0));
+        return _adsr_output;
     }
 
-    // void adsrCreateTables(float maxVal, int numPoints)
-    //{
-
-    // Point A = {0, maxVal}; // Punto inicial
-    // Point B = {maxVal, 0};
-    // Point P1[8] = {{250, 1500}, {840, 1780}, {400, 430}, {2170, 3610}, {400, 1380}, {1140, 3750}, {200, 2700}, {0, 4095}};
-    // Point P2[8] = {{1500, 250}, {1160, 210}, {920, 420}, {3730, 2610}, {3830, 2890}, {1850, 1080}, {720, 3050}, {4095, 0}};
+    // Función que calcula un punto en la curva de Bézier cúbica para un valor dado de t
+    Point bezierCubic(const Point &A, const Point &P1, const Point &P2, const Point &B, float t)
+    {
+        float one_minus_t = 1.0f - t;
+        float one_minus_t_squared = one_minus_t * one_minus_t;
+        float t_squared = t * t;
+        float x = one_minus_t_squared * one_minus_t * A.x +
+                  3 * one_minus_t_squared * t * P1.x +
+                  3 * one_minus_t * t_squared * P2.x +
+                  t_squared * t * B.x;
+        float y = one_minus_t_squared * one_minus_t * A.y +
+                  3 * one_minus_t_squared * t * P1.y +
+                  3 * one_minus_t * t_squared * P2.y +
+                  t_squared * t * B.y;
+        return {x, y};
+    }
 
-    // for (int j = 0; j < 8; j++)
-    // {
+    // Función para encontrar el valor de y dado un valor de x en la curva de Bézier
+    float findYForX(const Point &A, const Point &P1, const Point &P2, const Point &B, float xTarget, float tol = 1e-6)
+    {
+        float tLow = 0.0f;
+        float tHigh = 1.0f;
+        float tMid;
 
-    //     float multiplier = (float)(maxVal + 1) / (float)(numPoints - 1);
+        while ((tHigh - tLow) > tol)
+        {
+            tMid = (tLow + tHigh) / 2.0f;
+            Point midPoint = bezierCubic(A, P1, P2, B, tMid);
+            if (midPoint.x < xTarget)
+            {
+                tLow = tMid;
+            }
+            else
+            {
+                tHigh = tMid;
+            }
+        }
 
-    //     // Imprimir los puntos de la curva
-    //     for (float i = 0; i < numPoints; i++)
-    //     {
-    //         float xTarget = multiplier * i;
-    //         float yResult = findYForX(A, P1[j], P2[j], B, xTarget);
+        Point resultPoint = bezierCubic(A, P1, P2, B, tMid);
+        return resultPoint.y;
+    }
 
-    //         _curve_tables[j][(int)i] = (int)round(yResult);
-    //     }
-    // }
-    //}
+private:
+    static unsigned long _now()
+    {
+#if ADSR_BEZIER_USE_MICROS
+        return micros();
+#else
+        return millis();
+#endif
+    }
 
-    void adsrCurveAttack(uint8_t curveType)
+    static constexpr unsigned long _ticksPerSecond()
     {
-        _bezier_attack_type = curveType;
+        return ADSR_BEZIER_USE_MICROS ? 1000000UL : 1000UL;
     }
 
-    void adsrCurveDecay(uint8_t curveType)
+    // New stage times with their precomputed scales (setters and mod*()),
+    // made at tick now
+    void _setAttackTicks(unsigned long ticks, uint64_t scale, unsigned long now)
     {
-        _bezier_decay_type = curveType;
+        _rescaleStage(ADSR_PHASE_ATTACK, _attack, _attack_scale, ticks, now);
+        _attack = ticks;
+        _attack_scale = scale;
+        _attack_inc = _tickIncrement(ticks);
+        if (_isExponential())
+            _expCoefficients(ticks, _exp_attack_curve, _attack_exp_k, _attack_exp_b);
+        ADSR_BEZIER_TRACE_HOOK(_traceStage(ADSR_PHASE_ATTACK, ticks, scale, now));
     }
 
-    void adsrCurveRelease(uint8_t curveType)
+    void _setDecayTicks(unsigned long ticks, uint64_t scale, unsigned long now)
     {
-        _bezier_release_type = curveType;
+        _rescaleStage(ADSR_PHASE_DECAY, _decay, _decay_scale, ticks, now);
+        _decay = ticks;
+        _decay_scale = scale;
+        _decay_inc = _tickIncrement(ticks);
+        if (_isExponential())
+            _expCoefficients(ticks, _exp_decay_release_curve, _decay_exp_k, _decay_exp_b);
+        ADSR_BEZIER_TRACE_HOOK(_traceStage(ADSR_PHASE_DECAY, ticks, scale, now));
     }
 
-    void setResetAttack(bool l_reset_attack)
+    void _setReleaseTicks(unsigned long ticks, uint64_t scale, unsigned long now)
     {
-        _reset_attack = l_reset_attack;
+        _rescaleStage(ADSR_PHASE_RELEASE, _release, _release_scale, ticks, now);
+        _release = ticks;
+        _release_scale = scale;
+        _release_inc = _tickIncrement(ticks);
+        if (_isExponential())
+            _expCoefficients(ticks, _exp_decay_release_curve, _release_exp_k, _release_exp_b);
+        ADSR_BEZIER_TRACE_HOOK(_traceStage(ADSR_PHASE_RELEASE, ticks, scale, now));
     }
 
-    // Attack time in milliseconds (same external semantics as millis-based ADSR)
-    void setAttack(unsigned long l_attack_ms)
+    // When `stage` is running, move its start so the position it has at now
+    // stays the same with the new duration (no jump)
+    void _rescaleStage(ADSRPhase stage, unsigned long duration, uint64_t scale, unsigned long new_duration, unsigned long now)
     {
-        // Convert to internal timebase (ticks)
-#if ADSR_BEZIER_USE_MICROS
-        unsigned long attack_ticks = l_attack_ms * 1000UL; // µs
-#else
-        unsigned long attack_ticks = l_attack_ms;          // ms
-#endif
-        _attack = attack_ticks;
+        if (_phase != stage || duration == 0)
+            return;
+        unsigned long delta = now - _t_phase_start;
+        if (delta >= duration)
+            return;
+        _t_phase_start = now - adsrStageRescale(delta, duration, scale, new_duration);
+    }
 
-        // Precompute fixed-point scale for fast time->index mapping (Q24 format)
-        // idx ~= delta_ticks * ((ARRAY_SIZE-1) / _attack)
-        if (_attack > 0 && _attack <= _time_q24_max_ticks)
-        {
-            _attack_scale_q24 = (((uint64_t)(ARRAY_SIZE - 1)) << 24) / (uint64_t)_attack;
-        }
-        else
+    // Accumulator increment for a stage of `ticks` at _tick_rate calls per
+    // second: ceil(2^48 / stage length in calls), so the accumulator leaves
+    // its 48 bits on the first call at or after the end of the stage. 48 bits
+    // keep that within one call for stages up to 2^24 calls (0 = zero-length stage).
+    uint64_t _tickIncrement(unsigned long ticks) const
+    {
+        if (ticks == 0 || _tick_rate == 0)
+            return 0;
+        const uint64_t ticks_per_second = _ticksPerSecond();
+        uint64_t calls_scaled = (uint64_t)ticks * _tick_rate;    // stage length in calls * ticks_per_second
+        if (calls_scaled <= ticks_per_second)
+            return _tick_span;                                   // one call or less
+
+        // ceil((ticks_per_second << 48) / calls_scaled) by long division (setter only)
+        uint64_t q = 0;
+        uint64_t r = ticks_per_second;
+        for (int bit = 0; bit < 48; ++bit)
         {
-            _attack_scale_q24 = 0;
+            r <<= 1;
+            q <<= 1;
+            if (r >= calls_scaled)
+            {
+                r -= calls_scaled;
+                q |= 1;
+            }
         }
+        return q + (r != 0 ? 1 : 0);
     }
 
-    // Decay time in milliseconds
-    void setDecay(unsigned long l_decay_ms)
+    // Table position of the accumulator: its top 16 bits (bits 32..47) times
+    // the table length, a 32-bit product for tables up to 65536 entries
+    uint32_t _tickPosition() const
     {
-        // Convert to internal timebase (ticks)
-#if ADSR_BEZIER_USE_MICROS
-        unsigned long decay_ticks = l_decay_ms * 1000UL; // µs
+        return ((uint32_t)(_tick_acc >> 32) * (uint32_t)(ARRAY_SIZE - 1)) >> (16 - ADSR_BEZIER_FRAC_BITS);
+    }
+
+    void _tickAdvance(uint64_t inc)
+    {
+        _tick_acc += inc;
+        if ((uint32_t)(_tick_acc >> 32) >= (uint32_t)(_tick_span >> 32))
+            _tick_stage_end = true;
+    }
+
+    static constexpr uint64_t _tick_span = 1ULL << 48;
+
+    // Exponential mode. Each stage runs u(n+1) = k * u(n) - b in Q30, from
+    // u = 1 at the stage start down to 0 at its end, and outputs
+    // to + (from - to) * u: a one-pole lowpass plus an offset b that makes
+    // the curve reach its target after exactly the stage's step count
+    // instead of only approaching it.
+    static constexpr int32_t ADSR_EXP_ONE = (int32_t)1 << 30;
+
+    bool _isExponential() const
+    {
+#if ADSR_BEZIER_EXP_ONLY
+        return true;
 #else
-        unsigned long decay_ticks = l_decay_ms;          // ms
+        return _exponential;
 #endif
-        _decay = decay_ticks;
+    }
 
-        if (_decay > 0 && _decay <= _time_q24_max_ticks)
-        {
-            _decay_scale_q24 = (((uint64_t)(ARRAY_SIZE - 1)) << 24) / (uint64_t)_decay;
-        }
-        else
-        {
-            _decay_scale_q24 = 0;
-        }
+    // Stage curvature (time constants per stage) from the legacy per-entry
+    // coefficient for 1024 entries; 0 (straight line) outside (0, 1)
+    static float _expCurve(float alpha)
+    {
+        if (!(alpha > 0.0f && alpha < 1.0f))
+            return 0.0f;
+        return -1024.0f * logf(alpha);
     }
 
-    void setSustain(int l_sustain)
+    // k = exp(-curve / steps), b = (1 - k) * e / (1 - e) with e = exp(-curve),
+    // for a stage of `ticks` stepped every _exp_period ticks (once per tick()
+    // call when a tick rate is set). Setters only.
+    void _expCoefficients(unsigned long ticks, float curve, int32_t &k, int32_t &b) const
     {
-        if (l_sustain < 0)
-            l_sustain = 0;
-        if (l_sustain >= _vertical_resolution)
-            l_sustain = _vertical_resolution;
-        _sustain = l_sustain;
+        if (ticks == 0)
+        {
+            k = 0;
+            b = 0;
+            return;
+        }
 
-        // Precompute decay output range scale: from sustain up to full level
-        // out = sustain + curveVal * (vertical_resolution - sustain) / vertical_resolution
-        int32_t range = (int32_t)_vertical_resolution - (int32_t)_sustain;
-        if (range < 0)
-            range = 0;
-        if (_vertical_resolution > 0)
+        float steps = (_tick_rate > 0) ? (float)ticks * (float)_tick_rate / (float)_ticksPerSecond()
+                                       : (float)ticks / (float)_exp_period;
+        if (steps < 1.0f)
+            steps = 1.0f;
+
+        float one_minus_k;
+        float offset;
+        if (curve < 1e-4f)
         {
-            _decay_range_scale_q16 = (int32_t)(((int32_t)range << 16) / _vertical_resolution);
+            one_minus_k = 0.0f; // straight line
+            offset = 1.0f / steps;
         }
         else
         {
-            _decay_range_scale_q16 = 0;
+            float x = curve / steps;
+            one_minus_k = (x < 1e-3f) ? x * (1.0f - 0.5f * x) : 1.0f - expf(-x);
+            float e = expf(-curve);
+            offset = one_minus_k * e / (1.0f - e);
         }
+        k = ADSR_EXP_ONE - (int32_t)(one_minus_k * (float)ADSR_EXP_ONE + 0.5f);
+        b = (int32_t)(offset * (float)ADSR_EXP_ONE + 0.5f);
     }
 
-    // Release time in milliseconds
-    void setRelease(unsigned long l_release_ms)
+    void _expUpdateCoefficients()
     {
-        // Convert to internal timebase (ticks)
-#if ADSR_BEZIER_USE_MICROS
-        unsigned long release_ticks = l_release_ms * 1000UL; // µs
-#else
-        unsigned long release_ticks = l_release_ms;          // ms
-#endif
-        _release = release_ticks;
+        if (!_isExponential())
+            return;
+        _expCoefficients(_attack, _exp_attack_curve, _attack_exp_k, _attack_exp_b);
+        _expCoefficients(_decay, _exp_decay_release_curve, _decay_exp_k, _decay_exp_b);
+        _expCoefficients(_release, _exp_decay_release_curve, _release_exp_k, _release_exp_b);
+    }
+
+    static int32_t _expMul(int32_t a, int32_t b)
+    {
+        return (int32_t)(((int64_t)a * b) >> 30);
+    }
+
+    void _expStart(unsigned long now)
+    {
+        _exp_u = ADSR_EXP_ONE;
+        _exp_next = now + _exp_period;
+    }
+
+    void _expStep(int32_t k, int32_t b)
+    {
+        int32_t u = _expMul(k, _exp_u) - b;
+        _exp_u = u > 0 ? u : 0;
+    }
 
-        if (_release > 0 && _release <= _time_q24_max_ticks)
+    // Runs every step due at or before l_ticks. Calls at the step rate take one
+    // step; after a gap the n steps are combined by squaring (log2(n) multiplies).
+    void _expAdvance(unsigned long l_ticks, int32_t k, int32_t b)
+    {
+        long late = (long)(l_ticks - _exp_next);
+        if (late < 0)
+            return;
+
+        unsigned long steps = 1;
+        if ((unsigned long)late >= _exp_period)
+            steps += (unsigned long)late / _exp_period;
+        _exp_next += steps * _exp_period;
+
+        if (steps == 1)
         {
-            _release_scale_q24 = (((uint64_t)(ARRAY_SIZE - 1)) << 24) / (uint64_t)_release;
+            _expStep(k, b);
+            return;
         }
-        else
+
+        // (k, b) applied `steps` times: u -> rk * u - rb
+        ADSR_BEZIER_STAT(slow_path, 1);
+        int32_t rk = ADSR_EXP_ONE;
+        int32_t rb = 0;
+        while (steps != 0)
         {
-            _release_scale_q24 = 0;
+            if (steps & 1)
+            {
+                rb = _expMul(k, rb) + b;
+                rk = _expMul(rk, k);
+            }
+            b = _expMul(k, b) + b;
+            k = _expMul(k, k);
+            steps >>= 1;
         }
+        int32_t u = _expMul(rk, _exp_u) - rb;
+        _exp_u = u > 0 ? u : 0;
     }
 
-    // Use current micros() timestamp internally
-    void noteOn()
+    int _expOutput(int32_t from, int32_t to) const
     {
-        unsigned long now;
-#if ADSR_BEZIER_USE_MICROS
-        now = micros();
-#else
-        now = millis();
-#endif
-        _t_note_on = now; // set new timestamp for note_on
-        if (_reset_attack)     // set start value new Attack
-            _attack_start = 0; // if _reset_attack equals true, a new trigger starts with 0
-        else
-            _attack_start = _adsr_output; // if _reset_attack equals false, a new trigger starts with the current value
-        _notes_pressed++;                 // increase number of pressed notes with one
+        int32_t out = to + (int32_t)(((int64_t)(from - to) * _exp_u) >> 30);
+        return _clampOutput(out);
+    }
 
-        // Start attack phase
-        _phase = ADSR_PHASE_ATTACK;
-        _t_phase_start = now;
+    // Map a curve value to the output range of a stage (Q16 scale), clamped
+    int _stageOutput(int curveVal, int32_t base, int32_t range_scale_q16) const
+    {
+        int32_t out = base + adsrRangeMapQ16(curveVal, range_scale_q16);
+        return _clampOutput(out);
+    }
 
-        // Precompute attack output range scale: from attack_start up to full level
-        // out = attack_start + curveVal * (vertical_resolution - attack_start) / vertical_resolution
-        int32_t range = (int32_t)_vertical_resolution - (int32_t)_attack_start;
-        if (range < 0)
-            range = 0;
-        if (_vertical_resolution > 0)
+    int _clampOutput(int32_t out) const
+    {
+        if (out < 0)
         {
-            _attack_range_scale_q16 = (int32_t)(((int32_t)range << 16) / _vertical_resolution);
+            ADSR_BEZIER_STAT(clamps, 1);
+            out = 0;
         }
-        else
+        if (out > _vertical_resolution)
         {
-            _attack_range_scale_q16 = 0;
+            ADSR_BEZIER_STAT(clamps, 1);
+            out = _vertical_resolution;
         }
+        return (int)out;
     }
 
-    void noteOff()
+    // Instrumentation around getWave() / tick(): count the sample in its
+    // phase and a phase change, and time every ADSR_BEZIER_STATS_CYCLES-th call.
+    // Empty unless ADSR_BEZIER_STATS.
+    uint32_t _statEnter()
     {
-        _notes_pressed--;
-        if (_notes_pressed <= 0)
-        {                                  // if all notes are depressed - start release
-            unsigned long now;
-#if ADSR_BEZIER_USE_MICROS
-            now = micros();
-#else
-            now = millis();
+#if ADSR_BEZIER_STATS && ADSR_BEZIER_STATS_CYCLES
+        if ((++_stat_calls & (ADSR_BEZIER_STATS_CYCLES - 1)) == 0)
+            return ADSR_BEZIER_STATS_CLOCK();
 #endif
-            _t_note_off = now;             // set timestamp for note off
-            _release_start = _adsr_output; // set start value for release
-            _notes_pressed = 0;
-
-            // Start release phase
-            _phase = ADSR_PHASE_RELEASE;
-            _t_phase_start = now;
+        return 0;
+    }
 
-            // Precompute release output range scale: from release_start down to 0
-            // out = curveVal * release_start / vertical_resolution
-            int32_t rs = (int32_t)_release_start;
-            if (rs < 0)
-                rs = 0;
-            if (rs > _vertical_resolution)
-                rs = _vertical_resolution;
-            if (_vertical_resolution > 0)
-            {
-                _release_range_scale_q16 = (int32_t)((rs << 16) / _vertical_resolution);
-            }
-            else
-            {
-                _release_range_scale_q16 = 0;
-            }
+    void _statLeave(ADSRPhase phase_in, uint32_t t0)
+    {
+#if ADSR_BEZIER_STATS
+        ADSR_BEZIER_STAT(calls[phase_in], 1);
+        ADSR_BEZIER_STAT(transitions, _phase != phase_in);
+#if ADSR_BEZIER_STATS_CYCLES
+        if ((_stat_calls & (ADSR_BEZIER_STATS_CYCLES - 1)) == 0)
+        {
+            uint32_t cycles = ADSR_BEZIER_STATS_CLOCK() - t0;
+            ADSR_BEZIER_STAT(cycle_samples, 1);
+            ADSR_BEZIER_STAT(cycles_total, cycles);
+            if (cycles < _stats.cycles_min)
+                _stats.cycles_min = cycles;
+            if (cycles > _stats.cycles_max)
+                _stats.cycles_max = cycles;
+#if ADSR_BEZIER_STATS_GLOBAL
+            AdsrStats &global = AdsrStatsStorage<>::global;
+            if (cycles < global.cycles_min)
+                global.cycles_min = cycles;
+            if (cycles > global.cycles_max)
+                global.cycles_max = cycles;
+#endif
         }
+#endif
+#endif
+        (void)phase_in;
+        (void)t0;
     }
 
-    // Compute ADSR value based on current timebase (micros or millis)
-    int getWave()
+    // getWave(now) without the trace record (also the stage ends inside renderBlock())
+    int _getWave(unsigned long l_ticks)
     {
-        unsigned long l_ticks;
-#if ADSR_BEZIER_USE_MICROS
-        l_ticks = micros();
-#else
-        l_ticks = millis();
-#endif
         unsigned long delta = 0;
+        _t_last = l_ticks;
+        const ADSRPhase phase_in = _phase;
+        const uint32_t stat_t0 = _statEnter();
 
         switch (_phase)
         {
@@ -309,6 +2002,7 @@ public:
                 {
                     _phase = ADSR_PHASE_DECAY;
                     _t_phase_start = l_ticks;
+                    _expStart(l_ticks);
                 }
                 else
                 {
@@ -327,6 +2021,7 @@ public:
                 {
                     _phase = ADSR_PHASE_DECAY;
                     _t_phase_start = l_ticks;
+                    _expStart(l_ticks);
                 }
                 else
                 {
@@ -335,30 +2030,22 @@ public:
                 break;
             }
 
-            // Time->index mapping for attack
-            uint32_t idx;
-            if (_attack > 0 && _attack <= _time_q24_max_ticks && _attack_scale_q24 != 0)
-            {
-                idx = (uint32_t)(((uint64_t)delta * _attack_scale_q24) >> 24);
-            }
-            else
+            if (_isExponential())
             {
-                idx = (uint32_t)(((uint64_t)(ARRAY_SIZE - 1) * (uint64_t)delta) / (uint64_t)_attack);
+                _expAdvance(l_ticks, _attack_exp_k, _attack_exp_b);
+                _adsr_output = _expOutput(_attack_start, _vertical_resolution);
+                break;
             }
-            if (idx >= ARRAY_SIZE)
-                idx = ARRAY_SIZE - 1;
+
+            // Time->index mapping for attack
+            uint32_t pos = adsrStagePosition(delta, _attack, _attack_scale);
+            ADSR_BEZIER_STAT(slow_path, _attack > ADSR_BEZIER_Q24_MAX_TICKS);
 
             // Attack curve runs "backwards" through the table
-            int curveVal = _curve_tables[_bezier_attack_type][(ARRAY_SIZE - 1) - (int)idx];
+            int curveVal = adsrCurveLookupMorph(_attack_table, _attack_table_b, adsrStagePositionMax() - pos, _attack_morph);
 
             // Map to output
-            int32_t out = (int32_t)_attack_start +
-                          (int32_t)(((int32_t)curveVal * _attack_range_scale_q16) >> 16);
-            if (out < 0)
-                out = 0;
-            if (out > _vertical_resolution)
-                out = _vertical_resolution;
-            _adsr_output = (int)out;
+            _adsr_output = _stageOutput(curveVal, _attack_start, _attack_range_scale_q16);
             break;
         }
 
@@ -382,27 +2069,19 @@ public:
                 break;
             }
 
-            uint32_t idx;
-            if (_decay > 0 && _decay <= _time_q24_max_ticks && _decay_scale_q24 != 0)
-            {
-                idx = (uint32_t)(((uint64_t)delta * _decay_scale_q24) >> 24);
-            }
-            else
+            if (_isExponential())
             {
-                idx = (uint32_t)(((uint64_t)(ARRAY_SIZE - 1) * (uint64_t)delta) / (uint64_t)_decay);
+                _expAdvance(l_ticks, _decay_exp_k, _decay_exp_b);
+                _adsr_output = _expOutput(_vertical_resolution, _sustain);
+                break;
             }
-            if (idx >= ARRAY_SIZE)
-                idx = ARRAY_SIZE - 1;
-
-            int curveVal = _curve_tables[_bezier_decay_type][(int)idx];
-
-            int32_t out = (int32_t)_sustain +
-                          (int32_t)(((int32_t)curveVal * _decay_range_scale_q16) >> 16);
-            if (out < 0)
-                out = 0;
-            if (out > _vertical_resolution)
-                out = _vertical_resolution;
-            _adsr_output = (int)out;
+
+            uint32_t pos = adsrStagePosition(delta, _decay, _decay_scale);
+            ADSR_BEZIER_STAT(slow_path, _decay > ADSR_BEZIER_Q24_MAX_TICKS);
+
+            int curveVal = adsrCurveLookupMorph(_decay_table, _decay_table_b, pos, _decay_morph);
+
+            _adsr_output = _stageOutput(curveVal, _sustain, _decay_range_scale_q16);
             break;
         }
 
@@ -430,26 +2109,19 @@ public:
                 break;
             }
 
-            uint32_t idx;
-            if (_release > 0 && _release <= _time_q24_max_ticks && _release_scale_q24 != 0)
+            if (_isExponential())
             {
-                idx = (uint32_t)(((uint64_t)delta * _release_scale_q24) >> 24);
-            }
-            else
-            {
-                idx = (uint32_t)(((uint64_t)(ARRAY_SIZE - 1) * (uint64_t)delta) / (uint64_t)_release);
+                _expAdvance(l_ticks, _release_exp_k, _release_exp_b);
+                _adsr_output = _expOutput(_release_start, 0);
+                break;
             }
-            if (idx >= ARRAY_SIZE)
-                idx = ARRAY_SIZE - 1;
 
-            int curveVal = _curve_tables[_bezier_release_type][(int)idx];
+            uint32_t pos = adsrStagePosition(delta, _release, _release_scale);
+            ADSR_BEZIER_STAT(slow_path, _release > ADSR_BEZIER_Q24_MAX_TICKS);
 
-            int32_t out = (int32_t)(((int32_t)curveVal * _release_range_scale_q16) >> 16);
-            if (out < 0)
-                out = 0;
-            if (out > _vertical_resolution)
-                out = _vertical_resolution;
-            _adsr_output = (int)out;
+            int curveVal = adsrCurveLookupMorph(_release_table, _release_table_b, pos, _release_morph);
+
+            _adsr_output = _stageOutput(curveVal, 0, _release_range_scale_q16);
             break;
         }
 
@@ -460,89 +2132,381 @@ public:
             break;
         }
         }
+        _statLeave(phase_in, stat_t0);
         return _adsr_output;
     }
 
-    // Función que calcula un punto en la curva de Bézier cúbica para un valor dado de t
-    Point bezierCubic(const Point &A, const Point &P1, const Point &P2, const Point &B, float t)
+    // renderBlock() / renderBlockDecimated(): Ramp selects the stage loop
+    template <bool Ramp>
+    void _renderBlock(int *out, size_t n, unsigned long start_tick, unsigned long tick_step, unsigned ramp_shift)
     {
-        float one_minus_t = 1.0f - t;
-        float one_minus_t_squared = one_minus_t * one_minus_t;
-        float t_squared = t * t;
-        float x = one_minus_t_squared * one_minus_t * A.x +
-                  3 * one_minus_t_squared * t * P1.x +
-                  3 * one_minus_t * t_squared * P2.x +
-                  t_squared * t * B.x;
-        float y = one_minus_t_squared * one_minus_t * A.y +
-                  3 * one_minus_t_squared * t * P1.y +
-                  3 * one_minus_t * t_squared * P2.y +
-                  t_squared * t * B.y;
-        return {x, y};
-    }
+        unsigned long l_ticks = start_tick;
+        size_t i = 0;
 
-    // Función para encontrar el valor de y dado un valor de x en la curva de Bézier
-    float findYForX(const Point &A, const Point &P1, const Point &P2, const Point &B, float xTarget, float tol = 1e-6)
-    {
-        float tLow = 0.0f;
-        float tHigh = 1.0f;
-        float tMid;
+        if (_isExponential())
+        {
+            // No table to stream through: the recurrence is already one multiply-add per step
+            // (_getWave() counts the samples)
+            for (; i < n; ++i, l_ticks += tick_step)
+                out[i] = _getWave(l_ticks);
+            return;
+        }
 
-        while ((tHigh - tLow) > tol)
+        while (i < n)
         {
-            tMid = (tLow + tHigh) / 2.0f;
-            Point midPoint = bezierCubic(A, P1, P2, B, tMid);
-            if (midPoint.x < xTarget)
+            size_t run = 0;
+
+            switch (_phase)
             {
-                tLow = tMid;
+            case ADSR_PHASE_ATTACK:
+                // Attack curve runs "backwards" through the table
+                run = Ramp ? _renderStageRamp(out + i, n - i, l_ticks, tick_step, _attack, _attack_scale,
+                                        _attack_table, _attack_table_b, _attack_morph, true,
+                                        _attack_start, _attack_range_scale_q16, ramp_shift)
+                           : _renderStage(out + i, n - i, l_ticks, tick_step, _attack, _attack_scale,
+                                        _attack_table, _attack_table_b, _attack_morph, true,
+                                        _attack_start, _attack_range_scale_q16);
+                break;
+
+            case ADSR_PHASE_DECAY:
+                run = Ramp ? _renderStageRamp(out + i, n - i, l_ticks, tick_step, _decay, _decay_scale,
+                                        _decay_table, _decay_table_b, _decay_morph, false,
+                                        _sustain, _decay_range_scale_q16, ramp_shift)
+                           : _renderStage(out + i, n - i, l_ticks, tick_step, _decay, _decay_scale,
+                                        _decay_table, _decay_table_b, _decay_morph, false,
+                                        _sustain, _decay_range_scale_q16);
+                break;
+
+            case ADSR_PHASE_RELEASE:
+                run = Ramp ? _renderStageRamp(out + i, n - i, l_ticks, tick_step, _release, _release_scale,
+                                        _release_table, _release_table_b, _release_morph, false,
+                                        0, _release_range_scale_q16, ramp_shift)
+                           : _renderStage(out + i, n - i, l_ticks, tick_step, _release, _release_scale,
+                                        _release_table, _release_table_b, _release_morph, false,
+                                        0, _release_range_scale_q16);
+                break;
+
+            case ADSR_PHASE_SUSTAIN:
+            case ADSR_PHASE_IDLE:
+            default:
+            {
+                // Constant output until the next noteOn()/noteOff()
+                int level = (_phase == ADSR_PHASE_SUSTAIN) ? _sustain : 0;
+                ADSR_BEZIER_STAT(calls[_phase], n - i);
+                for (; i < n; ++i)
+                    out[i] = level;
+                _adsr_output = level;
+                _t_last = start_tick + (unsigned long)(n - 1) * tick_step;
+                return;
             }
-            else
+            }
+
+            ADSR_BEZIER_STAT(calls[_phase], run);
+            i += run;
+            l_ticks += (unsigned long)run * tick_step;
+            if (run > 0)
+                _t_last = l_ticks - tick_step;
+
+            // The next sample crosses a phase boundary: let the state machine handle it
+            if (i < n)
             {
-                tHigh = tMid;
+                out[i++] = _getWave(l_ticks);
+                l_ticks += tick_step;
             }
         }
+    }
 
-        Point resultPoint = bezierCubic(A, P1, P2, B, tMid);
-        return resultPoint.y;
+    // Inner loop of renderBlock() for one timed stage (reversed: attack reads
+    // the table backwards). Writes samples while the stage is still running
+    // and returns their count.
+    size_t _renderStage(int *out, size_t n, unsigned long l_ticks, unsigned long tick_step,
+                        unsigned long duration, uint64_t scale, const adsr_curve_t *table,
+                        const adsr_curve_t *table_b, int32_t morph, bool reversed,
+                        int32_t base, int32_t range_scale_q16)
+    {
+        if (duration == 0)
+            return 0;
+
+        unsigned long delta = l_ticks - _t_phase_start;
+        const uint32_t pos_max = adsrStagePositionMax();
+        // reversed position = pos_max - pos = ((pos ^ m) - m) + (m & pos_max)
+        const uint32_t m = reversed ? 0xFFFFFFFFUL : 0;
+        const uint32_t flip = m & pos_max;
+        size_t i = 0;
+
+        const unsigned shift = adsrStageShift(duration);
+        for (; i < n && delta < duration; ++i, delta += tick_step)
+        {
+            uint32_t pos = (uint32_t)(((uint64_t)delta * scale) >> shift);
+            if (pos > pos_max)
+                pos = pos_max;
+            out[i] = _stageOutput(adsrCurveLookupMorph(table, table_b, ((pos ^ m) - m) + flip, morph), base, range_scale_q16);
+        }
+
+        if (i > 0)
+            _adsr_output = out[i - 1];
+        ADSR_BEZIER_STAT(slow_path, duration > ADSR_BEZIER_Q24_MAX_TICKS ? i : 0);
+        return i;
     }
 
-private:
-    int _bezier_attack_type;
-    int _bezier_decay_type;
-    int _bezier_release_type;
+    // Output of a timed stage delta ticks in (the _renderStage() loop body)
+    int _stageValue(unsigned long delta, uint64_t scale, unsigned shift, uint32_t pos_max, uint32_t m, uint32_t flip,
+                    const adsr_curve_t *table, const adsr_curve_t *table_b, int32_t morph,
+                    int32_t base, int32_t range_scale_q16) const
+    {
+        uint32_t pos = (uint32_t)(((uint64_t)delta * scale) >> shift);
+        if (pos > pos_max)
+            pos = pos_max;
+        return _stageOutput(adsrCurveLookupMorph(table, table_b, ((pos ^ m) - m) + flip, morph), base, range_scale_q16);
+    }
+
+    // _renderStage() with the curve looked up every 2^ramp_shift samples and
+    // linear ramps in between. The lookup at the end of a ramp may lie past the
+    // block. Ramps reaching the stage end are replaced by exact samples.
+    size_t _renderStageRamp(int *out, size_t n, unsigned long l_ticks, unsigned long tick_step,
+                            unsigned long duration, uint64_t scale, const adsr_curve_t *table,
+                            const adsr_curve_t *table_b, int32_t morph, bool reversed,
+                            int32_t base, int32_t range_scale_q16, unsigned ramp_shift)
+    {
+        unsigned long delta = l_ticks - _t_phase_start;
+        if (duration == 0 || delta >= duration)
+            return 0;
+
+        const uint32_t pos_max = adsrStagePositionMax();
+        const uint32_t m = reversed ? 0xFFFFFFFFUL : 0;
+        const uint32_t flip = m & pos_max;
+        const unsigned shift = adsrStageShift(duration);
+        const size_t k = (size_t)1 << ramp_shift;
+        const unsigned long span = tick_step << ramp_shift;
+        size_t i = 0;
+        int32_t from = _stageValue(delta, scale, shift, pos_max, m, flip, table, table_b, morph, base, range_scale_q16);
+        while (i < n)
+        {
+            if (duration - delta <= span)
+            {
+                // The stage ends within this ramp: exact samples up to its end
+                for (; i < n && delta < duration; ++i, delta += tick_step)
+                    out[i] = _stageValue(delta, scale, shift, pos_max, m, flip, table, table_b, morph, base, range_scale_q16);
+                break;
+            }
+
+            int32_t to = _stageValue(delta + span, scale, shift, pos_max, m, flip, table, table_b, morph, base, range_scale_q16);
+            int32_t diff = to - from;
+            size_t count = n - i < k ? n - i : k;
+            for (size_t j = 0; j < count; ++j)
+                out[i + j] = from + ((diff * (int32_t)j) >> ramp_shift);
+            i += count;
+            delta += span;
+            from = to;
+        }
+
+        if (i > 0)
+            _adsr_output = out[i - 1];
+        ADSR_BEZIER_STAT(slow_path, duration > ADSR_BEZIER_Q24_MAX_TICKS ? i : 0);
+        return i;
+    }
+
+#if ADSR_BEZIER_TRACE
+    static void _traceRecord(AdsrTraceSink &sink, uint8_t op, uint8_t sub, uint16_t n, unsigned long tick, uint32_t a, uint32_t b)
+    {
+        AdsrTraceRecord record;
+        record.op = op;
+        record.sub = sub;
+        record.n = n;
+        record.tick = (uint32_t)tick;
+        record.a = a;
+        record.b = b;
+        sink.write(record);
+    }
+
+    // End of an event's records: keyframe every _trace_interval events
+    void _traceDone()
+    {
+        if (_trace_interval != 0 && ++_trace_events >= _trace_interval)
+        {
+            _trace_events = 0;
+            _traceKeyframe(*_trace);
+        }
+    }
+
+    void _traceEvent(uint8_t op, uint8_t sub, uint16_t n, unsigned long tick, uint32_t a, uint32_t b)
+    {
+        _traceRecord(*_trace, op, sub, n, tick, a, b);
+        _traceDone();
+    }
+
+    // Samples of one renderBlock() call, n x level when out is nullptr
+    void _traceBlock(const int *out, int level, size_t n, unsigned long start_tick, unsigned long tick_step, unsigned ramp_shift)
+    {
+        if (n == 0)
+            return;
+        for (size_t i = 0; i < n;)
+        {
+            size_t m = n - i < (size_t)ADSR_BEZIER_TRACE_BLOCK_MAX ? n - i : (size_t)ADSR_BEZIER_TRACE_BLOCK_MAX;
+            uint32_t h = ADSR_TRACE_HASH_INIT;
+            for (size_t j = 0; j < m; ++j)
+                h = adsrTraceHash(h, (uint32_t)(out != nullptr ? out[i + j] : level));
+            uint8_t sub = (uint8_t)(ramp_shift | (i + m < n ? ADSR_TRACE_BLOCK_MORE : 0));
+            _traceRecord(*_trace, ADSR_TRACE_BLOCK, sub, (uint16_t)m, start_tick + (unsigned long)i * tick_step, (uint32_t)tick_step, h);
+            i += m;
+        }
+        _traceDone();
+    }
+
+    static void _traceStageRecords(AdsrTraceSink &sink, ADSRPhase stage, unsigned long ticks, uint64_t scale, unsigned long now)
+    {
+        bool custom = scale != adsrStageScale(ticks);
+        if (custom)
+            _traceRecord(sink, ADSR_TRACE_STAGE_SCALE, stage, 0, 0, (uint32_t)scale, (uint32_t)(scale >> 32));
+        _traceRecord(sink, ADSR_TRACE_STAGE, stage, custom ? 1 : 0, now, (uint32_t)ticks, 0);
+    }
+
+    void _traceStage(ADSRPhase stage, unsigned long ticks, uint64_t scale, unsigned long now)
+    {
+        _traceStageRecords(*_trace, stage, ticks, scale, now);
+        _traceDone();
+    }
+
+    // Built-in curve index, or ADSR_TRACE_TABLE_* with the hash of an external table
+    static uint32_t _traceCurveId(const adsr_curve_t *table, uint32_t &hash)
+    {
+        hash = 0;
+        if (table == nullptr)
+            return ADSR_TRACE_TABLE_NONE;
+#if !ADSR_BEZIER_EXP_ONLY
+        for (uint32_t j = 0; j < 8; ++j)
+            if (table == _curve_tables[j])
+                return j;
+#endif
+        hash = ADSR_TRACE_HASH_INIT;
+        for (size_t i = 0; i < ARRAY_SIZE; ++i)
+            hash = adsrTraceHash(hash, (uint32_t)table[i]);
+        return ADSR_TRACE_TABLE_EXTERNAL;
+    }
+
+    // Both tables and the morph weight of a stage
+    void _traceCurveRecords(AdsrTraceSink &sink, ADSRPhase stage) const
+    {
+        const adsr_curve_t *tables[2] = {_attack_table, _attack_table_b};
+        int32_t morph = _attack_morph;
+        if (stage == ADSR_PHASE_DECAY)
+        {
+            tables[0] = _decay_table;
+            tables[1] = _decay_table_b;
+            morph = _decay_morph;
+        }
+        else if (stage == ADSR_PHASE_RELEASE)
+        {
+            tables[0] = _release_table;
+            tables[1] = _release_table_b;
+            morph = _release_morph;
+        }
+
+        for (uint16_t n = 0; n < 2; ++n)
+        {
+            uint32_t hash;
+            uint32_t id = _traceCurveId(tables[n], hash);
+            _traceRecord(sink, ADSR_TRACE_CURVE, stage, n, 0, id, hash);
+        }
+        _traceRecord(sink, ADSR_TRACE_MORPH, stage, 0, 0, (uint32_t)morph, 0);
+    }
+
+    void _traceCurve(ADSRPhase stage)
+    {
+        _traceCurveRecords(*_trace, stage);
+        _traceDone();
+    }
+
+    // Everything getWave() / renderBlock() / tick() depend on, as setter
+    // records plus the running state (AdsrTraceReplay restores and compares it)
+    void _traceKeyframe(AdsrTraceSink &sink) const
+    {
+        uint32_t attack_curve;
+        uint32_t decay_release_curve;
+        memcpy(&attack_curve, &_exp_attack_curve, sizeof(attack_curve));
+        memcpy(&decay_release_curve, &_exp_decay_release_curve, sizeof(decay_release_curve));
+
+        _traceRecord(sink, ADSR_TRACE_KEY_BEGIN, _isExponential() ? 1 : 0, 0, _t_last, (uint32_t)_vertical_resolution, 0);
+        _traceRecord(sink, ADSR_TRACE_KEY_EXP, 0, 0, 0, attack_curve, decay_release_curve);
+        _traceRecord(sink, ADSR_TRACE_TICK_RATE, 0, 0, 0, (uint32_t)_tick_rate, 0);
+        _traceRecord(sink, ADSR_TRACE_SUSTAIN, 0, 0, 0, (uint32_t)_sustain, (uint32_t)_decay_range_scale_q16);
+        _traceRecord(sink, ADSR_TRACE_RESET_ATTACK, _reset_attack ? 1 : 0, 0, 0, 0, 0);
+        _traceStageRecords(sink, ADSR_PHASE_ATTACK, _attack, _attack_scale, _t_last);
+        _traceStageRecords(sink, ADSR_PHASE_DECAY, _decay, _decay_scale, _t_last);
+        _traceStageRecords(sink, ADSR_PHASE_RELEASE, _release, _release_scale, _t_last);
+        _traceCurveRecords(sink, ADSR_PHASE_ATTACK);
+        _traceCurveRecords(sink, ADSR_PHASE_DECAY);
+        _traceCurveRecords(sink, ADSR_PHASE_RELEASE);
+        _traceRecord(sink, ADSR_TRACE_KEY_STATE, _phase, 0, _t_phase_start, (uint32_t)_adsr_output, (uint32_t)_notes_pressed);
+        _traceRecord(sink, ADSR_TRACE_KEY_LEVELS, 0, 0, 0, (uint32_t)_attack_start, (uint32_t)_release_start);
+        _traceRecord(sink, ADSR_TRACE_KEY_TICK_ACC, _tick_stage_end ? 1 : 0, 0, 0, (uint32_t)_tick_acc, (uint32_t)(_tick_acc >> 32));
+        _traceRecord(sink, ADSR_TRACE_KEY_EXP_STATE, 0, 0, _exp_next, (uint32_t)_exp_u, 0);
+        _traceRecord(sink, ADSR_TRACE_KEY_END, 0, 0, 0, 0, 0);
+    }
+#endif
+
+    // Curve table of each stage
+#if ADSR_BEZIER_EXP_ONLY
+    const adsr_curve_t *_attack_table = nullptr;
+    const adsr_curve_t *_decay_table = nullptr;
+    const adsr_curve_t *_release_table = nullptr;
+#else
+    const adsr_curve_t *_attack_table = _curve_tables[0];
+    const adsr_curve_t *_decay_table = _curve_tables[0];
+    const adsr_curve_t *_release_table = _curve_tables[0];
+#endif
+
+    // Second curve and Q15 morph weight of each stage (weight 0: first curve only)
+    const adsr_curve_t *_attack_table_b = nullptr;
+    const adsr_curve_t *_decay_table_b = nullptr;
+    const adsr_curve_t *_release_table_b = nullptr;
+    int32_t _attack_morph = 0;
+    int32_t _decay_morph = 0;
+    int32_t _release_morph = 0;
 
     int _vertical_resolution;   // number of bits for output, control, etc
+    uint32_t _vres_recip = 0;   // adsrRangeReciprocal(_vertical_resolution)
+    uint32_t _gain_recip = 0;   // adsrGainReciprocal(_vertical_resolution)
     unsigned long _attack = 0;  // 0 to 20 sec (in microseconds)
     unsigned long _decay = 0;   // 1ms to 60 sec  (in microseconds)
     int _sustain = 0;           // 0 to -60dB -> then -inf
     unsigned long _release = 0; // 1ms to 60 sec (in microseconds)
     bool _reset_attack = false; // if _reset_attack is "true" a new trigger starts with 0, if _reset_attack is false it starts with the current output value
 
-    // Threshold for using Q24 fixed-point vs exact division (in internal ticks)
-#if ADSR_BEZIER_USE_MICROS
-    static constexpr unsigned long _time_q24_max_ticks = 2000000UL; // 2 seconds in µs
-#else
-    static constexpr unsigned long _time_q24_max_ticks = 2000UL;    // 2 seconds in ms
-#endif
-
-    // Precomputed fixed-point (Q24) scales for fast time->index conversion
-    uint64_t _attack_scale_q24 = 0;
-    uint64_t _decay_scale_q24  = 0;
-    uint64_t _release_scale_q24 = 0;
+    // Precomputed fixed-point scales for time->index conversion (see adsrStageScale())
+    uint64_t _attack_scale = 0;
+    uint64_t _decay_scale  = 0;
+    uint64_t _release_scale = 0;
+
+    // Fixed-rate mode (tick()): calls per second, per-stage accumulator increments, running stage
+    unsigned long _tick_rate = 0;
+    uint64_t _attack_inc = 0;
+    uint64_t _decay_inc = 0;
+    uint64_t _release_inc = 0;
+    uint64_t _tick_acc = 0;
+    bool _tick_stage_end = false;
+
+    // Exponential mode: curvature per stage, step period (ticks), Q30
+    // coefficients per stage, state of the running stage and its next step
+    bool _exponential = false;
+    float _exp_attack_curve = 0.0f;
+    float _exp_decay_release_curve = 0.0f;
+    unsigned long _exp_period = ADSR_BEZIER_EXP_STEP_TICKS;
+    int32_t _attack_exp_k = 0;
+    int32_t _attack_exp_b = 0;
+    int32_t _decay_exp_k = 0;
+    int32_t _decay_exp_b = 0;
+    int32_t _release_exp_k = 0;
+    int32_t _release_exp_b = 0;
+    int32_t _exp_u = 0;
+    unsigned long _exp_next = 0;
 
     // Internal ADSR phase state
-    enum ADSRPhase
-    {
-        ADSR_PHASE_IDLE = 0,
-        ADSR_PHASE_ATTACK,
-        ADSR_PHASE_DECAY,
-        ADSR_PHASE_SUSTAIN,
-        ADSR_PHASE_RELEASE
-    };
-
     ADSRPhase _phase = ADSR_PHASE_IDLE;
 
-    // Phase start time (ticks) for the current stage
+    // Phase start time (ticks) for the current stage, last getWave() timestamp
     unsigned long _t_phase_start = 0;
+    unsigned long _t_last = 0;
 
     // Precomputed fixed-point (Q16) scales for fast curve->output mapping
     int32_t _attack_range_scale_q16 = 0;
@@ -554,119 +2518,135 @@ private:
     unsigned long _t_note_off = 0;
 
     // internal values needed to transition to new pulse (attack) and to release at any point in time
-    int _adsr_output;
-    int _release_start;
-    int _attack_start;
+    int _adsr_output = 0;
+    int _release_start = 0;
+    int _attack_start = 0;
     int _notes_pressed = 0;
-};
-
-// ---------------------------------------------------------------------------
-// Bézier table generation helpers
-// ---------------------------------------------------------------------------
 
-// Global Bézier lookup tables shared by all ADSR instances.
-// ARRAY_SIZE is provided by the including project before this header.
-int _curve0_table[ARRAY_SIZE];
-int _curve1_table[ARRAY_SIZE];
-int _curve2_table[ARRAY_SIZE];
-int _curve3_table[ARRAY_SIZE];
-int _curve4_table[ARRAY_SIZE];
-int _curve5_table[ARRAY_SIZE];
-int _curve6_table[ARRAY_SIZE];
-int _curve7_table[ARRAY_SIZE];
-
-int *_curve_tables[8] = {
-    _curve0_table, _curve1_table, _curve2_table, _curve3_table,
-    _curve4_table, _curve5_table, _curve6_table, _curve7_table};
+#if ADSR_BEZIER_STATS
+    // Instrumentation counters (mutable: the const output mapping counts clamps)
+    mutable AdsrStats _stats;
+    uint32_t _stat_calls = 0;
+#endif
 
-// Lightweight point type used for table generation
-struct ADSRBezierPoint
-{
-    float x, y;
+#if ADSR_BEZIER_TRACE
+    // Trace sink (nullptr: off), events per keyframe and since the last one
+    AdsrTraceSink *_trace = nullptr;
+    uint32_t _trace_interval = 1024;
+    uint32_t _trace_events = 0;
+#endif
 };
 
-// Evaluate a cubic Bézier at parameter t in [0, 1]
-inline ADSRBezierPoint adsrBezierCubic(const ADSRBezierPoint &A,
-                                       const ADSRBezierPoint &P1,
-                                       const ADSRBezierPoint &P2,
-                                       const ADSRBezierPoint &B,
-                                       float t)
-{
-    float one_minus_t = 1.0f - t;
-    float one_minus_t_squared = one_minus_t * one_minus_t;
-    float t_squared = t * t;
-
-    float x = one_minus_t_squared * one_minus_t * A.x +
-              3.0f * one_minus_t_squared * t * P1.x +
-              3.0f * one_minus_t * t_squared * P2.x +
-              t_squared * t * B.x;
-
-    float y = one_minus_t_squared * one_minus_t * A.y +
-              3.0f * one_minus_t_squared * t * P1.y +
-              3.0f * one_minus_t * t_squared * P2.y +
-              t_squared * t * B.y;
-
-    return {x, y};
-}
+// ---------------------------------------------------------------------------
+// Runtime table generation
+// ---------------------------------------------------------------------------
 
-// Find y for a given x on the cubic Bézier using binary search on t
-inline float adsrBezierFindYForX(const ADSRBezierPoint &A,
-                                 const ADSRBezierPoint &P1,
-                                 const ADSRBezierPoint &P2,
-                                 const ADSRBezierPoint &B,
-                                 float xTarget,
-                                 float tol = 1e-5f)
+// Generate 8 Bézier curves into the provided curve_tables (size [8][numPoints])
+// maxVal: maximum y value (e.g. vertical_resolution)
+// numPoints: number of points per curve (ARRAY_SIZE)
+// T: table element type (adsr_curve_t for _curve_tables)
+// Returns true (see the compile-time table version below)
+template <typename T>
+inline bool adsrBezierInitTables(float maxVal, int numPoints, T *curve_tables[8])
 {
-    float tLow = 0.0f;
-    float tHigh = 1.0f;
-    float tMid = 0.0f;
-
-    while ((tHigh - tLow) > tol)
+    for (int j = 0; j < 8; ++j)
     {
-        tMid = (tLow + tHigh) * 0.5f;
-        ADSRBezierPoint midPoint = adsrBezierCubic(A, P1, P2, B, tMid);
-        if (midPoint.x < xTarget)
-        {
-            tLow = tMid;
-        }
-        else
+        for (int i = 0; i < numPoints; ++i)
         {
-            tHigh = tMid;
+            float yResult = adsrBezierCurveY(j, maxVal, numPoints, i);
+
+            curve_tables[j][i] = adsrBezierToTable<T>((int)roundf(yResult));
         }
     }
-
-    ADSRBezierPoint resultPoint = adsrBezierCubic(A, P1, P2, B, tMid);
-    return resultPoint.y;
+    return true;
 }
 
-// Generate 8 Bézier curves into the provided curve_tables (size [8][numPoints])
-// maxVal: maximum y value (e.g. vertical_resolution)
-// numPoints: number of points per curve (ARRAY_SIZE)
-inline void adsrBezierInitTables(float maxVal, int numPoints, int *curve_tables[8])
+// Fill one table with the curve through (0, maxVal), P1, P2, (maxVal, 0) by
+// sweeping it monotonically. P1 and P2 are mapped by adsrBezierControlPoint()
+// (scaled from 0..4095 with ADSR_BEZIER_SCALE_CONTROL_POINTS); their x should
+// lie in 0..maxVal so x(t) stays monotonic.
+// xTarget only grows with i, so the t found for one entry is the start point
+// for the next: a few safeguarded Newton steps on x(t) (power-basis cubic,
+// bracketed by [t_prev, 1] with bisection as fallback) replace the full
+// bisection of adsrBezierFindYForX(). Roughly linear in numPoints.
+template <typename T>
+inline void adsrBezierInitCurvePointsFast(ADSRBezierPoint p1, ADSRBezierPoint p2, float maxVal, int numPoints, T *table)
 {
     ADSRBezierPoint A = {0.0f, maxVal};
+    ADSRBezierPoint P1 = adsrBezierControlPoint(p1, maxVal);
+    ADSRBezierPoint P2 = adsrBezierControlPoint(p2, maxVal);
     ADSRBezierPoint B = {maxVal, 0.0f};
 
-    ADSRBezierPoint P1[8] = {
-        {250.0f, 1500.0f}, {840.0f, 1780.0f}, {400.0f, 430.0f},  {2170.0f, 3610.0f},
-        {400.0f, 1380.0f}, {1140.0f, 3750.0f}, {200.0f, 2700.0f}, {0.0f, 4095.0f}};
+    // x(t) = ((ax * t + bx) * t + cx) * t + A.x, same for y
+    float cx = 3.0f * (P1.x - A.x);
+    float bx = 3.0f * (P2.x - 2.0f * P1.x + A.x);
+    float ax = B.x - A.x + 3.0f * (P1.x - P2.x);
+    float cy = 3.0f * (P1.y - A.y);
+    float by = 3.0f * (P2.y - 2.0f * P1.y + A.y);
+    float ay = B.y - A.y + 3.0f * (P1.y - P2.y);
 
-    ADSRBezierPoint P2[8] = {
-        {1500.0f, 250.0f}, {1160.0f, 210.0f}, {920.0f, 420.0f},  {3730.0f, 2610.0f},
-        {3830.0f, 2890.0f}, {1850.0f, 1080.0f}, {720.0f, 3050.0f}, {4095.0f, 0.0f}};
+    float multiplier = (float)(maxVal + 1.0f) / (float)(numPoints - 1);
+    float t = 0.0f;
 
-    for (int j = 0; j < 8; ++j)
+    for (int i = 0; i < numPoints; ++i)
     {
-        float multiplier = (float)(maxVal + 1.0f) / (float)(numPoints - 1);
+        float xTarget = multiplier * (float)i;
+        float tLow = t;
+        float tHigh = 1.0f;
 
-        for (int i = 0; i < numPoints; ++i)
+        for (int iter = 0; iter < 24; ++iter)
         {
-            float xTarget = multiplier * (float)i;
-            float yResult = adsrBezierFindYForX(A, P1[j], P2[j], B, xTarget);
+            float f = ((ax * t + bx) * t + cx) * t + A.x - xTarget;
+            if (f < 0.0f)
+                tLow = t;
+            else
+                tHigh = t;
+            if ((tHigh - tLow) <= 1e-5f || (f < 0.01f && f > -0.01f))
+                break;
 
-            curve_tables[j][i] = (int)roundf(yResult);
+            // Newton step, or bisection if it leaves the bracket (flat spots at the ends)
+            float d = (3.0f * ax * t + 2.0f * bx) * t + cx;
+            float tNext = (d > 0.0f) ? t - f / d : -1.0f;
+            if (!(tNext > tLow && tNext < tHigh))
+                tNext = (tLow + tHigh) * 0.5f;
+            t = tNext;
         }
+
+        float yResult = ((ay * t + by) * t + cy) * t + A.y;
+        table[i] = adsrBezierToTable<T>((int)roundf(yResult));
     }
 }
 
+// Fill one table with built-in curve 0..7, see adsrBezierInitCurvePointsFast()
+template <typename T>
+inline void adsrBezierInitCurveFast(int curve, float maxVal, int numPoints, T *table)
+{
+    adsrBezierInitCurvePointsFast(adsrBezierControlP1(curve), adsrBezierControlP2(curve), maxVal, numPoints, table);
+}
+
+// Same result layout as adsrBezierInitTables(), using adsrBezierInitCurveFast()
+template <typename T>
+inline bool adsrBezierInitTablesFast(float maxVal, int numPoints, T *curve_tables[8])
+{
+    for (int j = 0; j < 8; ++j)
+        adsrBezierInitCurveFast(j, maxVal, numPoints, curve_tables[j]);
+    return true;
+}
+
+#if ADSR_BEZIER_CONSTEXPR_TABLES
+// Tables were generated at compile time (with ADSR_BEZIER_TABLE_MAX_VALUE and
+// ARRAY_SIZE): kept so existing setup code still compiles, nothing to do at
+// startup. Returns false when maxVal or numPoints ask for other tables than
+// the compiled-in ones; constexpr, so static_assert() can check the call.
+constexpr bool adsrBezierInitTables(float maxVal, int numPoints, const adsr_curve_t *const *)
+{
+    return maxVal == (float)ADSR_BEZIER_TABLE_MAX_VALUE && numPoints == ARRAY_SIZE;
+}
+
+constexpr bool adsrBezierInitTablesFast(float maxVal, int numPoints, const adsr_curve_t *const *curve_tables)
+{
+    return adsrBezierInitTables(maxVal, numPoints, curve_tables);
+}
 #endif
+
+#endif
\ No newline at end of file
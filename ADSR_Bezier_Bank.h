@@ -0,0 +1,828 @@
+//----------------------------------//
+// Polyphonic ADSR voice bank
+// Struct-of-arrays companion to the adsr class in ADSR_Bezier.h
+//----------------------------------//
+
+#ifndef ADSR_BANK
+#define ADSR_BANK
+
+#include "ADSR_Bezier.h"
+
+#if ADSR_BEZIER_EXP_ONLY
+#error "AdsrBank reads the curve tables, which ADSR_BEZIER_EXP_ONLY leaves out"
+#endif
+
+// SIMD kernels (AVX2 or SSE4.1) are only used on x86-64 hosts; everything else runs the scalar path.
+// The SIMD kernels implement the truncated lookup (ADSR_BEZIER_INTERPOLATE 0).
+// Define ADSR_BEZIER_BANK_SIMD 0 to force the scalar path.
+#ifndef ADSR_BEZIER_BANK_SIMD
+#if defined(__x86_64__) && (defined(__AVX2__) || defined(__SSE4_1__)) && !ADSR_BEZIER_INTERPOLATE
+#define ADSR_BEZIER_BANK_SIMD 1
+#else
+#define ADSR_BEZIER_BANK_SIMD 0
+#endif
+#endif
+
+#if ADSR_BEZIER_BANK_SIMD
+#include <immintrin.h>
+#endif
+
+// N envelopes with the same behavior as N separate adsr objects, stored as
+// struct-of-arrays. getWave(now) steps every voice at the same timestamp.
+//
+// While a voice is in attack, decay or release its stage is cached as a
+// "segment" (duration, Q24 scale, table origin/direction, Q16 base/range), so
+// the per-sample kernel is the same for all three stages and can run several
+// voices at once. Per-phase voice masks drive the kernel: sustaining and idle
+// voices are never visited, their output is written once on the transition.
+//
+// Samples that end a stage, stages on the Q40 scale (longer than
+// ADSR_BEZIER_Q24_MAX_TICKS), curve morphs and zero-length stages go through
+// a scalar copy of the adsr state machine, so the output stays bit-identical
+// to adsr::getWave().
+template <size_t N>
+class AdsrBank
+{
+public:
+    AdsrBank(int l_vertical_resolution, int bezier_attack_type, int bezier_decay_type, int bezier_release_type)
+    {
+        _vertical_resolution = l_vertical_resolution;
+        _vres_recip = adsrRangeReciprocal(l_vertical_resolution);
+        _t_last = 0;
+
+        for (size_t v = 0; v < N; ++v)
+        {
+            // same initial values as the adsr constructor
+            _attack[v] = 100000;
+            _decay[v] = 100000;
+            _sustain[v] = l_vertical_resolution / 2;
+            _release[v] = 100000;
+            _attack_scale[v] = adsrStageScale(_attack[v]);
+            _decay_scale[v] = adsrStageScale(_decay[v]);
+            _release_scale[v] = adsrStageScale(_release[v]);
+            _decay_range_scale_q16[v] = 0;
+            _attack_range_scale_q16[v] = 0;
+            _release_range_scale_q16[v] = 0;
+            _attack_table[v] = _curve_tables[bezier_attack_type];
+            _decay_table[v] = _curve_tables[bezier_decay_type];
+            _release_table[v] = _curve_tables[bezier_release_type];
+            _attack_table_b[v] = _attack_table[v];
+            _decay_table_b[v] = _decay_table[v];
+            _release_table_b[v] = _release_table[v];
+            _attack_morph[v] = 0;
+            _decay_morph[v] = 0;
+            _release_morph[v] = 0;
+            _reset_attack[v] = false;
+            _phase[v] = PHASE_IDLE;
+            _adsr_output[v] = 0;
+            _attack_start[v] = 0;
+            _release_start[v] = 0;
+            _notes_pressed[v] = 0;
+        }
+
+        for (size_t w = 0; w < MASK_WORDS; ++w)
+        {
+            for (size_t p = 0; p < PHASE_COUNT; ++p)
+                _phase_mask[p][w] = 0;
+            _settle_mask[w] = 0;
+            _active_mask[w] = 0;
+        }
+        for (size_t v = 0; v < N; ++v)
+            _phase_mask[PHASE_IDLE][v >> 5] |= (uint32_t)1 << (v & 31);
+    }
+
+    static constexpr size_t size() { return N; }
+
+    void adsrCurveAttack(size_t voice, uint8_t curveType)
+    {
+        adsrCurveAttackTable(voice, _curve_tables[curveType]);
+    }
+
+    void adsrCurveDecay(size_t voice, uint8_t curveType)
+    {
+        adsrCurveDecayTable(voice, _curve_tables[curveType]);
+    }
+
+    void adsrCurveRelease(size_t voice, uint8_t curveType)
+    {
+        adsrCurveReleaseTable(voice, _curve_tables[curveType]);
+    }
+
+    // Custom curve tables, see adsr::adsrCurveAttackTable()
+    void adsrCurveAttackTable(size_t voice, const adsr_curve_t *table)
+    {
+        _attack_table[voice] = table;
+        _attack_table_b[voice] = table;
+        _attack_morph[voice] = 0;
+        _refreshSegment(voice);
+    }
+
+    void adsrCurveDecayTable(size_t voice, const adsr_curve_t *table)
+    {
+        _decay_table[voice] = table;
+        _decay_table_b[voice] = table;
+        _decay_morph[voice] = 0;
+        _refreshSegment(voice);
+    }
+
+    void adsrCurveReleaseTable(size_t voice, const adsr_curve_t *table)
+    {
+        _release_table[voice] = table;
+        _release_table_b[voice] = table;
+        _release_morph[voice] = 0;
+        _refreshSegment(voice);
+    }
+
+    // Curve morphs, see adsr::adsrCurveAttackMorph()
+    void adsrCurveAttackMorph(size_t voice, uint8_t from, uint8_t to, uint16_t amount)
+    {
+        adsrCurveAttackMorphTables(voice, _curve_tables[from], _curve_tables[to], amount);
+    }
+
+    void adsrCurveDecayMorph(size_t voice, uint8_t from, uint8_t to, uint16_t amount)
+    {
+        adsrCurveDecayMorphTables(voice, _curve_tables[from], _curve_tables[to], amount);
+    }
+
+    void adsrCurveReleaseMorph(size_t voice, uint8_t from, uint8_t to, uint16_t amount)
+    {
+        adsrCurveReleaseMorphTables(voice, _curve_tables[from], _curve_tables[to], amount);
+    }
+
+    void adsrCurveAttackMorphTables(size_t voice, const adsr_curve_t *from, const adsr_curve_t *to, uint16_t amount)
+    {
+        _attack_table[voice] = from;
+        _attack_table_b[voice] = to;
+        setAttackMorph(voice, amount);
+    }
+
+    void adsrCurveDecayMorphTables(size_t voice, const adsr_curve_t *from, const adsr_curve_t *to, uint16_t amount)
+    {
+        _decay_table[voice] = from;
+        _decay_table_b[voice] = to;
+        setDecayMorph(voice, amount);
+    }
+
+    void adsrCurveReleaseMorphTables(size_t voice, const adsr_curve_t *from, const adsr_curve_t *to, uint16_t amount)
+    {
+        _release_table[voice] = from;
+        _release_table_b[voice] = to;
+        setReleaseMorph(voice, amount);
+    }
+
+    void setAttackMorph(size_t voice, uint16_t amount)
+    {
+        _attack_morph[voice] = adsrMorphWeight(amount);
+        _refreshSegment(voice);
+    }
+
+    void setDecayMorph(size_t voice, uint16_t amount)
+    {
+        _decay_morph[voice] = adsrMorphWeight(amount);
+        _refreshSegment(voice);
+    }
+
+    void setReleaseMorph(size_t voice, uint16_t amount)
+    {
+        _release_morph[voice] = adsrMorphWeight(amount);
+        _refreshSegment(voice);
+    }
+
+    void setResetAttack(size_t voice, bool l_reset_attack)
+    {
+        _reset_attack[voice] = l_reset_attack;
+    }
+
+    // Attack time in milliseconds
+    void setAttack(size_t voice, unsigned long l_attack_ms)
+    {
+        setAttack(voice, l_attack_ms, _t_last);
+    }
+
+    // Same, made at tick now rather than at the last getWave(), see adsr::setAttack()
+    void setAttack(size_t voice, unsigned long l_attack_ms, unsigned long now)
+    {
+        unsigned long ticks = _msToTicks(l_attack_ms);
+        _setStageTicks(voice, PHASE_ATTACK, _attack, _attack_scale, ticks, adsrStageScale(ticks), now);
+    }
+
+    // Decay time in milliseconds
+    void setDecay(size_t voice, unsigned long l_decay_ms)
+    {
+        setDecay(voice, l_decay_ms, _t_last);
+    }
+
+    void setDecay(size_t voice, unsigned long l_decay_ms, unsigned long now)
+    {
+        unsigned long ticks = _msToTicks(l_decay_ms);
+        _setStageTicks(voice, PHASE_DECAY, _decay, _decay_scale, ticks, adsrStageScale(ticks), now);
+    }
+
+    void setSustain(size_t voice, int l_sustain)
+    {
+        if (l_sustain < 0)
+            l_sustain = 0;
+        if (l_sustain >= _vertical_resolution)
+            l_sustain = _vertical_resolution;
+        _sustain[voice] = l_sustain;
+        _decay_range_scale_q16[voice] = _rangeScaleQ16((int32_t)_vertical_resolution - (int32_t)l_sustain);
+
+        // a sustaining voice is not visited by the kernel: pick up the new level on the next step
+        if (_phase[voice] == PHASE_SUSTAIN)
+            _settle_mask[voice >> 5] |= (uint32_t)1 << (voice & 31);
+        _refreshSegment(voice);
+    }
+
+    // Release time in milliseconds
+    void setRelease(size_t voice, unsigned long l_release_ms)
+    {
+        setRelease(voice, l_release_ms, _t_last);
+    }
+
+    void setRelease(size_t voice, unsigned long l_release_ms, unsigned long now)
+    {
+        unsigned long ticks = _msToTicks(l_release_ms);
+        _setStageTicks(voice, PHASE_RELEASE, _release, _release_scale, ticks, adsrStageScale(ticks), now);
+    }
+
+    // Stage times from a control value, see adsr::modAttack()
+    template <size_t Steps>
+    void modAttack(size_t voice, const AdsrTimeTable<Steps> &times, uint16_t value)
+    {
+        unsigned long ticks;
+        uint64_t scale;
+        times.lookup(value, ticks, scale);
+        _setStageTicks(voice, PHASE_ATTACK, _attack, _attack_scale, ticks, scale, _t_last);
+    }
+
+    template <size_t Steps>
+    void modDecay(size_t voice, const AdsrTimeTable<Steps> &times, uint16_t value)
+    {
+        unsigned long ticks;
+        uint64_t scale;
+        times.lookup(value, ticks, scale);
+        _setStageTicks(voice, PHASE_DECAY, _decay, _decay_scale, ticks, scale, _t_last);
+    }
+
+    template <size_t Steps>
+    void modRelease(size_t voice, const AdsrTimeTable<Steps> &times, uint16_t value)
+    {
+        unsigned long ticks;
+        uint64_t scale;
+        times.lookup(value, ticks, scale);
+        _setStageTicks(voice, PHASE_RELEASE, _release, _release_scale, ticks, scale, _t_last);
+    }
+
+    void noteOn(size_t voice, unsigned long now)
+    {
+        if (_reset_attack[voice])
+            _attack_start[voice] = 0;
+        else
+            _attack_start[voice] = _adsr_output[voice];
+        _notes_pressed[voice]++;
+
+        _t_phase_start[voice] = now;
+        _attack_range_scale_q16[voice] = _rangeScaleQ16((int32_t)_vertical_resolution - (int32_t)_attack_start[voice]);
+        _setPhase(voice, PHASE_ATTACK);
+    }
+
+    void noteOff(size_t voice, unsigned long now)
+    {
+        _notes_pressed[voice]--;
+        if (_notes_pressed[voice] <= 0)
+        {
+            _release_start[voice] = _adsr_output[voice];
+            _notes_pressed[voice] = 0;
+
+            _t_phase_start[voice] = now;
+            int32_t rs = (int32_t)_release_start[voice];
+            if (rs > _vertical_resolution)
+                rs = _vertical_resolution;
+            _release_range_scale_q16[voice] = _rangeScaleQ16(rs);
+            _setPhase(voice, PHASE_RELEASE);
+        }
+    }
+
+    // Step every voice at timestamp now (ticks). Returns the N outputs.
+    const int *getWave(unsigned long now)
+    {
+        _t_last = now;
+        for (size_t w = 0; w < MASK_WORDS; ++w)
+        {
+            // Sustaining voices whose output is not the sustain level yet
+            // (attack ended without decay, or setSustain() was called)
+            uint32_t settle = _settle_mask[w] & _phase_mask[PHASE_SUSTAIN][w];
+            _settle_mask[w] = 0;
+            while (settle != 0)
+            {
+                size_t v = w * 32 + (size_t)__builtin_ctz(settle);
+                settle &= settle - 1;
+                _adsr_output[v] = _sustain[v];
+            }
+
+            uint32_t timed = _active_mask[w];
+            if (timed == 0)
+                continue;
+
+#if ADSR_BEZIER_BANK_SIMD
+            for (size_t lane0 = 0; lane0 < 32; lane0 += LANES)
+            {
+                uint32_t lanes = (timed >> lane0) & (((uint32_t)1 << LANES) - 1);
+                if (lanes != 0)
+                    _kernelSimd(w * 32 + lane0, lanes, now);
+            }
+#else
+            while (timed != 0)
+            {
+                size_t v = w * 32 + (size_t)__builtin_ctz(timed);
+                timed &= timed - 1;
+                _kernelScalar(v, now);
+            }
+#endif
+        }
+        return _adsr_output;
+    }
+
+    // Last computed output of one voice
+    int getOutput(size_t voice) const
+    {
+        return _adsr_output[voice];
+    }
+
+    const int *getOutputs() const
+    {
+        return _adsr_output;
+    }
+
+    // Phase of one voice, same values as adsr::getPhase()
+    adsr::ADSRPhase getPhase(size_t voice) const
+    {
+        return (adsr::ADSRPhase)_phase[voice];
+    }
+
+    // See adsr::isActive(): true while the voice is in attack, decay or release
+    bool isActive(size_t voice) const
+    {
+        return (_active_mask[voice >> 5] >> (voice & 31)) & 1;
+    }
+
+    // Active voices as a bitmask of maskWords() words (voice v = bit v % 32 of
+    // word v / 32). Kept up to date by noteOn()/noteOff() and getWave().
+    const uint32_t *activeMask() const
+    {
+        return _active_mask;
+    }
+
+    static constexpr size_t maskWords() { return MASK_WORDS; }
+
+    // See adsr::nextChange()
+    bool nextChange(size_t voice, unsigned long &tick) const
+    {
+        unsigned long duration;
+        switch (_phase[voice])
+        {
+        case PHASE_ATTACK:
+            duration = _attack[voice];
+            break;
+        case PHASE_DECAY:
+            duration = _decay[voice];
+            break;
+        case PHASE_RELEASE:
+            duration = _release[voice];
+            break;
+        default:
+            return false;
+        }
+        tick = _t_phase_start[voice] + duration;
+        return true;
+    }
+
+    // Earliest stage end over all active voices, as seen from now (ends
+    // already due count as now). Returns false when no voice is active: the
+    // outputs then stay constant until the next noteOn()/noteOff().
+    bool earliestChange(unsigned long now, unsigned long &tick) const
+    {
+        bool found = false;
+        unsigned long soonest = 0;
+        for (size_t w = 0; w < MASK_WORDS; ++w)
+        {
+            uint32_t active = _active_mask[w];
+            while (active != 0)
+            {
+                size_t v = w * 32 + (size_t)__builtin_ctz(active);
+                active &= active - 1;
+
+                unsigned long end = now;
+                nextChange(v, end);
+                unsigned long wait = ((long)(end - now) > 0) ? end - now : 0;
+                if (!found || wait < soonest)
+                    soonest = wait;
+                found = true;
+            }
+        }
+        if (found)
+            tick = now + soonest;
+        return found;
+    }
+
+private:
+    enum BankPhase
+    {
+        PHASE_IDLE = 0,
+        PHASE_ATTACK,
+        PHASE_DECAY,
+        PHASE_SUSTAIN,
+        PHASE_RELEASE,
+        PHASE_COUNT
+    };
+
+    static constexpr size_t MASK_WORDS = (N + 31) / 32;
+
+#if defined(__AVX2__)
+    static constexpr size_t LANES = 8;
+#else
+    static constexpr size_t LANES = 4;
+#endif
+
+    static unsigned long _msToTicks(unsigned long ms)
+    {
+#if ADSR_BEZIER_USE_MICROS
+        return ms * 1000UL;
+#else
+        return ms;
+#endif
+    }
+
+    int32_t _rangeScaleQ16(int32_t range) const
+    {
+        return adsrRangeScaleQ16(range, _vertical_resolution, _vres_recip);
+    }
+
+    // New time for one stage of a voice, made at tick now; a running stage
+    // keeps the position it has at now, like adsr
+    void _setStageTicks(size_t voice, BankPhase stage, unsigned long *durations, uint64_t *scales,
+                        unsigned long ticks, uint64_t scale, unsigned long now)
+    {
+        unsigned long duration = durations[voice];
+        if (_phase[voice] == stage && duration != 0)
+        {
+            unsigned long delta = now - _t_phase_start[voice];
+            if (delta < duration)
+                _t_phase_start[voice] = now - adsrStageRescale(delta, duration, scales[voice], ticks);
+        }
+        durations[voice] = ticks;
+        scales[voice] = scale;
+        _refreshSegment(voice);
+    }
+
+    void _setPhase(size_t voice, BankPhase phase)
+    {
+        uint32_t bit = (uint32_t)1 << (voice & 31);
+        _phase_mask[_phase[voice]][voice >> 5] &= ~bit;
+        _phase_mask[phase][voice >> 5] |= bit;
+        if (phase == PHASE_ATTACK || phase == PHASE_DECAY || phase == PHASE_RELEASE)
+            _active_mask[voice >> 5] |= bit;
+        else
+            _active_mask[voice >> 5] &= ~bit;
+        _phase[voice] = (uint8_t)phase;
+        _refreshSegment(voice);
+    }
+
+    // Cache the running stage of a voice in the uniform segment form used by the kernel.
+    // Reversed stages (attack) read the table backwards.
+    void _refreshSegment(size_t voice)
+    {
+        unsigned long duration;
+        uint64_t scale;
+        const adsr_curve_t *table;
+        const adsr_curve_t *table_b;
+        int32_t morph;
+        int32_t base;
+        int32_t range_q16;
+        bool reversed = false;
+
+        switch (_phase[voice])
+        {
+        case PHASE_ATTACK:
+            duration = _attack[voice];
+            scale = _attack_scale[voice];
+            table = _attack_table[voice];
+            table_b = _attack_table_b[voice];
+            morph = _attack_morph[voice];
+            reversed = true;
+            base = _attack_start[voice];
+            range_q16 = _attack_range_scale_q16[voice];
+            break;
+        case PHASE_DECAY:
+            duration = _decay[voice];
+            scale = _decay_scale[voice];
+            table = _decay_table[voice];
+            table_b = _decay_table_b[voice];
+            morph = _decay_morph[voice];
+            base = _sustain[voice];
+            range_q16 = _decay_range_scale_q16[voice];
+            break;
+        case PHASE_RELEASE:
+            duration = _release[voice];
+            scale = _release_scale[voice];
+            table = _release_table[voice];
+            table_b = _release_table_b[voice];
+            morph = _release_morph[voice];
+            base = 0;
+            range_q16 = _release_range_scale_q16[voice];
+            break;
+        default:
+            return;
+        }
+
+        // Segments on the Q24 scale run in the kernel; Q40 (long) and morphing
+        // stages are stepped by _stepVoice()
+        bool fast = duration > 0 && duration <= ADSR_BEZIER_Q24_MAX_TICKS && scale != 0 && morph == 0;
+        _seg_duration[voice] = fast ? (uint32_t)duration : 0;
+        _seg_scale_lo[voice] = (uint32_t)scale;
+        _seg_scale_hi[voice] = (uint32_t)(scale >> 32);
+        _seg_table[voice] = table;
+        _seg_table_b[voice] = table_b;
+        _seg_morph[voice] = morph;
+        _seg_reverse_mask[voice] = reversed ? -1 : 0;
+        _seg_base[voice] = base;
+        _seg_range_q16[voice] = range_q16;
+    }
+
+    int _clampOutput(int32_t out) const
+    {
+        if (out < 0)
+            out = 0;
+        if (out > _vertical_resolution)
+            out = _vertical_resolution;
+        return (int)out;
+    }
+
+    // Scalar per-voice kernel: segment fast path, state machine otherwise
+    void _kernelScalar(size_t v, unsigned long now)
+    {
+        unsigned long delta = now - _t_phase_start[v];
+        if (delta >= _seg_duration[v])
+        {
+            _stepVoice(v, now);
+            return;
+        }
+
+        uint64_t scale = ((uint64_t)_seg_scale_hi[v] << 32) | _seg_scale_lo[v];
+        _adsr_output[v] = _segmentValue(v, adsrStagePosition(delta, _seg_duration[v], scale));
+    }
+
+#if ADSR_BEZIER_BANK_SIMD
+    // LANES voices starting at first; lanes is the bitmask of voices in a timed phase.
+    // Lanes that end their stage (or use the Q40 scale) are finished by the
+    // scalar state machine after the vector pass.
+    void _kernelSimd(size_t first, uint32_t lanes, unsigned long now)
+    {
+#if defined(__AVX2__)
+        // Elapsed ticks per lane. With 64-bit ticks a lane only runs when the
+        // high half of the difference is zero, matching the scalar comparison.
+        __m256i lane_bit = _mm256_setr_epi32(1, 2, 4, 8, 16, 32, 64, 128);
+        __m256i active = _mm256_cmpeq_epi32(_mm256_and_si256(_mm256_set1_epi32((int)lanes), lane_bit), lane_bit);
+#if defined(__LP64__)
+        __m256i now64 = _mm256_set1_epi64x((long long)now);
+        __m256i pick = _mm256_setr_epi32(0, 2, 4, 6, 1, 3, 5, 7);
+        __m256i d_a = _mm256_permutevar8x32_epi32(_mm256_sub_epi64(now64, _mm256_loadu_si256((const __m256i *)(_t_phase_start + first))), pick);
+        __m256i d_b = _mm256_permutevar8x32_epi32(_mm256_sub_epi64(now64, _mm256_loadu_si256((const __m256i *)(_t_phase_start + first + 4))), pick);
+        __m256i d = _mm256_permute2x128_si256(d_a, d_b, 0x20);
+        __m256i d_high = _mm256_permute2x128_si256(d_a, d_b, 0x31);
+        active = _mm256_and_si256(active, _mm256_cmpeq_epi32(d_high, _mm256_setzero_si256()));
+#else
+        __m256i d = _mm256_sub_epi32(_mm256_set1_epi32((int)now), _mm256_loadu_si256((const __m256i *)(_t_phase_start + first)));
+#endif
+        // unsigned delta < duration
+        __m256i sign = _mm256_set1_epi32((int)0x80000000u);
+        __m256i duration = _mm256_loadu_si256((const __m256i *)(_seg_duration + first));
+        __m256i run = _mm256_and_si256(active, _mm256_cmpgt_epi32(_mm256_xor_si256(duration, sign), _mm256_xor_si256(d, sign)));
+        uint32_t run_bits = (uint32_t)_mm256_movemask_ps(_mm256_castsi256_ps(run));
+
+        if (run_bits != 0)
+        {
+            __m256i lo = _mm256_loadu_si256((const __m256i *)(_seg_scale_lo + first));
+            __m256i hi = _mm256_loadu_si256((const __m256i *)(_seg_scale_hi + first));
+
+            // idx = (delta * scale) >> 24 with a 64-bit scale split into two 32-bit halves.
+            // Both partial results fit in 32 bits because idx < ARRAY_SIZE while the stage runs.
+            __m256i p_even = _mm256_srli_epi64(_mm256_mul_epu32(d, lo), 24);
+            __m256i p_odd = _mm256_srli_epi64(_mm256_mul_epu32(_mm256_srli_epi64(d, 32), _mm256_srli_epi64(lo, 32)), 24);
+            __m256i idx = _mm256_blend_epi32(p_even, _mm256_slli_epi64(p_odd, 32), 0xAA);
+            idx = _mm256_add_epi32(idx, _mm256_slli_epi32(_mm256_mullo_epi32(d, hi), 8));
+            idx = _mm256_min_epu32(idx, _mm256_set1_epi32(ARRAY_SIZE - 1));
+
+            // Attack lanes walk the table backwards: offset = ((idx ^ m) - m) + (m & (ARRAY_SIZE - 1))
+            __m256i m = _mm256_loadu_si256((const __m256i *)(_seg_reverse_mask + first));
+            __m256i off = _mm256_add_epi32(_mm256_sub_epi32(_mm256_xor_si256(idx, m), m),
+                                           _mm256_and_si256(m, _mm256_set1_epi32(ARRAY_SIZE - 1)));
+
+            // Gather from per-lane tables (64-bit addresses, 4 lanes per gather);
+            // lanes that do not run are masked out since their table may be stale.
+            // Narrow elements are read as the aligned 32-bit word that contains
+            // them (never crosses a page) and shifted/masked into place.
+            __m256i tab_lo = _mm256_loadu_si256((const __m256i *)(_seg_table + first));
+            __m256i tab_hi = _mm256_loadu_si256((const __m256i *)(_seg_table + first + 4));
+            __m256i addr_lo = _mm256_add_epi64(tab_lo, _mm256_mul_epi32(_mm256_cvtepi32_epi64(_mm256_castsi256_si128(off)), _mm256_set1_epi64x(sizeof(adsr_curve_t))));
+            __m256i addr_hi = _mm256_add_epi64(tab_hi, _mm256_mul_epi32(_mm256_cvtepi32_epi64(_mm256_extracti128_si256(off, 1)), _mm256_set1_epi64x(sizeof(adsr_curve_t))));
+            __m256i word_mask = _mm256_set1_epi64x(~(long long)3);
+            __m128i c_lo = _mm256_mask_i64gather_epi32(_mm_setzero_si128(), (const int *)0, _mm256_and_si256(addr_lo, word_mask), _mm256_castsi256_si128(run), 1);
+            __m128i c_hi = _mm256_mask_i64gather_epi32(_mm_setzero_si128(), (const int *)0, _mm256_and_si256(addr_hi, word_mask), _mm256_extracti128_si256(run, 1), 1);
+            __m256i curve = _mm256_inserti128_si256(_mm256_castsi128_si256(c_lo), c_hi, 1);
+            if (sizeof(adsr_curve_t) < 4)
+            {
+                // byte offset within the word of each lane, from the low address bits
+                __m256i pick = _mm256_setr_epi32(0, 2, 4, 6, 0, 2, 4, 6);
+                __m256i byte_lo = _mm256_permutevar8x32_epi32(addr_lo, pick);
+                __m256i byte_hi = _mm256_permutevar8x32_epi32(addr_hi, pick);
+                __m256i shift = _mm256_slli_epi32(_mm256_and_si256(_mm256_permute2x128_si256(byte_lo, byte_hi, 0x20), _mm256_set1_epi32(3)), 3);
+                curve = _mm256_and_si256(_mm256_srlv_epi32(curve, shift), _mm256_set1_epi32((int)(0xFFFFFFFFUL >> (32 - 8 * sizeof(adsr_curve_t)))));
+            }
+
+            // Q16 range mapping (unsigned product, as adsrRangeMapQ16()) and clamp
+            // to [0, vertical_resolution]
+            __m256i base = _mm256_loadu_si256((const __m256i *)(_seg_base + first));
+            __m256i range = _mm256_loadu_si256((const __m256i *)(_seg_range_q16 + first));
+            __m256i out = _mm256_add_epi32(base, _mm256_srli_epi32(_mm256_mullo_epi32(curve, range), 16));
+            out = _mm256_max_epi32(out, _mm256_setzero_si256());
+            out = _mm256_min_epi32(out, _mm256_set1_epi32(_vertical_resolution));
+
+            __m256i old = _mm256_loadu_si256((const __m256i *)(_adsr_output + first));
+            _mm256_storeu_si256((__m256i *)(_adsr_output + first), _mm256_blendv_epi8(old, out, run));
+        }
+#else
+        __m128i lane_bit = _mm_setr_epi32(1, 2, 4, 8);
+        __m128i active = _mm_cmpeq_epi32(_mm_and_si128(_mm_set1_epi32((int)lanes), lane_bit), lane_bit);
+#if defined(__LP64__)
+        __m128i now64 = _mm_set1_epi64x((long long)now);
+        __m128i d_a = _mm_sub_epi64(now64, _mm_loadu_si128((const __m128i *)(_t_phase_start + first)));
+        __m128i d_b = _mm_sub_epi64(now64, _mm_loadu_si128((const __m128i *)(_t_phase_start + first + 2)));
+        __m128i d = _mm_castps_si128(_mm_shuffle_ps(_mm_castsi128_ps(d_a), _mm_castsi128_ps(d_b), _MM_SHUFFLE(2, 0, 2, 0)));
+        __m128i d_high = _mm_castps_si128(_mm_shuffle_ps(_mm_castsi128_ps(d_a), _mm_castsi128_ps(d_b), _MM_SHUFFLE(3, 1, 3, 1)));
+        active = _mm_and_si128(active, _mm_cmpeq_epi32(d_high, _mm_setzero_si128()));
+#else
+        __m128i d = _mm_sub_epi32(_mm_set1_epi32((int)now), _mm_loadu_si128((const __m128i *)(_t_phase_start + first)));
+#endif
+        __m128i sign = _mm_set1_epi32((int)0x80000000u);
+        __m128i duration = _mm_loadu_si128((const __m128i *)(_seg_duration + first));
+        __m128i run = _mm_and_si128(active, _mm_cmpgt_epi32(_mm_xor_si128(duration, sign), _mm_xor_si128(d, sign)));
+        uint32_t run_bits = (uint32_t)_mm_movemask_ps(_mm_castsi128_ps(run));
+
+        if (run_bits != 0)
+        {
+            __m128i lo = _mm_loadu_si128((const __m128i *)(_seg_scale_lo + first));
+            __m128i hi = _mm_loadu_si128((const __m128i *)(_seg_scale_hi + first));
+
+            __m128i p_even = _mm_srli_epi64(_mm_mul_epu32(d, lo), 24);
+            __m128i p_odd = _mm_srli_epi64(_mm_mul_epu32(_mm_srli_epi64(d, 32), _mm_srli_epi64(lo, 32)), 24);
+            __m128i idx = _mm_blend_epi16(p_even, _mm_slli_epi64(p_odd, 32), 0xCC);
+            idx = _mm_add_epi32(idx, _mm_slli_epi32(_mm_mullo_epi32(d, hi), 8));
+            idx = _mm_min_epu32(idx, _mm_set1_epi32(ARRAY_SIZE - 1));
+
+            __m128i m = _mm_loadu_si128((const __m128i *)(_seg_reverse_mask + first));
+            alignas(16) int32_t off[4];
+            _mm_store_si128((__m128i *)off, _mm_add_epi32(_mm_sub_epi32(_mm_xor_si128(idx, m), m),
+                                                          _mm_and_si128(m, _mm_set1_epi32(ARRAY_SIZE - 1))));
+
+            // SSE has no gather: load the curve values of the running lanes directly
+            alignas(16) int32_t curve_v[4] = {0, 0, 0, 0};
+            for (size_t k = 0; k < 4; ++k)
+                if ((run_bits >> k) & 1)
+                    curve_v[k] = _seg_table[first + k][off[k]];
+            __m128i curve = _mm_load_si128((const __m128i *)curve_v);
+
+            __m128i base = _mm_loadu_si128((const __m128i *)(_seg_base + first));
+            __m128i range = _mm_loadu_si128((const __m128i *)(_seg_range_q16 + first));
+            __m128i out = _mm_add_epi32(base, _mm_srli_epi32(_mm_mullo_epi32(curve, range), 16));
+            out = _mm_max_epi32(out, _mm_setzero_si128());
+            out = _mm_min_epi32(out, _mm_set1_epi32(_vertical_resolution));
+
+            __m128i old = _mm_loadu_si128((const __m128i *)(_adsr_output + first));
+            _mm_storeu_si128((__m128i *)(_adsr_output + first), _mm_blendv_epi8(old, out, run));
+        }
+#endif
+
+        uint32_t slow = lanes & ~run_bits;
+        while (slow != 0)
+        {
+            size_t k = (size_t)__builtin_ctz(slow);
+            slow &= slow - 1;
+            _stepVoice(first + k, now);
+        }
+    }
+#endif
+
+    // Scalar copy of the adsr::getWave() state machine for one voice
+    void _stepVoice(size_t v, unsigned long now)
+    {
+        unsigned long delta = now - _t_phase_start[v];
+
+        switch (_phase[v])
+        {
+        case PHASE_ATTACK:
+            if (_attack[v] == 0 || delta >= _attack[v])
+            {
+                _adsr_output[v] = _vertical_resolution;
+                if (_decay[v] > 0)
+                {
+                    _t_phase_start[v] = now;
+                    _setPhase(v, PHASE_DECAY);
+                }
+                else
+                {
+                    _setPhase(v, PHASE_SUSTAIN);
+                    _settle_mask[v >> 5] |= (uint32_t)1 << (v & 31);
+                }
+                return;
+            }
+            _adsr_output[v] = _segmentValue(v, adsrStagePosition(delta, _attack[v], _attack_scale[v]));
+            return;
+
+        case PHASE_DECAY:
+            if (_decay[v] == 0 || delta >= _decay[v])
+            {
+                _adsr_output[v] = _sustain[v];
+                _setPhase(v, PHASE_SUSTAIN);
+                return;
+            }
+            _adsr_output[v] = _segmentValue(v, adsrStagePosition(delta, _decay[v], _decay_scale[v]));
+            return;
+
+        case PHASE_RELEASE:
+            if (_release[v] == 0 || delta >= _release[v])
+            {
+                _adsr_output[v] = 0;
+                _setPhase(v, PHASE_IDLE);
+                return;
+            }
+            _adsr_output[v] = _segmentValue(v, adsrStagePosition(delta, _release[v], _release_scale[v]));
+            return;
+
+        default:
+            return;
+        }
+    }
+
+    // Value of the cached segment at a table position, same mapping as adsr::getWave()
+    int _segmentValue(size_t v, uint32_t pos) const
+    {
+        uint32_t m = (uint32_t)_seg_reverse_mask[v];
+        int curveVal = adsrCurveLookupMorph(_seg_table[v], _seg_table_b[v], ((pos ^ m) - m) + (m & adsrStagePositionMax()), _seg_morph[v]);
+        return _clampOutput(_seg_base[v] + adsrRangeMapQ16(curveVal, _seg_range_q16[v]));
+    }
+
+    int _vertical_resolution;
+    uint32_t _vres_recip;           // adsrRangeReciprocal(_vertical_resolution)
+    unsigned long _t_last;          // last getWave() timestamp
+
+    // Parameters (per voice)
+    unsigned long _attack[N];
+    unsigned long _decay[N];
+    int _sustain[N];
+    unsigned long _release[N];
+    uint64_t _attack_scale[N];
+    uint64_t _decay_scale[N];
+    uint64_t _release_scale[N];
+    int32_t _decay_range_scale_q16[N];
+    const adsr_curve_t *_attack_table[N];
+    const adsr_curve_t *_decay_table[N];
+    const adsr_curve_t *_release_table[N];
+    const adsr_curve_t *_attack_table_b[N];
+    const adsr_curve_t *_decay_table_b[N];
+    const adsr_curve_t *_release_table_b[N];
+    int32_t _attack_morph[N];
+    int32_t _decay_morph[N];
+    int32_t _release_morph[N];
+    bool _reset_attack[N];
+
+    // Runtime state (per voice)
+    uint8_t _phase[N];
+    int32_t _attack_range_scale_q16[N];
+    int32_t _release_range_scale_q16[N];
+    int _attack_start[N];
+    int _release_start[N];
+    int _notes_pressed[N];
+
+    // Running stage in uniform form (kernel input). Padded to a whole number
+    // of SIMD lanes so the last group can be loaded without bounds checks.
+    static constexpr size_t PADDED = (N + 7) & ~(size_t)7;
+    unsigned long _t_phase_start[PADDED] = {};
+    uint32_t _seg_duration[PADDED] = {};
+    uint32_t _seg_scale_lo[PADDED] = {};
+    uint32_t _seg_scale_hi[PADDED] = {};
+    int32_t _seg_reverse_mask[PADDED] = {};
+    int32_t _seg_base[PADDED] = {};
+    int32_t _seg_range_q16[PADDED] = {};
+    const adsr_curve_t *_seg_table[PADDED] = {};
+    const adsr_curve_t *_seg_table_b[PADDED] = {};      // second curve of a morph (scalar path only)
+    int32_t _seg_morph[PADDED] = {};
+    int _adsr_output[PADDED] = {};
+
+    // One bit per voice for each phase
+    uint32_t _phase_mask[PHASE_COUNT][MASK_WORDS];
+    uint32_t _settle_mask[MASK_WORDS];
+    uint32_t _active_mask[MASK_WORDS];                 // attack | decay | release
+};
+
+#endif
@@ -0,0 +1,215 @@
+//----------------------------------//
+// User-defined curve registry
+// Custom Bézier shapes for the adsr class in ADSR_Bezier.h, with tables
+// generated on first use and kept in a bounded LRU cache
+//----------------------------------//
+
+#ifndef ADSR_CURVE_REGISTRY
+#define ADSR_CURVE_REGISTRY
+
+#include "ADSR_Bezier.h"
+
+// Handle of a registered curve, 0 is never a valid handle
+typedef uint16_t adsr_curve_handle_t;
+static constexpr adsr_curve_handle_t ADSR_CURVE_INVALID = 0;
+
+// Up to MaxCurves curves, each defined by its two inner control points (in the
+// same units as the built-in ones, see adsrBezierInitCurvePointsFast()).
+// Registering the same points twice returns the same handle.
+//
+// Registering is cheap: no table is generated until a curve is acquired. The
+// tables live in CacheSlots slots of ARRAY_SIZE entries owned by the registry
+// (budgetBytes() in total, no heap). acquire() pins a curve while a voice
+// uses it; released curves stay cached and are evicted least recently used
+// first when a new curve needs a slot. Pinned tables are never touched.
+//
+// Not thread safe: call from the same context as noteOn()/noteOff().
+template <size_t MaxCurves, size_t CacheSlots>
+class AdsrCurveRegistry
+{
+public:
+    static_assert(MaxCurves > 0 && MaxCurves < 0xFFFF, "MaxCurves must fit a curve handle");
+    static_assert(CacheSlots > 0 && CacheSlots < 0xFFFF, "CacheSlots must fit a slot index");
+
+    // l_max_value is the maxVal passed to the generator, same as for adsrBezierInitTables()
+    AdsrCurveRegistry(float l_max_value)
+    {
+        _max_value = l_max_value;
+        _curve_count = 0;
+        _slots_used = 0;
+        _lru_head = NONE;
+        _lru_tail = NONE;
+        _generated = 0;
+    }
+
+    // Returns the handle of the curve through P1 and P2, or ADSR_CURVE_INVALID when the registry is full.
+    // x is clamped to 0..maxVal (0..4095 with ADSR_BEZIER_SCALE_CONTROL_POINTS)
+    // so the curve stays a function of time.
+    adsr_curve_handle_t registerCurve(ADSRBezierPoint p1, ADSRBezierPoint p2)
+    {
+        p1.x = _clampX(p1.x);
+        p2.x = _clampX(p2.x);
+
+        for (size_t c = 0; c < _curve_count; ++c)
+        {
+            if (_p1[c].x == p1.x && _p1[c].y == p1.y && _p2[c].x == p2.x && _p2[c].y == p2.y)
+                return (adsr_curve_handle_t)(c + 1);
+        }
+
+        if (_curve_count >= MaxCurves)
+            return ADSR_CURVE_INVALID;
+
+        size_t c = _curve_count++;
+        _p1[c] = p1;
+        _p2[c] = p2;
+        _slot[c] = NONE;
+        _pins[c] = 0;
+        return (adsr_curve_handle_t)(c + 1);
+    }
+
+    // Built-in curve 0..7 as a registered curve
+    adsr_curve_handle_t registerBuiltin(int curve)
+    {
+        return registerCurve(adsrBezierControlP1(curve), adsrBezierControlP2(curve));
+    }
+
+    // Table of the curve, generated now if it is not cached. The curve stays
+    // pinned (never evicted) until the matching release(). Returns nullptr for
+    // an invalid handle or when every slot is pinned.
+    const adsr_curve_t *acquire(adsr_curve_handle_t handle)
+    {
+        if (!_valid(handle))
+            return nullptr;
+
+        size_t c = handle - 1;
+        if (_slot[c] == NONE)
+        {
+            uint16_t s = _takeSlot();
+            if (s == NONE)
+                return nullptr;
+
+            adsrBezierInitCurvePointsFast(_p1[c], _p2[c], _max_value, ARRAY_SIZE, _tables[s]);
+            _slot[c] = s;
+            _slot_curve[s] = (uint16_t)c;
+            _generated++;
+        }
+        else if (_pins[c] == 0)
+        {
+            _lruRemove(_slot[c]);
+        }
+
+        _pins[c]++;
+        return _tables[_slot[c]];
+    }
+
+    // Drops one pin; the table stays cached as the most recently used one
+    void release(adsr_curve_handle_t handle)
+    {
+        if (!_valid(handle))
+            return;
+
+        size_t c = handle - 1;
+        if (_pins[c] == 0)
+            return;
+
+        if (--_pins[c] == 0)
+            _lruPushBack(_slot[c]);
+    }
+
+    // Cached table without pinning or generating it (nullptr if not cached)
+    const adsr_curve_t *table(adsr_curve_handle_t handle) const
+    {
+        if (!_valid(handle) || _slot[handle - 1] == NONE)
+            return nullptr;
+        return _tables[_slot[handle - 1]];
+    }
+
+    bool isCached(adsr_curve_handle_t handle) const
+    {
+        return _valid(handle) && _slot[handle - 1] != NONE;
+    }
+
+    size_t registeredCount() const { return _curve_count; }
+    size_t cachedCount() const { return _slots_used; }
+
+    // Number of tables generated so far (first uses plus regenerations after eviction)
+    unsigned long generatedCount() const { return _generated; }
+
+    static constexpr size_t capacity() { return MaxCurves; }
+    static constexpr size_t cacheSlots() { return CacheSlots; }
+    static constexpr size_t budgetBytes() { return CacheSlots * ARRAY_SIZE * sizeof(adsr_curve_t); }
+
+private:
+    static constexpr uint16_t NONE = 0xFFFF;
+
+    bool _valid(adsr_curve_handle_t handle) const
+    {
+        return handle != ADSR_CURVE_INVALID && handle <= _curve_count;
+    }
+
+    float _clampX(float x) const
+    {
+        const float x_max = ADSR_BEZIER_SCALE_CONTROL_POINTS ? 4095.0f : _max_value;
+        return x < 0.0f ? 0.0f : (x > x_max ? x_max : x);
+    }
+
+    // Unused slot if there is one, otherwise the least recently used unpinned slot
+    uint16_t _takeSlot()
+    {
+        if (_slots_used < CacheSlots)
+            return (uint16_t)_slots_used++;
+
+        uint16_t s = _lru_head;
+        if (s == NONE)
+            return NONE;
+
+        _lruRemove(s);
+        _slot[_slot_curve[s]] = NONE;
+        return s;
+    }
+
+    void _lruRemove(uint16_t s)
+    {
+        if (_lru_prev[s] != NONE)
+            _lru_next[_lru_prev[s]] = _lru_next[s];
+        else
+            _lru_head = _lru_next[s];
+
+        if (_lru_next[s] != NONE)
+            _lru_prev[_lru_next[s]] = _lru_prev[s];
+        else
+            _lru_tail = _lru_prev[s];
+    }
+
+    void _lruPushBack(uint16_t s)
+    {
+        _lru_prev[s] = _lru_tail;
+        _lru_next[s] = NONE;
+        if (_lru_tail != NONE)
+            _lru_next[_lru_tail] = s;
+        else
+            _lru_head = s;
+        _lru_tail = s;
+    }
+
+    float _max_value;
+
+    // Registered curves
+    ADSRBezierPoint _p1[MaxCurves];
+    ADSRBezierPoint _p2[MaxCurves];
+    uint16_t _slot[MaxCurves];              // cache slot or NONE
+    uint16_t _pins[MaxCurves];
+    size_t _curve_count;
+
+    // Cache slots; unpinned cached slots form the LRU list (head = next victim)
+    adsr_curve_t _tables[CacheSlots][ARRAY_SIZE];
+    uint16_t _slot_curve[CacheSlots];
+    uint16_t _lru_prev[CacheSlots];
+    uint16_t _lru_next[CacheSlots];
+    uint16_t _lru_head;
+    uint16_t _lru_tail;
+    size_t _slots_used;
+    unsigned long _generated;
+};
+
+#endif
@@ -0,0 +1,205 @@
+//----------------------------------//
+// Curve table hot-swap
+// Replace a curve while voices play it: new tables are generated on another
+// thread / core and published through an atomic index, the render loop
+// switches at a safe point, old tables are reused once no voice holds them
+//----------------------------------//
+
+#ifndef ADSR_CURVE_SWAP
+#define ADSR_CURVE_SWAP
+
+#include "ADSR_Bezier.h"
+#include <atomic>
+
+#if ADSR_BEZIER_EXP_ONLY
+#error "AdsrCurveSwap hands curve tables to voices, which ADSR_BEZIER_EXP_ONLY leaves out"
+#endif
+
+// One swappable curve with Buffers tables of ARRAY_SIZE entries owned by the
+// object (no heap). Rewriting a table in place (adsrBezierInitTables() on
+// _curve_tables) while voices read it gives torn curves; here a table is only
+// written while no voice can see it.
+//
+// Writer side (one context, e.g. a UI thread or the other core):
+//   beginUpdate() returns a free table (nullptr when none is free yet),
+//   fill it, then publish(). publishCurve() / publishBuiltin() do all three.
+// Render side (one context, the one that calls getWave() / renderBlock()):
+//   update() at a safe point (between blocks) adopts the newest published
+//   table; follow(held) moves a voice to it, at noteOn() or at once.
+//
+// Ownership of a table passes through one atomic exchange in each direction,
+// so neither side ever waits or takes a lock. The render side counts the
+// voices holding each table (follow() / release()); a replaced table returns
+// to the writer when the last one lets go. A table that is published again
+// before update() saw it goes straight back to the writer.
+//
+// With the default 3 tables one is always free for the writer when every
+// voice follows at its next update(); keeping old tables until voices end
+// their notes (follow() only at noteOn()) can need more.
+template <size_t Buffers = 3>
+class AdsrCurveSwap
+{
+public:
+    static_assert(Buffers >= 2 && Buffers < 0xFF, "Buffers must be 2..254");
+
+    AdsrCurveSwap()
+    {
+        _mailbox.store(NONE, std::memory_order_relaxed);
+        for (size_t b = 0; b < Buffers; ++b)
+        {
+            _free[b].store(true, std::memory_order_relaxed);
+            _pins[b] = 0;
+        }
+        _writing = NONE;
+        _current = NONE;
+        _swaps = 0;
+    }
+
+    // ---- writer side ----
+
+    // A table nobody reads, to be filled and then publish()ed. Returns nullptr
+    // while every table is published or still held by a voice.
+    adsr_curve_t *beginUpdate()
+    {
+        if (_writing == NONE)
+        {
+            for (size_t b = 0; b < Buffers; ++b)
+            {
+                if (_free[b].load(std::memory_order_acquire))
+                {
+                    _free[b].store(false, std::memory_order_relaxed);
+                    _writing = (uint8_t)b;
+                    break;
+                }
+            }
+            if (_writing == NONE)
+                return nullptr;
+        }
+        return _tables[_writing];
+    }
+
+    // Make the table from beginUpdate() the newest one
+    void publish()
+    {
+        if (_writing == NONE)
+            return;
+
+        uint8_t previous = _mailbox.exchange(_writing, std::memory_order_acq_rel);
+        _writing = NONE;
+        if (previous != NONE)
+            _free[previous].store(true, std::memory_order_release); // never adopted: reuse it
+    }
+
+    // Generate and publish the curve through P1 and P2 (see adsrBezierInitCurvePointsFast()).
+    // Returns false, publishing nothing, when no table is free.
+    bool publishCurve(ADSRBezierPoint p1, ADSRBezierPoint p2, float maxVal)
+    {
+        adsr_curve_t *table = beginUpdate();
+        if (table == nullptr)
+            return false;
+        adsrBezierInitCurvePointsFast(p1, p2, maxVal, ARRAY_SIZE, table);
+        publish();
+        return true;
+    }
+
+    // Same for built-in curve 0..7
+    bool publishBuiltin(int curve, float maxVal)
+    {
+        return publishCurve(adsrBezierControlP1(curve), adsrBezierControlP2(curve), maxVal);
+    }
+
+    // ---- render side ----
+
+    // Adopt the newest published table, if any. Call it where no voice is in
+    // the middle of a getWave() / renderBlock() using this curve. Returns true
+    // when current() changed.
+    bool update()
+    {
+        if (_mailbox.load(std::memory_order_relaxed) == NONE)
+            return false;
+
+        uint8_t next = _mailbox.exchange(NONE, std::memory_order_acq_rel);
+        if (next == NONE)
+            return false;
+
+        uint8_t previous = _current;
+        _current = next;
+        _swaps++;
+        if (previous != NONE && _pins[previous] == 0)
+            _free[previous].store(true, std::memory_order_release);
+        return true;
+    }
+
+    // Newest adopted table, nullptr before the first update() after a publish()
+    const adsr_curve_t *current() const
+    {
+        return _current == NONE ? nullptr : _tables[_current];
+    }
+
+    // Table a voice should use from now on, given the one it holds (or
+    // nullptr): the current one, held until the next follow() / release().
+    //   table[v] = curve.follow(table[v]);
+    //   env[v].adsrCurveDecayTable(table[v]);
+    const adsr_curve_t *follow(const adsr_curve_t *held)
+    {
+        const adsr_curve_t *table = current();
+        if (held == table)
+            return table;
+
+        release(held);
+        if (table != nullptr)
+            _pins[_current]++;
+        return table;
+    }
+
+    // Voice no longer uses the table (from follow()); nullptr is ignored
+    void release(const adsr_curve_t *held)
+    {
+        uint8_t b = _index(held);
+        if (b == NONE || _pins[b] == 0)
+            return;
+
+        if (--_pins[b] == 0 && b != _current)
+            _free[b].store(true, std::memory_order_release);
+    }
+
+    // Voices holding the table (render side)
+    size_t holders(const adsr_curve_t *table) const
+    {
+        uint8_t b = _index(table);
+        return b == NONE ? 0 : _pins[b];
+    }
+
+    // Tables adopted by update() so far (render side)
+    unsigned long swaps() const { return _swaps; }
+
+    static constexpr size_t buffers() { return Buffers; }
+    static constexpr size_t budgetBytes() { return Buffers * ARRAY_SIZE * sizeof(adsr_curve_t); }
+
+private:
+    static constexpr uint8_t NONE = 0xFF;
+
+    uint8_t _index(const adsr_curve_t *table) const
+    {
+        for (size_t b = 0; b < Buffers; ++b)
+            if (table == _tables[b])
+                return (uint8_t)b;
+        return NONE;
+    }
+
+    adsr_curve_t _tables[Buffers][ARRAY_SIZE];
+
+    // Shared: the published, not yet adopted table, and which tables the writer may take
+    std::atomic<uint8_t> _mailbox;
+    std::atomic<bool> _free[Buffers];
+
+    // Writer only
+    uint8_t _writing;
+
+    // Render side only
+    uint8_t _current;
+    uint16_t _pins[Buffers];
+    unsigned long _swaps;
+};
+
+#endif
@@ -0,0 +1,264 @@
+//----------------------------------//
+// Lock-free note event queue
+// Timestamped note on/off and parameter events from a MIDI core/ISR to the
+// core that renders the adsr / AdsrBank envelopes
+//----------------------------------//
+
+#ifndef ADSR_EVENT_QUEUE
+#define ADSR_EVENT_QUEUE
+
+#include "ADSR_Bezier.h"
+#include <atomic>
+
+template <size_t N>
+class AdsrBank;
+
+enum AdsrEventType : uint8_t
+{
+    ADSR_EVENT_NOTE_ON = 0,
+    ADSR_EVENT_NOTE_OFF,
+    ADSR_EVENT_ATTACK,       // value = ms
+    ADSR_EVENT_DECAY,        // value = ms
+    ADSR_EVENT_SUSTAIN,      // value = level
+    ADSR_EVENT_RELEASE,      // value = ms
+    ADSR_EVENT_RESET_ATTACK, // value = 0 / 1
+    ADSR_EVENT_CURVE_ATTACK, // value = built-in curve 0..7
+    ADSR_EVENT_CURVE_DECAY,
+    ADSR_EVENT_CURVE_RELEASE
+};
+
+// tick is in the compiled timebase (µs or ms), the same clock passed to
+// getWave(now) / renderBlock(). voice is ignored when applied to a single adsr.
+struct AdsrEvent
+{
+    unsigned long tick;
+    int32_t value;
+    uint16_t voice;
+    uint8_t type;
+};
+
+// Wait-free single-producer / single-consumer ring of Capacity events
+// (power of two). One context pushes (MIDI handler, ISR, other core), one
+// context pops (the render loop); neither ever blocks or takes a lock.
+// Events must be pushed in tick order.
+//
+// Needs <atomic> (RP2040, ESP32 and host toolchains).
+template <size_t Capacity>
+class AdsrEventQueue
+{
+public:
+    static_assert(Capacity >= 2 && (Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+
+    AdsrEventQueue() : _head(0), _tail(0)
+    {
+    }
+
+    // Producer side. Returns false (event dropped) when the queue is full.
+    bool push(const AdsrEvent &event)
+    {
+        uint32_t head = _head.load(std::memory_order_relaxed);
+        if (head - _tail.load(std::memory_order_acquire) >= Capacity)
+            return false;
+
+        _events[head & MASK] = event;
+        _head.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool noteOn(unsigned long tick, uint16_t voice = 0)
+    {
+        return push(_event(tick, ADSR_EVENT_NOTE_ON, voice, 0));
+    }
+
+    bool noteOff(unsigned long tick, uint16_t voice = 0)
+    {
+        return push(_event(tick, ADSR_EVENT_NOTE_OFF, voice, 0));
+    }
+
+    bool setParameter(unsigned long tick, AdsrEventType type, int32_t value, uint16_t voice = 0)
+    {
+        return push(_event(tick, type, voice, value));
+    }
+
+    // Consumer side: oldest event without removing it
+    bool peek(AdsrEvent &event) const
+    {
+        uint32_t tail = _tail.load(std::memory_order_relaxed);
+        if (_head.load(std::memory_order_acquire) == tail)
+            return false;
+
+        event = _events[tail & MASK];
+        return true;
+    }
+
+    bool pop(AdsrEvent &event)
+    {
+        if (!peek(event))
+            return false;
+
+        _tail.store(_tail.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer side: pops every event due at or before tick (wrap-safe) and
+    // passes it to apply(event), oldest first. Returns the number applied.
+    template <typename Apply>
+    size_t drainUntil(unsigned long tick, Apply apply)
+    {
+        size_t count = 0;
+        AdsrEvent event;
+        while (peek(event) && (long)(event.tick - tick) <= 0)
+        {
+            apply(event);
+            _tail.store(_tail.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+            count++;
+        }
+        return count;
+    }
+
+    // Approximate from the other side, exact from either side when idle
+    size_t size() const
+    {
+        return _head.load(std::memory_order_acquire) - _tail.load(std::memory_order_acquire);
+    }
+
+    static constexpr size_t capacity() { return Capacity; }
+
+private:
+    static constexpr uint32_t MASK = (uint32_t)(Capacity - 1);
+
+    static AdsrEvent _event(unsigned long tick, AdsrEventType type, uint16_t voice, int32_t value)
+    {
+        AdsrEvent event;
+        event.tick = tick;
+        event.value = value;
+        event.voice = voice;
+        event.type = (uint8_t)type;
+        return event;
+    }
+
+    AdsrEvent _events[Capacity];
+
+    // Free-running indices, kept on separate cache lines on multi-core hosts
+    alignas(64) std::atomic<uint32_t> _head; // written by the producer
+    alignas(64) std::atomic<uint32_t> _tail; // written by the consumer
+};
+
+// Apply one event at its own tick, the same as calling the matching adsr method
+inline void adsrApplyEvent(adsr &env, const AdsrEvent &event)
+{
+    switch (event.type)
+    {
+    case ADSR_EVENT_NOTE_ON:
+        env.noteOn(event.tick);
+        break;
+    case ADSR_EVENT_NOTE_OFF:
+        env.noteOff(event.tick);
+        break;
+    case ADSR_EVENT_ATTACK:
+        env.setAttack((unsigned long)event.value, event.tick);
+        break;
+    case ADSR_EVENT_DECAY:
+        env.setDecay((unsigned long)event.value, event.tick);
+        break;
+    case ADSR_EVENT_SUSTAIN:
+        env.setSustain((int)event.value);
+        break;
+    case ADSR_EVENT_RELEASE:
+        env.setRelease((unsigned long)event.value, event.tick);
+        break;
+    case ADSR_EVENT_RESET_ATTACK:
+        env.setResetAttack(event.value != 0);
+        break;
+    case ADSR_EVENT_CURVE_ATTACK:
+        env.adsrCurveAttack((uint8_t)event.value);
+        break;
+    case ADSR_EVENT_CURVE_DECAY:
+        env.adsrCurveDecay((uint8_t)event.value);
+        break;
+    case ADSR_EVENT_CURVE_RELEASE:
+        env.adsrCurveRelease((uint8_t)event.value);
+        break;
+    }
+}
+
+// Same for one voice of an AdsrBank (include ADSR_Bezier_Bank.h to use it)
+template <size_t N>
+inline void adsrApplyEvent(AdsrBank<N> &bank, const AdsrEvent &event)
+{
+    size_t v = event.voice;
+    if (v >= N)
+        return;
+
+    switch (event.type)
+    {
+    case ADSR_EVENT_NOTE_ON:
+        bank.noteOn(v, event.tick);
+        break;
+    case ADSR_EVENT_NOTE_OFF:
+        bank.noteOff(v, event.tick);
+        break;
+    case ADSR_EVENT_ATTACK:
+        bank.setAttack(v, (unsigned long)event.value, event.tick);
+        break;
+    case ADSR_EVENT_DECAY:
+        bank.setDecay(v, (unsigned long)event.value, event.tick);
+        break;
+    case ADSR_EVENT_SUSTAIN:
+        bank.setSustain(v, (int)event.value);
+        break;
+    case ADSR_EVENT_RELEASE:
+        bank.setRelease(v, (unsigned long)event.value, event.tick);
+        break;
+    case ADSR_EVENT_RESET_ATTACK:
+        bank.setResetAttack(v, event.value != 0);
+        break;
+    case ADSR_EVENT_CURVE_ATTACK:
+        bank.adsrCurveAttack(v, (uint8_t)event.value);
+        break;
+    case ADSR_EVENT_CURVE_DECAY:
+        bank.adsrCurveDecay(v, (uint8_t)event.value);
+        break;
+    case ADSR_EVENT_CURVE_RELEASE:
+        bank.adsrCurveRelease(v, (uint8_t)event.value);
+        break;
+    }
+}
+
+// renderBlock() with the queued events applied at their exact tick: the block
+// is split at every event, so a note on at tick T affects the first sample at
+// or after T. Late events (tick before start_tick) are applied first.
+template <size_t Capacity>
+inline void adsrRenderBlock(AdsrEventQueue<Capacity> &queue, adsr &env, int *out, size_t n, unsigned long start_tick, unsigned long tick_step)
+{
+    size_t i = 0;
+    while (i < n)
+    {
+        unsigned long l_ticks = start_tick + (unsigned long)i * tick_step;
+        queue.drainUntil(l_ticks, [&env](const AdsrEvent &event) { adsrApplyEvent(env, event); });
+
+        // Render up to the sample the next event falls on
+        size_t end = n;
+        AdsrEvent next;
+        if (queue.peek(next) && tick_step > 0)
+        {
+            unsigned long wait = next.tick - l_ticks;
+            unsigned long samples = (wait + tick_step - 1) / tick_step;
+            if (samples < (unsigned long)(n - i))
+                end = i + samples;
+        }
+
+        env.renderBlock(out + i, end - i, l_ticks, tick_step);
+        i = end;
+    }
+}
+
+// AdsrBank::getWave(now) with the events due at now applied first
+template <size_t Capacity, size_t N>
+inline const int *adsrGetWave(AdsrEventQueue<Capacity> &queue, AdsrBank<N> &bank, unsigned long now)
+{
+    queue.drainUntil(now, [&bank](const AdsrEvent &event) { adsrApplyEvent(bank, event); });
+    return bank.getWave(now);
+}
+
+#endif
@@ -0,0 +1,257 @@
+//----------------------------------//
+// Multi-threaded voice rendering
+// Fixed worker pool with work stealing for rendering many adsr voices
+// (or AdsrBank blocks) per audio block on hosts with std::thread
+//----------------------------------//
+
+#ifndef ADSR_PARALLEL
+#define ADSR_PARALLEL
+
+#include "ADSR_Bezier.h"
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+
+template <size_t N>
+class AdsrBank;
+
+// Runs parallelFor() jobs on `threads` threads: the calling thread plus
+// threads - 1 workers started once in the constructor.
+//
+// The tasks of a job are split into one contiguous range per thread. Each
+// thread takes tasks from the front of its own range and, once it is empty,
+// steals from the back of the others, so voices that are cheap this block
+// (idle, sustain) and voices crossing a stage boundary balance out. Every
+// task must write only its own output: results then do not depend on which
+// thread ran which task, and are bit-identical to a serial run.
+class AdsrRenderPool
+{
+public:
+    explicit AdsrRenderPool(size_t threads)
+    {
+        if (threads < 1)
+            threads = 1;
+        if (threads > MAX_THREADS)
+            threads = MAX_THREADS;
+        _threads = threads;
+        _generation = 0;
+        _running = 0;
+        _stop = false;
+
+        for (size_t w = 1; w < _threads; ++w)
+            _workers[w] = std::thread(&AdsrRenderPool::_workerLoop, this, w);
+    }
+
+    ~AdsrRenderPool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _stop = true;
+        }
+        _start_cv.notify_all();
+        for (size_t w = 1; w < _threads; ++w)
+            _workers[w].join();
+    }
+
+    AdsrRenderPool(const AdsrRenderPool &) = delete;
+    AdsrRenderPool &operator=(const AdsrRenderPool &) = delete;
+
+    size_t threads() const { return _threads; }
+
+    // Calls fn(task) for every task in [0, tasks) and returns when all are done
+    template <typename Fn>
+    void parallelFor(size_t tasks, Fn &&fn)
+    {
+        if (_threads == 1 || tasks <= 1)
+        {
+            for (size_t t = 0; t < tasks; ++t)
+                fn(t);
+            return;
+        }
+
+        _job = (void *)&fn;
+        _invoke = &AdsrRenderPool::_invokeTask<typename std::remove_reference<Fn>::type>;
+
+        // Even split; the first (tasks % threads) ranges get one extra task
+        size_t begin = 0;
+        for (size_t w = 0; w < _threads; ++w)
+        {
+            size_t count = tasks / _threads + (w < tasks % _threads ? 1 : 0);
+            _ranges[w].packed.store(_pack((uint32_t)begin, (uint32_t)(begin + count)), std::memory_order_relaxed);
+            begin += count;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _running = _threads - 1;
+            _generation++;
+        }
+        _start_cv.notify_all();
+
+        _runTasks(0);
+
+        std::unique_lock<std::mutex> lock(_mutex);
+        _done_cv.wait(lock, [this] { return _running == 0; });
+    }
+
+    static constexpr size_t MAX_THREADS = 64;
+
+private:
+    // Task range of one thread: front in the low 32 bits, back in the high 32 bits
+    struct alignas(64) Range
+    {
+        std::atomic<uint64_t> packed;
+    };
+
+    static uint64_t _pack(uint32_t front, uint32_t back)
+    {
+        return (uint64_t)front | ((uint64_t)back << 32);
+    }
+
+    template <typename Fn>
+    static void _invokeTask(void *job, size_t task)
+    {
+        (*static_cast<Fn *>(job))(task);
+    }
+
+    // Owner side: take the first task of the range
+    bool _popFront(size_t w, size_t &task)
+    {
+        uint64_t r = _ranges[w].packed.load(std::memory_order_acquire);
+        for (;;)
+        {
+            uint32_t front = (uint32_t)r;
+            uint32_t back = (uint32_t)(r >> 32);
+            if (front >= back)
+                return false;
+            if (_ranges[w].packed.compare_exchange_weak(r, _pack(front + 1, back), std::memory_order_acq_rel))
+            {
+                task = front;
+                return true;
+            }
+        }
+    }
+
+    // Thief side: take the last task of another thread's range
+    bool _stealBack(size_t w, size_t &task)
+    {
+        uint64_t r = _ranges[w].packed.load(std::memory_order_acquire);
+        for (;;)
+        {
+            uint32_t front = (uint32_t)r;
+            uint32_t back = (uint32_t)(r >> 32);
+            if (front >= back)
+                return false;
+            if (_ranges[w].packed.compare_exchange_weak(r, _pack(front, back - 1), std::memory_order_acq_rel))
+            {
+                task = back - 1;
+                return true;
+            }
+        }
+    }
+
+    // Runs until no range has tasks left
+    void _runTasks(size_t w)
+    {
+        size_t task;
+        while (_popFront(w, task))
+            _invoke(_job, task);
+
+        for (;;)
+        {
+            bool stolen = false;
+            for (size_t i = 1; i < _threads; ++i)
+            {
+                if (_stealBack((w + i) % _threads, task))
+                {
+                    _invoke(_job, task);
+                    stolen = true;
+                    break;
+                }
+            }
+            if (!stolen)
+                return;
+        }
+    }
+
+    void _workerLoop(size_t w)
+    {
+        unsigned long seen = 0;
+        for (;;)
+        {
+            {
+                std::unique_lock<std::mutex> lock(_mutex);
+                _start_cv.wait(lock, [this, seen] { return _stop || _generation != seen; });
+                if (_stop)
+                    return;
+                seen = _generation;
+            }
+
+            _runTasks(w);
+
+            bool last;
+            {
+                std::lock_guard<std::mutex> lock(_mutex);
+                last = (--_running == 0);
+            }
+            if (last)
+                _done_cv.notify_one();
+        }
+    }
+
+    size_t _threads;
+    std::thread _workers[MAX_THREADS];
+    Range _ranges[MAX_THREADS];
+
+    // Current job (written before the generation bump, read by the workers after it)
+    void *_job = nullptr;
+    void (*_invoke)(void *, size_t) = nullptr;
+
+    std::mutex _mutex;
+    std::condition_variable _start_cv;
+    std::condition_variable _done_cv;
+    unsigned long _generation;
+    size_t _running;
+    bool _stop;
+};
+
+// renderBlock() for count voices in parallel, voices_per_task voices per task.
+// Voice v writes out[v * n .. v * n + n - 1].
+inline void adsrRenderVoices(AdsrRenderPool &pool, adsr *const *voices, size_t count, int *out, size_t n,
+                             unsigned long start_tick, unsigned long tick_step, size_t voices_per_task = 8)
+{
+    if (voices_per_task < 1)
+        voices_per_task = 1;
+
+    auto task = [=](size_t t) {
+        size_t begin = t * voices_per_task;
+        size_t end = begin + voices_per_task < count ? begin + voices_per_task : count;
+        for (size_t v = begin; v < end; ++v)
+            voices[v]->renderBlock(out + v * n, n, start_tick, tick_step);
+    };
+    pool.parallelFor((count + voices_per_task - 1) / voices_per_task, task);
+}
+
+// n samples of count banks in parallel, one bank per task. Bank b writes
+// out[b * n * N ..], sample-major: sample i of voice v at [b * n * N + i * N + v].
+template <size_t N>
+inline void adsrRenderBanks(AdsrRenderPool &pool, AdsrBank<N> *const *banks, size_t count, int *out, size_t n,
+                            unsigned long start_tick, unsigned long tick_step)
+{
+    auto task = [=](size_t b) {
+        int *dst = out + b * n * N;
+        unsigned long l_ticks = start_tick;
+        for (size_t i = 0; i < n; ++i)
+        {
+            const int *levels = banks[b]->getWave(l_ticks);
+            for (size_t v = 0; v < N; ++v)
+                dst[i * N + v] = levels[v];
+            l_ticks += tick_step;
+        }
+    };
+    pool.parallelFor(count, task);
+}
+
+#endif
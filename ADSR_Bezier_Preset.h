@@ -0,0 +1,505 @@
+//----------------------------------//
+// Shared presets
+// Flyweight split of the adsr class: stage times, scales, curves and levels
+// live once in an AdsrPreset, each voice keeps a 16-byte AdsrVoiceState
+//----------------------------------//
+
+#ifndef ADSR_PRESET
+#define ADSR_PRESET
+
+#include "ADSR_Bezier.h"
+
+#if ADSR_BEZIER_EXP_ONLY
+#error "AdsrPreset reads the curve tables, which ADSR_BEZIER_EXP_ONLY leaves out"
+#endif
+
+// Runtime state of one voice: four voices per 64-byte cache line. Zero
+// (the default) is an idle voice at level 0. Ticks are kept as their low 32
+// bits, which is all an unsigned long holds on 32-bit targets: on a 64-bit
+// host a stage must be rendered at least once every 2^32 ticks.
+struct AdsrVoiceState
+{
+    uint32_t t_phase_start = 0;     // tick at which the running stage started
+    int32_t output = 0;             // last output
+    int32_t range_q16 = 0;          // attack: Q16 scale of vertical_resolution - start, release: of start
+    uint16_t start = 0;             // level at noteOn() (attack) or noteOff() (release)
+    uint8_t phase = 0;              // adsr::ADSRPhase
+    uint8_t notes_pressed = 0;
+};
+
+static_assert(sizeof(AdsrVoiceState) == 16, "AdsrVoiceState should stay 16 bytes");
+static_assert(adsrRangeMapQ16(65535, 65536) == 65535 && adsrRangeMapQ16(32911, 65536) == 32911,
+              "the output mapping must cover vertical resolutions up to 65535");
+
+// Stage times with their precomputed scales, sustain, curves and retrigger
+// behavior of a patch, shared by any number of voices. The voice functions
+// (noteOn(), getWave(), renderBlock(), ...) take the voice's state; a voice
+// played through a preset gives the same output as an adsr object with the
+// same settings, sample for sample.
+//
+// A preset edit reaches every voice at its next sample. Like adsr, a voice
+// whose running stage gets a new time keeps its position in that stage when
+// the setter is given the voices and the tick of their last sample. Without
+// them the voices keep the time already spent in the stage instead.
+//
+// getWave(now) / renderBlock() timebase only (no tick() or exponential mode).
+// vertical_resolution up to 65535 (start levels are stored in 16 bits).
+class AdsrPreset
+{
+public:
+    AdsrPreset(int l_vertical_resolution, int bezier_attack_type, int bezier_decay_type, int bezier_release_type)
+    {
+        // same initial values as the adsr constructor
+        _vertical_resolution = l_vertical_resolution;
+        _vres_recip = adsrRangeReciprocal(l_vertical_resolution);
+        _attack = 100000;
+        _decay = 100000;
+        _release = 100000;
+        _attack_scale = adsrStageScale(_attack);
+        _decay_scale = adsrStageScale(_decay);
+        _release_scale = adsrStageScale(_release);
+        _sustain = l_vertical_resolution / 2;
+        _decay_range_scale_q16 = 0;
+        adsrCurveAttack(bezier_attack_type);
+        adsrCurveDecay(bezier_decay_type);
+        adsrCurveRelease(bezier_release_type);
+    }
+
+    // ---- patch ----
+
+    void adsrCurveAttack(uint8_t curveType)
+    {
+        adsrCurveAttackTable(_curve_tables[curveType]);
+    }
+
+    void adsrCurveDecay(uint8_t curveType)
+    {
+        adsrCurveDecayTable(_curve_tables[curveType]);
+    }
+
+    void adsrCurveRelease(uint8_t curveType)
+    {
+        adsrCurveReleaseTable(_curve_tables[curveType]);
+    }
+
+    // Custom curve tables, see adsr::adsrCurveAttackTable()
+    void adsrCurveAttackTable(const adsr_curve_t *table)
+    {
+        _attack_table = table;
+        _attack_table_b = table;
+        _attack_morph = 0;
+    }
+
+    void adsrCurveDecayTable(const adsr_curve_t *table)
+    {
+        _decay_table = table;
+        _decay_table_b = table;
+        _decay_morph = 0;
+    }
+
+    void adsrCurveReleaseTable(const adsr_curve_t *table)
+    {
+        _release_table = table;
+        _release_table_b = table;
+        _release_morph = 0;
+    }
+
+    // Curve morphs, see adsr::adsrCurveAttackMorph()
+    void adsrCurveAttackMorph(uint8_t from, uint8_t to, uint16_t amount)
+    {
+        adsrCurveAttackMorphTables(_curve_tables[from], _curve_tables[to], amount);
+    }
+
+    void adsrCurveDecayMorph(uint8_t from, uint8_t to, uint16_t amount)
+    {
+        adsrCurveDecayMorphTables(_curve_tables[from], _curve_tables[to], amount);
+    }
+
+    void adsrCurveReleaseMorph(uint8_t from, uint8_t to, uint16_t amount)
+    {
+        adsrCurveReleaseMorphTables(_curve_tables[from], _curve_tables[to], amount);
+    }
+
+    void adsrCurveAttackMorphTables(const adsr_curve_t *from, const adsr_curve_t *to, uint16_t amount)
+    {
+        _attack_table = from;
+        _attack_table_b = to;
+        setAttackMorph(amount);
+    }
+
+    void adsrCurveDecayMorphTables(const adsr_curve_t *from, const adsr_curve_t *to, uint16_t amount)
+    {
+        _decay_table = from;
+        _decay_table_b = to;
+        setDecayMorph(amount);
+    }
+
+    void adsrCurveReleaseMorphTables(const adsr_curve_t *from, const adsr_curve_t *to, uint16_t amount)
+    {
+        _release_table = from;
+        _release_table_b = to;
+        setReleaseMorph(amount);
+    }
+
+    void setAttackMorph(uint16_t amount)
+    {
+        _attack_morph = adsrMorphWeight(amount);
+    }
+
+    void setDecayMorph(uint16_t amount)
+    {
+        _decay_morph = adsrMorphWeight(amount);
+    }
+
+    void setReleaseMorph(uint16_t amount)
+    {
+        _release_morph = adsrMorphWeight(amount);
+    }
+
+    void setResetAttack(bool l_reset_attack)
+    {
+        _reset_attack = l_reset_attack;
+    }
+
+    // Stage times in milliseconds. voices[0..count-1] in the changed stage keep
+    // their position as of tick last (the timestamp of their last sample).
+    void setAttack(unsigned long l_attack_ms, AdsrVoiceState *voices = nullptr, size_t count = 0, unsigned long last = 0)
+    {
+        unsigned long ticks = _msToTicks(l_attack_ms);
+        _setStageTicks(adsr::ADSR_PHASE_ATTACK, _attack, _attack_scale, ticks, adsrStageScale(ticks), voices, count, last);
+    }
+
+    void setDecay(unsigned long l_decay_ms, AdsrVoiceState *voices = nullptr, size_t count = 0, unsigned long last = 0)
+    {
+        unsigned long ticks = _msToTicks(l_decay_ms);
+        _setStageTicks(adsr::ADSR_PHASE_DECAY, _decay, _decay_scale, ticks, adsrStageScale(ticks), voices, count, last);
+    }
+
+    void setRelease(unsigned long l_release_ms, AdsrVoiceState *voices = nullptr, size_t count = 0, unsigned long last = 0)
+    {
+        unsigned long ticks = _msToTicks(l_release_ms);
+        _setStageTicks(adsr::ADSR_PHASE_RELEASE, _release, _release_scale, ticks, adsrStageScale(ticks), voices, count, last);
+    }
+
+    // Stage times from a control value, see adsr::modAttack()
+    template <size_t Steps>
+    void modAttack(const AdsrTimeTable<Steps> &times, uint16_t value, AdsrVoiceState *voices = nullptr, size_t count = 0, unsigned long last = 0)
+    {
+        unsigned long ticks;
+        uint64_t scale;
+        times.lookup(value, ticks, scale);
+        _setStageTicks(adsr::ADSR_PHASE_ATTACK, _attack, _attack_scale, ticks, scale, voices, count, last);
+    }
+
+    template <size_t Steps>
+    void modDecay(const AdsrTimeTable<Steps> &times, uint16_t value, AdsrVoiceState *voices = nullptr, size_t count = 0, unsigned long last = 0)
+    {
+        unsigned long ticks;
+        uint64_t scale;
+        times.lookup(value, ticks, scale);
+        _setStageTicks(adsr::ADSR_PHASE_DECAY, _decay, _decay_scale, ticks, scale, voices, count, last);
+    }
+
+    template <size_t Steps>
+    void modRelease(const AdsrTimeTable<Steps> &times, uint16_t value, AdsrVoiceState *voices = nullptr, size_t count = 0, unsigned long last = 0)
+    {
+        unsigned long ticks;
+        uint64_t scale;
+        times.lookup(value, ticks, scale);
+        _setStageTicks(adsr::ADSR_PHASE_RELEASE, _release, _release_scale, ticks, scale, voices, count, last);
+    }
+
+    // Sustain level; decaying and sustaining voices follow at their next sample
+    void setSustain(int l_sustain)
+    {
+        if (l_sustain < 0)
+            l_sustain = 0;
+        if (l_sustain >= _vertical_resolution)
+            l_sustain = _vertical_resolution;
+        _sustain = l_sustain;
+        _decay_range_scale_q16 = _rangeScaleQ16((int32_t)_vertical_resolution - (int32_t)l_sustain);
+    }
+
+    int verticalResolution() const { return _vertical_resolution; }
+
+    // ---- voices ----
+
+    void noteOn(AdsrVoiceState &voice, unsigned long now) const
+    {
+        voice.start = _reset_attack ? 0 : (uint16_t)voice.output;
+        if (voice.notes_pressed < 0xFF)
+            voice.notes_pressed++;
+        voice.phase = adsr::ADSR_PHASE_ATTACK;
+        voice.t_phase_start = (uint32_t)now;
+        voice.range_q16 = _rangeScaleQ16((int32_t)_vertical_resolution - (int32_t)voice.start);
+    }
+
+    void noteOff(AdsrVoiceState &voice, unsigned long now) const
+    {
+        if (voice.notes_pressed > 0)
+            voice.notes_pressed--;
+        if (voice.notes_pressed != 0)
+            return;
+
+        voice.start = (uint16_t)voice.output;
+        voice.phase = adsr::ADSR_PHASE_RELEASE;
+        voice.t_phase_start = (uint32_t)now;
+        int32_t rs = voice.output;
+        if (rs > _vertical_resolution)
+            rs = _vertical_resolution;
+        voice.range_q16 = _rangeScaleQ16(rs);
+    }
+
+    // Same state machine as adsr::getWave(now)
+    int getWave(AdsrVoiceState &voice, unsigned long l_ticks) const
+    {
+        uint32_t delta = (uint32_t)l_ticks - voice.t_phase_start;
+
+        switch (voice.phase)
+        {
+        case adsr::ADSR_PHASE_ATTACK:
+            if (_attack == 0 || delta >= _attack)
+            {
+                voice.output = _vertical_resolution;
+                if (_decay > 0)
+                {
+                    voice.phase = adsr::ADSR_PHASE_DECAY;
+                    voice.t_phase_start = (uint32_t)l_ticks;
+                }
+                else
+                {
+                    voice.phase = adsr::ADSR_PHASE_SUSTAIN;
+                }
+                break;
+            }
+            voice.output = _value(_attack_table, _attack_table_b, adsrStagePositionMax() - adsrStagePosition(delta, _attack, _attack_scale),
+                                  _attack_morph, voice.start, voice.range_q16);
+            break;
+
+        case adsr::ADSR_PHASE_DECAY:
+            if (_decay == 0 || delta >= _decay)
+            {
+                voice.output = _sustain;
+                voice.phase = adsr::ADSR_PHASE_SUSTAIN;
+                break;
+            }
+            voice.output = _value(_decay_table, _decay_table_b, adsrStagePosition(delta, _decay, _decay_scale),
+                                  _decay_morph, _sustain, _decay_range_scale_q16);
+            break;
+
+        case adsr::ADSR_PHASE_SUSTAIN:
+            voice.output = _sustain;
+            break;
+
+        case adsr::ADSR_PHASE_RELEASE:
+            if (_release == 0 || delta >= _release)
+            {
+                voice.output = 0;
+                voice.phase = adsr::ADSR_PHASE_IDLE;
+                break;
+            }
+            voice.output = _value(_release_table, _release_table_b, adsrStagePosition(delta, _release, _release_scale),
+                                  _release_morph, 0, voice.range_q16);
+            break;
+
+        default:
+            voice.output = 0;
+            break;
+        }
+        return voice.output;
+    }
+
+    // Same contract as adsr::renderBlock(): identical to getWave() per sample
+    void renderBlock(AdsrVoiceState &voice, int *out, size_t n, unsigned long start_tick, unsigned long tick_step) const
+    {
+        unsigned long l_ticks = start_tick;
+        size_t i = 0;
+
+        while (i < n)
+        {
+            unsigned long duration;
+            uint64_t scale;
+            const adsr_curve_t *table;
+            const adsr_curve_t *table_b;
+            int32_t morph;
+            int32_t base = 0;
+            uint32_t m = 0;
+
+            switch (voice.phase)
+            {
+            case adsr::ADSR_PHASE_ATTACK:
+                duration = _attack;
+                scale = _attack_scale;
+                table = _attack_table;
+                table_b = _attack_table_b;
+                morph = _attack_morph;
+                base = voice.start;
+                m = 0xFFFFFFFFUL; // attack reads the table backwards
+                break;
+            case adsr::ADSR_PHASE_DECAY:
+                duration = _decay;
+                scale = _decay_scale;
+                table = _decay_table;
+                table_b = _decay_table_b;
+                morph = _decay_morph;
+                base = _sustain;
+                break;
+            case adsr::ADSR_PHASE_RELEASE:
+                duration = _release;
+                scale = _release_scale;
+                table = _release_table;
+                table_b = _release_table_b;
+                morph = _release_morph;
+                break;
+            default:
+            {
+                // Sustain and idle: constant until the next note event
+                int level = voice.phase == adsr::ADSR_PHASE_SUSTAIN ? _sustain : 0;
+                for (; i < n; ++i)
+                    out[i] = level;
+                voice.output = level;
+                return;
+            }
+            }
+
+            const int32_t range_q16 = voice.phase == adsr::ADSR_PHASE_DECAY ? _decay_range_scale_q16 : voice.range_q16;
+            const uint32_t pos_max = adsrStagePositionMax();
+            const uint32_t flip = m & pos_max;
+            const unsigned shift = adsrStageShift(duration);
+            const int32_t vres = _vertical_resolution;
+            unsigned long delta = (uint32_t)l_ticks - voice.t_phase_start;
+            size_t run = 0;
+            for (; i < n && delta < duration; ++i, ++run, delta += tick_step)
+            {
+                uint32_t pos = (uint32_t)(((uint64_t)delta * scale) >> shift);
+                if (pos > pos_max)
+                    pos = pos_max;
+                int32_t level = base + adsrRangeMapQ16(adsrCurveLookupMorph(table, table_b, ((pos ^ m) - m) + flip, morph), range_q16);
+                out[i] = level < 0 ? 0 : (level > vres ? vres : level);
+            }
+            if (run > 0)
+            {
+                voice.output = out[i - 1];
+                l_ticks += (unsigned long)run * tick_step;
+            }
+
+            // The next sample ends the stage: let getWave() handle it
+            if (i < n)
+            {
+                out[i++] = getWave(voice, l_ticks);
+                l_ticks += tick_step;
+            }
+        }
+    }
+
+    static adsr::ADSRPhase getPhase(const AdsrVoiceState &voice)
+    {
+        return (adsr::ADSRPhase)voice.phase;
+    }
+
+    // See adsr::isActive()
+    static bool isActive(const AdsrVoiceState &voice)
+    {
+        return voice.phase == adsr::ADSR_PHASE_ATTACK || voice.phase == adsr::ADSR_PHASE_DECAY || voice.phase == adsr::ADSR_PHASE_RELEASE;
+    }
+
+    // See adsr::nextChange(). The state only keeps 32 bits of the stage
+    // start: now (any tick from the stage start on, e.g. the last sample
+    // rendered) supplies the rest.
+    bool nextChange(const AdsrVoiceState &voice, unsigned long now, unsigned long &tick) const
+    {
+        unsigned long duration;
+        switch (voice.phase)
+        {
+        case adsr::ADSR_PHASE_ATTACK:
+            duration = _attack;
+            break;
+        case adsr::ADSR_PHASE_DECAY:
+            duration = _decay;
+            break;
+        case adsr::ADSR_PHASE_RELEASE:
+            duration = _release;
+            break;
+        default:
+            return false;
+        }
+        tick = now - (uint32_t)((uint32_t)now - voice.t_phase_start) + duration;
+        return true;
+    }
+
+private:
+    static unsigned long _msToTicks(unsigned long ms)
+    {
+#if ADSR_BEZIER_USE_MICROS
+        return ms * 1000UL;
+#else
+        return ms;
+#endif
+    }
+
+    int32_t _rangeScaleQ16(int32_t range) const
+    {
+        return adsrRangeScaleQ16(range, _vertical_resolution, _vres_recip);
+    }
+
+    // New time for one stage; the given voices running it keep the position
+    // they had at tick last, like adsr::setDecay() does with its last getWave()
+    void _setStageTicks(adsr::ADSRPhase stage, unsigned long &duration, uint64_t &scale, unsigned long ticks, uint64_t new_scale,
+                        AdsrVoiceState *voices, size_t count, unsigned long last)
+    {
+        if (duration != 0)
+        {
+            for (size_t v = 0; v < count; ++v)
+            {
+                if (voices[v].phase != stage)
+                    continue;
+                uint32_t delta = (uint32_t)last - voices[v].t_phase_start;
+                if (delta < duration)
+                    voices[v].t_phase_start = (uint32_t)last - (uint32_t)adsrStageRescale(delta, duration, scale, ticks);
+            }
+        }
+        duration = ticks;
+        scale = new_scale;
+    }
+
+    // Curve value at a table position mapped to the output range, see adsr::_stageOutput()
+    int _value(const adsr_curve_t *table, const adsr_curve_t *table_b, uint32_t pos, int32_t morph,
+               int32_t base, int32_t range_q16) const
+    {
+        int32_t curveVal = adsrCurveLookupMorph(table, table_b, pos, morph);
+        int32_t out = base + adsrRangeMapQ16(curveVal, range_q16);
+        if (out < 0)
+            out = 0;
+        if (out > _vertical_resolution)
+            out = _vertical_resolution;
+        return (int)out;
+    }
+
+    int _vertical_resolution;
+    uint32_t _vres_recip;           // adsrRangeReciprocal(_vertical_resolution)
+
+    // Stage times (ticks) and their Q24/Q40 scales
+    unsigned long _attack;
+    unsigned long _decay;
+    unsigned long _release;
+    uint64_t _attack_scale;
+    uint64_t _decay_scale;
+    uint64_t _release_scale;
+
+    int _sustain;
+    int32_t _decay_range_scale_q16; // Q16 scale of vertical_resolution - sustain
+    bool _reset_attack = false;
+
+    // Curve tables (second table and Q15 weight of a morph)
+    const adsr_curve_t *_attack_table;
+    const adsr_curve_t *_decay_table;
+    const adsr_curve_t *_release_table;
+    const adsr_curve_t *_attack_table_b;
+    const adsr_curve_t *_decay_table_b;
+    const adsr_curve_t *_release_table_b;
+    int32_t _attack_morph;
+    int32_t _decay_morph;
+    int32_t _release_morph;
+};
+
+#endif
@@ -0,0 +1,463 @@
+//----------------------------------//
+// Multi-segment envelopes
+// Data-driven N-segment engine (DAHDSR, multi-breakpoint, ...) on the same
+// curve tables and fixed-point stage mapping as the adsr class
+//----------------------------------//
+
+#ifndef ADSR_SEGMENTS
+#define ADSR_SEGMENTS
+
+#include "ADSR_Bezier.h"
+
+#if ADSR_BEZIER_EXP_ONLY
+#error "AdsrSegmentEnvelope reads the curve tables, which ADSR_BEZIER_EXP_ONLY leaves out"
+#endif
+
+// Segment target meaning "stay at the level the segment started from" (delay, hold)
+static constexpr int32_t ADSR_SEGMENT_HOLD = INT32_MIN;
+
+// One segment: runs from the level at its start to target over duration
+// ticks along a curve table, or (sustain) holds target until noteOff().
+// Rising segments read the table backwards, like the adsr attack.
+struct AdsrSegment
+{
+    unsigned long duration;     // ticks, 0 = jump to the target
+    uint64_t scale;             // adsrStageScale(duration)
+    const adsr_curve_t *table;
+    const adsr_curve_t *table_b; // second curve of a morph
+    int32_t morph;              // Q15 morph weight, 0 = table only
+    int32_t target;             // level at the end, or ADSR_SEGMENT_HOLD
+    bool sustain;               // hold until noteOff() instead of timing out
+};
+
+// Envelope of up to MaxSegments segments, played in order from noteOn().
+// The first sustain segment holds until the last note is released; noteOff()
+// then jumps to the segment after it (the release part), from the current
+// level. Without a sustain segment the envelope runs to its end on its own.
+// After the last segment the output stays at its end level.
+//
+// Every segment runs through the same code: delta -> table position with the
+// segment's precomputed Q24/Q40 scale, table lookup, Q16 range mapping. The
+// timing rules are those of the adsr class (a segment ends at the first
+// getWave() at or after its end and the next one starts at that timestamp),
+// so configureADSR() reproduces adsr::getWave() bit for bit.
+//
+// getWave(now) / renderBlock() timebase only (no tick() or exponential mode).
+template <size_t MaxSegments>
+class AdsrSegmentEnvelope
+{
+public:
+    static_assert(MaxSegments >= 1 && MaxSegments < 128, "MaxSegments must be 1..127");
+
+    AdsrSegmentEnvelope(int l_vertical_resolution)
+    {
+        _vertical_resolution = l_vertical_resolution;
+        _vres_recip = adsrRangeReciprocal(l_vertical_resolution);
+        _count = 0;
+        for (size_t i = 0; i < MaxSegments; ++i)
+        {
+            _segments[i].duration = 0;
+            _segments[i].scale = 0;
+            _segments[i].table = _curve_tables[0];
+            _segments[i].table_b = _curve_tables[0];
+            _segments[i].morph = 0;
+            _segments[i].target = 0;
+            _segments[i].sustain = false;
+        }
+    }
+
+    static constexpr size_t capacity() { return MaxSegments; }
+
+    // Number of segments played (the rest are ignored)
+    void setSegmentCount(size_t count)
+    {
+        _count = count > MaxSegments ? MaxSegments : count;
+        if (_segment >= (int)_count)
+            _enterIdle();
+    }
+
+    size_t segmentCount() const { return _count; }
+
+    // Timed segment i: reaches target (or holds, ADSR_SEGMENT_HOLD) after time_ms along built-in curve curveType
+    void setSegment(size_t i, unsigned long time_ms, int32_t target, uint8_t curveType)
+    {
+        if (i >= MaxSegments)
+            return;
+        _segments[i].sustain = false;
+        _segments[i].table = _curve_tables[curveType];
+        _segments[i].table_b = _segments[i].table;
+        _segments[i].morph = 0;
+        setTime(i, time_ms);
+        setTarget(i, target);
+    }
+
+    // Sustain segment i: holds target until noteOff()
+    void setSustainSegment(size_t i, int32_t target)
+    {
+        if (i >= MaxSegments)
+            return;
+        _segments[i].sustain = true;
+        _segments[i].duration = 0;
+        _segments[i].scale = 0;
+        setTarget(i, target);
+    }
+
+    // Segment time in milliseconds. A running segment keeps its current position.
+    void setTime(size_t i, unsigned long time_ms)
+    {
+#if ADSR_BEZIER_USE_MICROS
+        unsigned long ticks = time_ms * 1000UL;
+#else
+        unsigned long ticks = time_ms;
+#endif
+        _setTicks(i, ticks, adsrStageScale(ticks));
+    }
+
+    // Segment time from a control value, without a division (see adsr::modAttack())
+    template <size_t Steps>
+    void modTime(size_t i, const AdsrTimeTable<Steps> &times, uint16_t value)
+    {
+        unsigned long ticks;
+        uint64_t scale;
+        times.lookup(value, ticks, scale);
+        _setTicks(i, ticks, scale);
+    }
+
+    // Target level, saturated to [0, vertical_resolution] (ADSR_SEGMENT_HOLD kept).
+    // A running segment heads for the new target from where it started.
+    void setTarget(size_t i, int32_t target)
+    {
+        if (i >= MaxSegments)
+            return;
+        if (target != ADSR_SEGMENT_HOLD)
+        {
+            if (target < 0)
+                target = 0;
+            if (target > _vertical_resolution)
+                target = _vertical_resolution;
+        }
+        _segments[i].target = target;
+        if ((int)i == _segment)
+            _enterLevels();
+    }
+
+    void setCurve(size_t i, uint8_t curveType)
+    {
+        setCurveTable(i, _curve_tables[curveType]);
+    }
+
+    // Any table of ARRAY_SIZE entries; it must stay valid while the segment can run
+    void setCurveTable(size_t i, const adsr_curve_t *table)
+    {
+        if (i >= MaxSegments)
+            return;
+        _segments[i].table = table;
+        _segments[i].table_b = table;
+        _segments[i].morph = 0;
+    }
+
+    // Blend of two curves, see adsr::adsrCurveAttackMorph()
+    void setCurveMorph(size_t i, uint8_t from, uint8_t to, uint16_t amount)
+    {
+        setCurveMorphTables(i, _curve_tables[from], _curve_tables[to], amount);
+    }
+
+    void setCurveMorphTables(size_t i, const adsr_curve_t *from, const adsr_curve_t *to, uint16_t amount)
+    {
+        if (i >= MaxSegments)
+            return;
+        _segments[i].table = from;
+        _segments[i].table_b = to;
+        setMorph(i, amount);
+    }
+
+    // Morph amount of segment i (0 .. 65535), takes effect at the next sample
+    void setMorph(size_t i, uint16_t amount)
+    {
+        if (i >= MaxSegments)
+            return;
+        _segments[i].morph = adsrMorphWeight(amount);
+    }
+
+    const AdsrSegment &segment(size_t i) const { return _segments[i]; }
+
+    // Level of the sustain segment and of the segment leading into it (the
+    // decay of an ADSR), like adsr::setSustain()
+    void setSustainLevel(int32_t level)
+    {
+        int s = _sustainIndex();
+        if (s < 0)
+            return;
+        setTarget((size_t)s, level);
+        if (s > 0 && !_segments[s - 1].sustain)
+            setTarget((size_t)s - 1, level);
+    }
+
+    void setResetAttack(bool l_reset_attack)
+    {
+        _reset_attack = l_reset_attack;
+    }
+
+    // attack, decay, sustain, release: the adsr class as four segments
+    void configureADSR(unsigned long attack_ms, unsigned long decay_ms, int32_t sustain, unsigned long release_ms,
+                       uint8_t attack_curve, uint8_t decay_curve, uint8_t release_curve)
+    {
+        static_assert(MaxSegments >= 4, "configureADSR() needs 4 segments");
+        setSegment(0, attack_ms, _vertical_resolution, attack_curve);
+        setSegment(1, decay_ms, sustain, decay_curve);
+        setSustainSegment(2, sustain);
+        setSegment(3, release_ms, 0, release_curve);
+        setSegmentCount(4);
+    }
+
+    // delay, attack, hold, decay, sustain, release
+    void configureDAHDSR(unsigned long delay_ms, unsigned long attack_ms, unsigned long hold_ms,
+                         unsigned long decay_ms, int32_t sustain, unsigned long release_ms,
+                         uint8_t attack_curve, uint8_t decay_curve, uint8_t release_curve)
+    {
+        static_assert(MaxSegments >= 6, "configureDAHDSR() needs 6 segments");
+        setSegment(0, delay_ms, ADSR_SEGMENT_HOLD, attack_curve);
+        setSegment(1, attack_ms, _vertical_resolution, attack_curve);
+        setSegment(2, hold_ms, ADSR_SEGMENT_HOLD, decay_curve);
+        setSegment(3, decay_ms, sustain, decay_curve);
+        setSustainSegment(4, sustain);
+        setSegment(5, release_ms, 0, release_curve);
+        setSegmentCount(6);
+    }
+
+    void noteOn(unsigned long now)
+    {
+        _notes_pressed++;
+        if (_count == 0)
+            return;
+        _enter(0, _reset_attack ? 0 : _output, now);
+    }
+
+    void noteOff(unsigned long now)
+    {
+        _notes_pressed--;
+        if (_notes_pressed > 0)
+            return;
+        _notes_pressed = 0;
+
+        int s = _sustainIndex();
+        if (s < 0)
+            return;
+        if ((size_t)s + 1 < _count)
+            _enter((size_t)s + 1, _output, now);
+        else
+            _enterIdle();
+    }
+
+    // Level at an explicit timestamp (ticks in the compiled timebase)
+    int getWave(unsigned long l_ticks)
+    {
+        _t_last = l_ticks;
+        if (_segment < 0)
+            return _output;
+
+        const AdsrSegment &seg = _segments[_segment];
+        if (seg.sustain)
+        {
+            _output = _endLevel(seg);
+            return _output;
+        }
+
+        unsigned long delta = l_ticks - _t_segment_start;
+        if (delta >= seg.duration)
+        {
+            // End of the segment: its end level now, the next segment from this timestamp
+            _output = _endLevel(seg);
+            _advance(l_ticks);
+            return _output;
+        }
+
+        uint32_t pos = adsrStagePosition(delta, seg.duration, seg.scale);
+        _output = _value(seg, (pos ^ _reverse_mask) - _reverse_mask + _reverse_flip);
+        return _output;
+    }
+
+    // Same contract as adsr::renderBlock(): identical to getWave() per sample
+    void renderBlock(int *out, size_t n, unsigned long start_tick, unsigned long tick_step)
+    {
+        unsigned long l_ticks = start_tick;
+        size_t i = 0;
+
+        while (i < n)
+        {
+            if (_segment < 0 || _segments[_segment].sustain)
+            {
+                // Constant until the next note event
+                int level = (_segment < 0) ? _output : _endLevel(_segments[_segment]);
+                for (; i < n; ++i)
+                    out[i] = level;
+                _output = level;
+                _t_last = start_tick + (unsigned long)(n - 1) * tick_step;
+                return;
+            }
+
+            const AdsrSegment &seg = _segments[_segment];
+            unsigned long delta = l_ticks - _t_segment_start;
+            const unsigned shift = adsrStageShift(seg.duration);
+            const uint32_t pos_max = adsrStagePositionMax();
+            size_t run = 0;
+            for (; i < n && delta < seg.duration; ++i, ++run, delta += tick_step)
+            {
+                uint32_t pos = (uint32_t)(((uint64_t)delta * seg.scale) >> shift);
+                if (pos > pos_max)
+                    pos = pos_max;
+                out[i] = _value(seg, (pos ^ _reverse_mask) - _reverse_mask + _reverse_flip);
+            }
+            if (run > 0)
+            {
+                _output = out[i - 1];
+                l_ticks += (unsigned long)run * tick_step;
+                _t_last = l_ticks - tick_step;
+            }
+
+            // The next sample ends the segment: let getWave() handle it
+            if (i < n)
+            {
+                out[i++] = getWave(l_ticks);
+                l_ticks += tick_step;
+            }
+        }
+    }
+
+    // Running segment index, -1 when idle
+    int getSegment() const { return _segment; }
+
+    // True while a timed segment runs (the output moves on its own)
+    bool isActive() const
+    {
+        return _segment >= 0 && !_segments[_segment].sustain;
+    }
+
+    // Tick at which the running segment ends, see adsr::nextChange()
+    bool nextChange(unsigned long &tick) const
+    {
+        if (!isActive())
+            return false;
+        tick = _t_segment_start + _segments[_segment].duration;
+        return true;
+    }
+
+private:
+    int _sustainIndex() const
+    {
+        for (size_t i = 0; i < _count; ++i)
+            if (_segments[i].sustain)
+                return (int)i;
+        return -1;
+    }
+
+    int32_t _endLevel(const AdsrSegment &seg) const
+    {
+        return seg.target == ADSR_SEGMENT_HOLD ? _start_level : seg.target;
+    }
+
+    void _enter(size_t i, int32_t start_level, unsigned long now)
+    {
+        _segment = (int)i;
+        _start_level = start_level;
+        _t_segment_start = now;
+        _enterLevels();
+    }
+
+    void _enterIdle()
+    {
+        _segment = -1;
+    }
+
+    // Next segment from now. Zero-length timed segments before a segment that
+    // follows are passed over at once (their targets carried along), the way
+    // adsr goes from attack straight to sustain when the decay time is 0: a
+    // later time change must not restart a segment adsr has already left.
+    void _advance(unsigned long now)
+    {
+        size_t next = (size_t)_segment + 1;
+        size_t k = next;
+        int32_t level = _output;
+        while (k < _count && !_segments[k].sustain && _segments[k].duration == 0)
+        {
+            if (_segments[k].target != ADSR_SEGMENT_HOLD)
+                level = _segments[k].target;
+            ++k;
+        }
+        if (k < _count)
+            _enter(k, level, now);
+        else if (next < _count)
+            _enter(next, _output, now);
+        else
+            _enterIdle();
+    }
+
+    // Base, Q16 range and table direction of the running segment: rising
+    // segments read the table backwards from start_level, falling ones
+    // forwards down to the target
+    void _enterLevels()
+    {
+        const AdsrSegment &seg = _segments[_segment];
+        int32_t target = _endLevel(seg);
+        bool rising = target >= _start_level;
+        if (rising)
+        {
+            _base = _start_level;
+            _range_q16 = adsrRangeScaleQ16(target - _start_level, _vertical_resolution, _vres_recip);
+        }
+        else
+        {
+            _base = target;
+            _range_q16 = adsrRangeScaleQ16(_start_level - target, _vertical_resolution, _vres_recip);
+        }
+        _reverse_mask = rising ? 0xFFFFFFFFUL : 0;
+        _reverse_flip = _reverse_mask & adsrStagePositionMax();
+    }
+
+    void _setTicks(size_t i, unsigned long ticks, uint64_t scale)
+    {
+        if (i >= MaxSegments || _segments[i].sustain)
+            return;
+        AdsrSegment &seg = _segments[i];
+        if ((int)i == _segment && seg.duration != 0)
+        {
+            unsigned long delta = _t_last - _t_segment_start;
+            if (delta < seg.duration)
+                _t_segment_start = _t_last - adsrStageRescale(delta, seg.duration, seg.scale, ticks);
+        }
+        seg.duration = ticks;
+        seg.scale = scale;
+    }
+
+    int _value(const AdsrSegment &seg, uint32_t pos) const
+    {
+        int32_t curveVal = adsrCurveLookupMorph(seg.table, seg.table_b, pos, seg.morph);
+        int32_t out = _base + adsrRangeMapQ16(curveVal, _range_q16);
+        if (out < 0)
+            out = 0;
+        if (out > _vertical_resolution)
+            out = _vertical_resolution;
+        return (int)out;
+    }
+
+    AdsrSegment _segments[MaxSegments];
+    size_t _count;
+
+    int _vertical_resolution;
+    uint32_t _vres_recip;
+    bool _reset_attack = false;
+    int _notes_pressed = 0;
+
+    // Running segment (-1 = idle) and its precomputed mapping
+    int _segment = -1;
+    unsigned long _t_segment_start = 0;
+    unsigned long _t_last = 0;
+    int32_t _start_level = 0;
+    int32_t _base = 0;
+    int32_t _range_q16 = 0;
+    uint32_t _reverse_mask = 0;
+    uint32_t _reverse_flip = 0;
+    int _output = 0;
+};
+
+#endif
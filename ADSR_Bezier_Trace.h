@@ -0,0 +1,637 @@
+//----------------------------------//
+// Trace recording and replay
+// Sinks for the records of adsr::setTrace() (a RAM ring on the target, a
+// file on a host) and a replay that runs a trace against this build and
+// reports the first sample or state that differs
+//----------------------------------//
+
+#ifndef ADSR_TRACE
+#define ADSR_TRACE
+
+// The adsr hooks are compiled in by ADSR_BEZIER_TRACE: include this header
+// before ADSR_Bezier.h (or build with -DADSR_BEZIER_TRACE=1)
+#ifndef ADSR_BEZIER_TRACE
+#define ADSR_BEZIER_TRACE 1
+#endif
+
+#include "ADSR_Bezier.h"
+
+#if !ADSR_BEZIER_TRACE
+#error "ADSR_Bezier.h was included with ADSR_BEZIER_TRACE 0: include ADSR_Bezier_Trace.h first or build with -DADSR_BEZIER_TRACE=1"
+#endif
+
+// The last Records records in RAM (16 bytes each), overwriting the oldest.
+// Write and read it from the context that renders the envelope, e.g. dump
+// it over serial after a glitch and replay it on a host.
+template <size_t Records>
+class AdsrTraceRing : public AdsrTraceSink
+{
+public:
+    static_assert(Records > 0, "Records must be at least 1");
+
+    void write(const AdsrTraceRecord &record) override
+    {
+        _records[_next] = record;
+        if (++_next == Records)
+            _next = 0;
+        _written++;
+    }
+
+    // Records held, at(0) the oldest
+    size_t size() const
+    {
+        return _written < Records ? (size_t)_written : Records;
+    }
+
+    const AdsrTraceRecord &at(size_t i) const
+    {
+        size_t index = (_written < Records ? 0 : _next) + i;
+        if (index >= Records)
+            index -= Records;
+        return _records[index];
+    }
+
+    // Copy the held records, oldest first; returns their count
+    size_t copyTo(AdsrTraceRecord *out) const
+    {
+        size_t count = size();
+        for (size_t i = 0; i < count; ++i)
+            out[i] = at(i);
+        return count;
+    }
+
+    // Records written since clear(), and those overwritten since
+    unsigned long written() const { return _written; }
+    unsigned long dropped() const { return _written - size(); }
+
+    void clear()
+    {
+        _next = 0;
+        _written = 0;
+    }
+
+    static constexpr size_t capacity() { return Records; }
+
+private:
+    AdsrTraceRecord _records[Records];
+    size_t _next = 0;
+    unsigned long _written = 0;
+};
+
+#if !defined(ARDUINO)
+
+#include <stdio.h>
+#include <vector>
+
+// Trace files: this header, then the records as in memory (little endian).
+// Files without it (e.g. a ring dumped by a target) are read as raw records.
+struct AdsrTraceFileHeader
+{
+    char magic[4];              // "ADTR"
+    uint16_t version;           // ADSR_TRACE_FILE_VERSION
+    uint16_t record_size;       // sizeof(AdsrTraceRecord)
+    uint32_t ticks_per_second;  // timebase of the recording build (0: unknown)
+    uint32_t array_size;        // ARRAY_SIZE of the recording build (0: unknown)
+};
+
+static_assert(sizeof(AdsrTraceFileHeader) == 16, "AdsrTraceFileHeader should stay 16 bytes");
+
+static constexpr uint16_t ADSR_TRACE_FILE_VERSION = 1;
+
+// Writes the header and every record to an open binary file (stdio buffers)
+class AdsrTraceFile : public AdsrTraceSink
+{
+public:
+    explicit AdsrTraceFile(FILE *file)
+        : _file(file)
+    {
+        AdsrTraceFileHeader header;
+        memcpy(header.magic, "ADTR", 4);
+        header.version = ADSR_TRACE_FILE_VERSION;
+        header.record_size = sizeof(AdsrTraceRecord);
+        header.ticks_per_second = ADSR_BEZIER_USE_MICROS ? 1000000UL : 1000UL;
+        header.array_size = ARRAY_SIZE;
+        if (fwrite(&header, sizeof(header), 1, _file) != 1)
+            _failed = true;
+    }
+
+    void write(const AdsrTraceRecord &record) override
+    {
+        if (fwrite(&record, sizeof(record), 1, _file) != 1)
+            _failed = true;
+        _written++;
+    }
+
+    unsigned long written() const { return _written; }
+
+    // False once a write failed
+    bool ok() const { return !_failed; }
+
+private:
+    FILE *_file;
+    unsigned long _written = 0;
+    bool _failed = false;
+};
+
+// Read a trace file (with or without header) into records. header, if given,
+// is zeroed for a raw file. Returns false on a read error, another record
+// size or version, or a partial record at the end.
+inline bool adsrTraceRead(FILE *file, std::vector<AdsrTraceRecord> &records, AdsrTraceFileHeader *header = nullptr)
+{
+    AdsrTraceFileHeader head;
+    memset(&head, 0, sizeof(head));
+    records.clear();
+
+    size_t got = fread(&head, 1, sizeof(head), file);
+    size_t pending = 0;
+    if (got == sizeof(head) && memcmp(head.magic, "ADTR", 4) == 0)
+    {
+        if (head.version != ADSR_TRACE_FILE_VERSION || head.record_size != sizeof(AdsrTraceRecord))
+            return false;
+    }
+    else
+    {
+        // Raw records: the bytes read so far are the first one
+        static_assert(sizeof(head) == sizeof(AdsrTraceRecord), "header and record sizes differ");
+        if (got == sizeof(head))
+        {
+            AdsrTraceRecord first;
+            memcpy(&first, &head, sizeof(first));
+            records.push_back(first);
+        }
+        else
+            pending = got;
+        memset(&head, 0, sizeof(head));
+    }
+    if (header != nullptr)
+        *header = head;
+
+    AdsrTraceRecord chunk[256];
+    while (pending == 0)
+    {
+        size_t bytes = fread(chunk, 1, sizeof(chunk), file);
+        records.insert(records.end(), chunk, chunk + bytes / sizeof(AdsrTraceRecord));
+        pending = bytes % sizeof(AdsrTraceRecord);
+        if (bytes < sizeof(chunk))
+            break;
+    }
+    return pending == 0 && !ferror(file);
+}
+
+// External curve table (adsrCurve*Table()) for the hash recorded with it,
+// nullptr when unknown. E.g. regenerate the registry the sketch used and
+// search it with adsrTraceHash() over ARRAY_SIZE entries.
+typedef const adsr_curve_t *(*AdsrTraceTableResolver)(uint32_t hash);
+
+enum AdsrTraceResult
+{
+    ADSR_TRACE_MATCH = 0,       // every output, block and keyframe equal
+    ADSR_TRACE_DIVERGED,        // see divergence()
+    ADSR_TRACE_NO_KEYFRAME,     // no complete keyframe to start from
+    ADSR_TRACE_UNRESOLVED_TABLE, // external table without resolver match
+    ADSR_TRACE_BAD_RECORD       // unknown or misplaced record (see divergence().record)
+};
+
+// First difference between a trace and its replay
+struct AdsrTraceDivergence
+{
+    size_t record = 0;          // index into the records given to run()
+    uint8_t op = 0;             // AdsrTraceOp of that record (a keyframe's differing record)
+    uint32_t tick = 0;          // its tick (low 32 bits)
+    uint32_t expected = 0;      // recorded output, block hash or keyframe field
+    uint32_t actual = 0;        // the same from the replay
+};
+
+// Runs a trace against the adsr of this build: restores the first complete
+// keyframe, then repeats every recorded call with its tick and compares the
+// outputs (getWave(), tick()), block hashes (renderBlock() etc.) and later
+// keyframes. Replaying with a modified build or config shows where its
+// output or state first moves away from the recording; the divergence's
+// tick and record index narrow the search for the change that caused it.
+class AdsrTraceReplay
+{
+public:
+    explicit AdsrTraceReplay(AdsrTraceTableResolver resolve = nullptr)
+        : _resolve(resolve), _env(4095, 0.0f, 0.0f, true, 0, 0, 0)
+    {
+    }
+
+    AdsrTraceResult run(const AdsrTraceRecord *records, size_t count)
+    {
+        _divergence = AdsrTraceDivergence();
+        _start = 0;
+        _replayed = 0;
+        _samples = 0;
+
+        size_t begin = 0;
+        size_t end = 0;
+        for (; begin < count; ++begin)
+        {
+            if (records[begin].op == ADSR_TRACE_KEY_BEGIN && _keyframeEnd(records, count, begin, end))
+                break;
+        }
+        if (begin == count)
+            return ADSR_TRACE_NO_KEYFRAME;
+
+        _start = begin;
+        AdsrTraceResult result = _restore(records, begin, end);
+        if (result != ADSR_TRACE_MATCH)
+            return result;
+        result = _compareKeyframe(records, begin, end);
+        if (result != ADSR_TRACE_MATCH)
+            return result;
+
+        unsigned long now = records[begin].tick;
+        uint64_t pending_scale = 0;
+        size_t i = end + 1;
+        _replayed = i - begin;
+        while (i < count)
+        {
+            const AdsrTraceRecord &r = records[i];
+            size_t next = i + 1;
+            switch (r.op)
+            {
+            case ADSR_TRACE_NOTE_ON:
+                now = _unwrap(now, r.tick);
+                _env.noteOn(now);
+                break;
+
+            case ADSR_TRACE_NOTE_OFF:
+                now = _unwrap(now, r.tick);
+                _env.noteOff(now);
+                break;
+
+            case ADSR_TRACE_GET_WAVE:
+            {
+                now = _unwrap(now, r.tick);
+                uint32_t out = (uint32_t)_env.getWave(now);
+                _samples++;
+                if (out != r.a)
+                    return _diverged(i, r, r.a, out);
+                break;
+            }
+
+            case ADSR_TRACE_TICK:
+            {
+                uint32_t out = (uint32_t)_env.tick();
+                _samples++;
+                if (out != r.a)
+                    return _diverged(i, r, r.a, out);
+                break;
+            }
+
+            case ADSR_TRACE_BLOCK:
+            {
+                // One call: this record and the ones it continues into
+                size_t n = r.n;
+                while (records[next - 1].sub & ADSR_TRACE_BLOCK_MORE)
+                {
+                    if (next == count || records[next].op != ADSR_TRACE_BLOCK)
+                        return _badRecord(next - 1, records[next - 1]);
+                    n += records[next++].n;
+                }
+                if (n == 0)
+                    return _badRecord(i, r);
+
+                unsigned long step = r.a;
+                unsigned long start = _unwrap(now, r.tick);
+                unsigned shift = r.sub & (ADSR_TRACE_BLOCK_MORE - 1);
+                _block.resize(n);
+                if (shift == 0)
+                    _env.renderBlock(_block.data(), n, start, step);
+                else
+                    _env.renderBlockDecimated(_block.data(), n, start, step, 1U << shift);
+                _samples += n;
+                now = start + (unsigned long)(n - 1) * step;
+
+                size_t offset = 0;
+                for (size_t j = i; j < next; ++j)
+                {
+                    uint32_t h = ADSR_TRACE_HASH_INIT;
+                    for (size_t s = 0; s < records[j].n; ++s)
+                        h = adsrTraceHash(h, (uint32_t)_block[offset + s]);
+                    offset += records[j].n;
+                    if (h != records[j].b)
+                        return _diverged(j, records[j], records[j].b, h);
+                }
+                break;
+            }
+
+            case ADSR_TRACE_STAGE_SCALE:
+                pending_scale = (uint64_t)r.a | ((uint64_t)r.b << 32);
+                break;
+
+            case ADSR_TRACE_STAGE:
+                if (!_setStage(r, pending_scale, _unwrap(now, r.tick)))
+                    return _badRecord(i, r);
+                break;
+
+            case ADSR_TRACE_SUSTAIN:
+                _env.setSustain((int)r.a);
+                break;
+
+            case ADSR_TRACE_CURVE:
+            case ADSR_TRACE_MORPH:
+            {
+                AdsrTraceResult curve = _setCurve(r);
+                if (curve != ADSR_TRACE_MATCH)
+                    return _failed(i, r, curve);
+                break;
+            }
+
+            case ADSR_TRACE_RESET_ATTACK:
+                _env.setResetAttack(r.sub != 0);
+                break;
+
+            case ADSR_TRACE_TICK_RATE:
+                _env.setTickRate(r.a);
+                break;
+
+            case ADSR_TRACE_KEY_BEGIN:
+            {
+                size_t key_end;
+                if (!_keyframeEnd(records, count, i, key_end))
+                {
+                    // Cut off at the end of the trace
+                    _replayed = count - begin;
+                    return ADSR_TRACE_MATCH;
+                }
+                result = _compareKeyframe(records, i, key_end);
+                if (result != ADSR_TRACE_MATCH)
+                    return result;
+                next = key_end + 1;
+                break;
+            }
+
+            default:
+                return _badRecord(i, r);
+            }
+
+            _replayed += next - i;
+            i = next;
+        }
+        return ADSR_TRACE_MATCH;
+    }
+
+    AdsrTraceResult run(const std::vector<AdsrTraceRecord> &records)
+    {
+        return run(records.data(), records.size());
+    }
+
+    // Details of the last run() that did not match
+    const AdsrTraceDivergence &divergence() const { return _divergence; }
+
+    // Index of the keyframe the last run() started from, records replayed
+    // from it (up to and including a divergence) and samples rendered
+    size_t start() const { return _start; }
+    size_t replayed() const { return _replayed; }
+    unsigned long long samples() const { return _samples; }
+
+    // The replayed envelope, in the state after the last replayed record
+    const adsr &envelope() const { return _env; }
+
+private:
+    // Capture of a keyframe of the replayed envelope
+    class Capture : public AdsrTraceSink
+    {
+    public:
+        void write(const AdsrTraceRecord &record) override
+        {
+            records.push_back(record);
+        }
+
+        std::vector<AdsrTraceRecord> records;
+    };
+
+    // A tick near the previous one from its low 32 bits (within 2^31 ticks)
+    static unsigned long _unwrap(unsigned long near, uint32_t tick)
+    {
+        return near + (unsigned long)(long)(int32_t)(tick - (uint32_t)near);
+    }
+
+    static bool _keyframeEnd(const AdsrTraceRecord *records, size_t count, size_t begin, size_t &end)
+    {
+        for (end = begin + 1; end < count; ++end)
+        {
+            if (records[end].op == ADSR_TRACE_KEY_END)
+                return true;
+            if (records[end].op == ADSR_TRACE_KEY_BEGIN)
+                return false;
+        }
+        return false;
+    }
+
+    AdsrTraceResult _diverged(size_t index, const AdsrTraceRecord &r, uint32_t expected, uint32_t actual)
+    {
+        return _failed(index, r, ADSR_TRACE_DIVERGED, expected, actual);
+    }
+
+    AdsrTraceResult _badRecord(size_t index, const AdsrTraceRecord &r)
+    {
+        return _failed(index, r, ADSR_TRACE_BAD_RECORD);
+    }
+
+    AdsrTraceResult _failed(size_t index, const AdsrTraceRecord &r, AdsrTraceResult result,
+                            uint32_t expected = 0, uint32_t actual = 0)
+    {
+        _divergence.record = index;
+        _divergence.op = r.op;
+        _divergence.tick = r.tick;
+        _divergence.expected = expected;
+        _divergence.actual = actual;
+        _replayed = index + 1 - _start;
+        return result;
+    }
+
+    // Stage time through the private setters (the scale of the public ones
+    // or, after a STAGE_SCALE record, a mod*() table's)
+    bool _setStage(const AdsrTraceRecord &r, uint64_t pending_scale, unsigned long now)
+    {
+        unsigned long ticks = r.a;
+        uint64_t scale = r.n != 0 ? pending_scale : adsrStageScale(ticks);
+        switch (r.sub)
+        {
+        case adsr::ADSR_PHASE_ATTACK:
+            _env._setAttackTicks(ticks, scale, now);
+            return true;
+        case adsr::ADSR_PHASE_DECAY:
+            _env._setDecayTicks(ticks, scale, now);
+            return true;
+        case adsr::ADSR_PHASE_RELEASE:
+            _env._setReleaseTicks(ticks, scale, now);
+            return true;
+        default:
+            return false;
+        }
+    }
+
+    AdsrTraceResult _setCurve(const AdsrTraceRecord &r)
+    {
+        const adsr_curve_t **tables;
+        int32_t *morph;
+        switch (r.sub)
+        {
+        case adsr::ADSR_PHASE_ATTACK:
+            tables = r.n == 0 ? &_env._attack_table : &_env._attack_table_b;
+            morph = &_env._attack_morph;
+            break;
+        case adsr::ADSR_PHASE_DECAY:
+            tables = r.n == 0 ? &_env._decay_table : &_env._decay_table_b;
+            morph = &_env._decay_morph;
+            break;
+        case adsr::ADSR_PHASE_RELEASE:
+            tables = r.n == 0 ? &_env._release_table : &_env._release_table_b;
+            morph = &_env._release_morph;
+            break;
+        default:
+            return ADSR_TRACE_BAD_RECORD;
+        }
+
+        if (r.op == ADSR_TRACE_MORPH)
+        {
+            *morph = (int32_t)r.a;
+            return ADSR_TRACE_MATCH;
+        }
+        if (r.n > 1)
+            return ADSR_TRACE_BAD_RECORD;
+
+        if (r.a == ADSR_TRACE_TABLE_NONE)
+            *tables = nullptr;
+        else if (r.a == ADSR_TRACE_TABLE_EXTERNAL)
+        {
+            const adsr_curve_t *table = _resolve != nullptr ? _resolve(r.b) : nullptr;
+            if (table == nullptr)
+                return ADSR_TRACE_UNRESOLVED_TABLE;
+            *tables = table;
+        }
+#if !ADSR_BEZIER_EXP_ONLY
+        else if (r.a < 8)
+            *tables = _curve_tables[r.a];
+#endif
+        else
+            return ADSR_TRACE_BAD_RECORD;
+        return ADSR_TRACE_MATCH;
+    }
+
+    // New envelope from the keyframe records[begin..end]: settings through
+    // the setters, then the running state
+    AdsrTraceResult _restore(const AdsrTraceRecord *records, size_t begin, size_t end)
+    {
+        const AdsrTraceRecord &key = records[begin];
+        const unsigned long base = key.tick;
+        _env = adsr((int)key.a, 0.0f, 0.0f, true, 0, 0, 0, key.sub != 0);
+        _env._t_last = base;
+
+        // KEY_EXP first: the stage setters compute the exponential coefficients from it
+        uint64_t pending_scale = 0;
+        for (size_t i = begin + 1; i < end; ++i)
+        {
+            const AdsrTraceRecord &r = records[i];
+            switch (r.op)
+            {
+            case ADSR_TRACE_KEY_EXP:
+                memcpy(&_env._exp_attack_curve, &r.a, sizeof(r.a));
+                memcpy(&_env._exp_decay_release_curve, &r.b, sizeof(r.b));
+                break;
+            case ADSR_TRACE_TICK_RATE:
+                _env.setTickRate(r.a);
+                break;
+            case ADSR_TRACE_SUSTAIN:
+                // Direct: the decay range stays 0 until the first setSustain()
+                _env._sustain = (int)r.a;
+                _env._decay_range_scale_q16 = (int32_t)r.b;
+                break;
+            case ADSR_TRACE_RESET_ATTACK:
+                _env.setResetAttack(r.sub != 0);
+                break;
+            case ADSR_TRACE_STAGE_SCALE:
+                pending_scale = (uint64_t)r.a | ((uint64_t)r.b << 32);
+                break;
+            case ADSR_TRACE_STAGE:
+                if (!_setStage(r, pending_scale, base))
+                    return _badRecord(i, r);
+                break;
+            case ADSR_TRACE_CURVE:
+            case ADSR_TRACE_MORPH:
+            {
+                AdsrTraceResult curve = _setCurve(r);
+                if (curve != ADSR_TRACE_MATCH)
+                    return _failed(i, r, curve);
+                break;
+            }
+            case ADSR_TRACE_KEY_STATE:
+                _env._phase = (adsr::ADSRPhase)r.sub;
+                _env._t_phase_start = _unwrap(base, r.tick);
+                _env._adsr_output = (int)r.a;
+                _env._notes_pressed = (int)r.b;
+                break;
+            case ADSR_TRACE_KEY_LEVELS:
+                _env._attack_start = (int)r.a;
+                _env._release_start = (int)r.b;
+                break;
+            case ADSR_TRACE_KEY_TICK_ACC:
+                _env._tick_acc = (uint64_t)r.a | ((uint64_t)r.b << 32);
+                _env._tick_stage_end = r.sub != 0;
+                break;
+            case ADSR_TRACE_KEY_EXP_STATE:
+                _env._exp_next = _unwrap(base, r.tick);
+                _env._exp_u = (int32_t)r.a;
+                break;
+            default:
+                return _badRecord(i, r);
+            }
+        }
+
+        // Output ranges as noteOn() / noteOff() computed them
+        const int vres = _env._vertical_resolution;
+        _env._attack_range_scale_q16 = adsrRangeScaleQ16((int32_t)vres - (int32_t)_env._attack_start, vres, _env._vres_recip);
+        int32_t rs = (int32_t)_env._release_start;
+        if (rs > vres)
+            rs = vres;
+        _env._release_range_scale_q16 = adsrRangeScaleQ16(rs, vres, _env._vres_recip);
+        return ADSR_TRACE_MATCH;
+    }
+
+    // Keyframe of the replayed envelope against records[begin..end]
+    AdsrTraceResult _compareKeyframe(const AdsrTraceRecord *records, size_t begin, size_t end)
+    {
+        Capture capture;
+        capture.records.reserve(end - begin + 1);
+        _env._traceKeyframe(capture);
+
+        for (size_t i = 0; i < capture.records.size(); ++i)
+        {
+            if (begin + i > end)
+                return _diverged(end, records[end], ADSR_TRACE_KEY_END, capture.records[i].op);
+
+            const AdsrTraceRecord &want = records[begin + i];
+            const AdsrTraceRecord &got = capture.records[i];
+            if (want.op != got.op)
+                return _diverged(begin + i, want, want.op, got.op);
+            if (want.a != got.a)
+                return _diverged(begin + i, want, want.a, got.a);
+            if (want.b != got.b)
+                return _diverged(begin + i, want, want.b, got.b);
+            if (want.tick != got.tick)
+                return _diverged(begin + i, want, want.tick, got.tick);
+            if (want.sub != got.sub || want.n != got.n)
+                return _diverged(begin + i, want, ((uint32_t)want.n << 8) | want.sub, ((uint32_t)got.n << 8) | got.sub);
+        }
+        if (begin + capture.records.size() != end + 1)
+            return _diverged(begin + capture.records.size(), records[begin + capture.records.size()],
+                             records[begin + capture.records.size()].op, ADSR_TRACE_KEY_END);
+        return ADSR_TRACE_MATCH;
+    }
+
+    AdsrTraceTableResolver _resolve;
+    adsr _env;
+    std::vector<int> _block;
+    AdsrTraceDivergence _divergence;
+    size_t _start = 0;
+    size_t _replayed = 0;
+    unsigned long long _samples = 0;
+};
+
+#endif // !ARDUINO
+
+#endif
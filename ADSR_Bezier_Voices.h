@@ -0,0 +1,296 @@
+//----------------------------------//
+// Polyphonic voice allocation
+// O(1) note -> voice assignment over a pool of adsr envelopes, stealing the
+// quietest releasing voice when the pool is full
+//----------------------------------//
+
+#ifndef ADSR_VOICES
+#define ADSR_VOICES
+
+#include "ADSR_Bezier.h"
+
+// How a voice restarts when it gets a new note (stolen, or the same note again)
+enum AdsrVoicePolicy : uint8_t
+{
+    ADSR_VOICE_RETRIGGER = 0, // attack from 0 (setResetAttack(true))
+    ADSR_VOICE_LEGATO         // attack from the current level (setResetAttack(false))
+};
+
+// Assigns MIDI notes (0..127) to N adsr voices. Every voice is on exactly one
+// intrusive list:
+//   free       idle voices, reused least recently freed first
+//   held       note on, reused (stolen) oldest first when nothing else is left
+//   releasing  note off, sorted into Buckets level buckets by the voice's
+//              tracked envelope level
+// A bitmask of non-empty buckets finds the quietest releasing voice with one
+// count-trailing-zeros, so noteOn(), noteOff() and the level tracking are
+// O(1) for any N: the cost is the same at 8 or 512 voices.
+//
+// Levels are tracked through getWave() / renderBlock() here (or track() when
+// the voice is rendered elsewhere). A releasing voice that reaches idle moves
+// back to the free list. Voices within one bucket are stolen oldest first,
+// so the choice is exact up to vertical_resolution / Buckets.
+template <size_t N, size_t Buckets = 16>
+class AdsrVoiceAllocator
+{
+public:
+    static_assert(N >= 1 && N < 0xFFFF, "N must be 1..65534");
+    static_assert(Buckets >= 1 && Buckets <= 32 && (Buckets & (Buckets - 1)) == 0, "Buckets must be a power of two up to 32");
+
+    static constexpr int NOTES = 128;
+
+    // voices: N envelopes (not owned), all with the given vertical resolution
+    AdsrVoiceAllocator(adsr *const *voices, int vertical_resolution, AdsrVoicePolicy policy = ADSR_VOICE_RETRIGGER)
+    {
+        _level_shift = 0;
+        while ((vertical_resolution >> _level_shift) >= (int)Buckets)
+            _level_shift++;
+
+        for (size_t l = 0; l < LISTS; ++l)
+        {
+            _head[l] = NONE;
+            _tail[l] = NONE;
+            _count[l] = 0;
+        }
+        _bucket_mask = 0;
+        _releasing = 0;
+        _steals = 0;
+        for (int n = 0; n < NOTES; ++n)
+            _note_voice[n] = NONE;
+
+        for (size_t v = 0; v < N; ++v)
+        {
+            _voices[v] = voices[v];
+            _note[v] = NO_NOTE;
+            _level[v] = 0;
+            _list[v] = LIST_FREE;
+            _push((uint16_t)v, LIST_FREE);
+        }
+        setPolicy(policy);
+    }
+
+    void setPolicy(AdsrVoicePolicy policy)
+    {
+        _policy = policy;
+        for (size_t v = 0; v < N; ++v)
+            _voices[v]->setResetAttack(policy == ADSR_VOICE_RETRIGGER);
+    }
+
+    AdsrVoicePolicy policy() const { return _policy; }
+
+    // Start note on a voice and return its index. A note that is still held
+    // or releasing restarts on its own voice; otherwise a free voice is used,
+    // then the quietest releasing one, then the oldest held one.
+    int noteOn(uint8_t note, unsigned long now)
+    {
+        if (note >= NOTES)
+            return -1;
+
+        uint16_t v = _note_voice[note];
+        if (v == NONE)
+        {
+            v = _take();
+            if (_note[v] != NO_NOTE)
+                _note_voice[_note[v]] = NONE;
+            _note[v] = note;
+            _note_voice[note] = v;
+        }
+        else
+        {
+            _unlink(v);
+        }
+
+        // One note per voice: a held voice is released first so its pressed-note count stays at one
+        if (_list[v] == LIST_HELD)
+            _voices[v]->noteOff(now);
+        _voices[v]->noteOn(now);
+        _push(v, LIST_HELD);
+        return (int)v;
+    }
+
+    // Release note; returns its voice, or -1 if the note is not held
+    int noteOff(uint8_t note, unsigned long now)
+    {
+        if (note >= NOTES)
+            return -1;
+        uint16_t v = _note_voice[note];
+        if (v == NONE || _list[v] != LIST_HELD)
+            return -1;
+
+        _voices[v]->noteOff(now);
+        _unlink(v);
+        _push(v, _bucket(_level[v]));
+        return (int)v;
+    }
+
+    // Render one voice and track its level
+    int getWave(size_t voice, unsigned long now)
+    {
+        int level = _voices[voice]->getWave(now);
+        track(voice, level);
+        return level;
+    }
+
+    void renderBlock(size_t voice, int *out, size_t n, unsigned long start_tick, unsigned long tick_step)
+    {
+        _voices[voice]->renderBlock(out, n, start_tick, tick_step);
+        if (n > 0)
+            track(voice, out[n - 1]);
+    }
+
+    // Level of a voice rendered elsewhere (e.g. AdsrRenderPool); call it after every block
+    void track(size_t voice, int level)
+    {
+        uint16_t v = (uint16_t)voice;
+        _level[v] = level;
+        uint8_t list = _list[v];
+        if (list < LIST_RELEASING)
+            return;
+
+        if (_voices[v]->getPhase() == adsr::ADSR_PHASE_IDLE)
+        {
+            // Release finished: the voice is free again
+            _unlink(v);
+            _note_voice[_note[v]] = NONE;
+            _note[v] = NO_NOTE;
+            _push(v, LIST_FREE);
+            return;
+        }
+
+        uint8_t bucket = _bucket(level);
+        if (bucket != list)
+        {
+            _unlink(v);
+            _push(v, bucket);
+        }
+    }
+
+    adsr &voice(size_t v) { return *_voices[v]; }
+
+    // Voice playing note (held or releasing), -1 if none
+    int voiceOf(uint8_t note) const
+    {
+        return (note < NOTES && _note_voice[note] != NONE) ? (int)_note_voice[note] : -1;
+    }
+
+    // Note of a voice, -1 when free
+    int noteOf(size_t voice) const
+    {
+        return _note[voice] == NO_NOTE ? -1 : (int)_note[voice];
+    }
+
+    bool isHeld(size_t voice) const { return _list[voice] == LIST_HELD; }
+    bool isReleasing(size_t voice) const { return _list[voice] >= LIST_RELEASING; }
+
+    size_t freeCount() const { return _count[LIST_FREE]; }
+    size_t heldCount() const { return _count[LIST_HELD]; }
+    size_t releasingCount() const { return _releasing; }
+
+    // Voices taken from another note so far (releasing or held)
+    uint32_t steals() const { return _steals; }
+
+    static constexpr size_t size() { return N; }
+
+private:
+    static constexpr uint16_t NONE = 0xFFFF;
+    static constexpr uint8_t NO_NOTE = 0xFF;
+
+    // List ids: free, held, then one per level bucket (quietest first)
+    static constexpr uint8_t LIST_FREE = 0;
+    static constexpr uint8_t LIST_HELD = 1;
+    static constexpr uint8_t LIST_RELEASING = 2;
+    static constexpr size_t LISTS = LIST_RELEASING + Buckets;
+
+    uint8_t _bucket(int level) const
+    {
+        if (level < 0)
+            level = 0;
+        uint32_t b = (uint32_t)level >> _level_shift;
+        if (b >= Buckets)
+            b = Buckets - 1;
+        return (uint8_t)(LIST_RELEASING + b);
+    }
+
+    // Voice for a new note: free, else quietest releasing, else oldest held
+    uint16_t _take()
+    {
+        uint16_t v;
+        if (_count[LIST_FREE] != 0)
+        {
+            v = _tail[LIST_FREE];
+        }
+        else if (_bucket_mask != 0)
+        {
+            v = _tail[LIST_RELEASING + __builtin_ctz(_bucket_mask)];
+            _steals++;
+        }
+        else
+        {
+            v = _tail[LIST_HELD];
+            _steals++;
+        }
+        _unlink(v);
+        return v;
+    }
+
+    // Insert at the head (newest) of a list
+    void _push(uint16_t v, uint8_t list)
+    {
+        _list[v] = list;
+        _prev[v] = NONE;
+        _next[v] = _head[list];
+        if (_head[list] != NONE)
+            _prev[_head[list]] = v;
+        else
+            _tail[list] = v;
+        _head[list] = v;
+        _count[list]++;
+        if (list >= LIST_RELEASING)
+        {
+            _bucket_mask |= (uint32_t)1 << (list - LIST_RELEASING);
+            _releasing++;
+        }
+    }
+
+    void _unlink(uint16_t v)
+    {
+        uint8_t list = _list[v];
+        if (_prev[v] != NONE)
+            _next[_prev[v]] = _next[v];
+        else
+            _head[list] = _next[v];
+        if (_next[v] != NONE)
+            _prev[_next[v]] = _prev[v];
+        else
+            _tail[list] = _prev[v];
+        _count[list]--;
+        if (list >= LIST_RELEASING)
+        {
+            if (_count[list] == 0)
+                _bucket_mask &= ~((uint32_t)1 << (list - LIST_RELEASING));
+            _releasing--;
+        }
+    }
+
+    adsr *_voices[N];
+    AdsrVoicePolicy _policy;
+    unsigned _level_shift;
+
+    // Per voice: list links, current list, note, tracked level
+    uint16_t _next[N];
+    uint16_t _prev[N];
+    uint8_t _list[N];
+    uint8_t _note[N];
+    int _level[N];
+
+    uint16_t _head[LISTS];
+    uint16_t _tail[LISTS];
+    uint16_t _count[LISTS];
+    uint32_t _bucket_mask;                 // bit b: releasing bucket b is not empty
+    size_t _releasing;
+    uint32_t _steals;
+
+    uint16_t _note_voice[NOTES];
+};
+
+#endif
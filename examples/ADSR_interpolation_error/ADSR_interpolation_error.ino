@@ -0,0 +1,83 @@
+// --------------------------------------------------
+//
+// ADSR Bezier - table lookup error comparison
+//
+// Measures how far the table lookup used by getWave() is from the exact
+// Bézier curve, for truncated lookups (ADSR_BEZIER_INTERPOLATE 0) and
+// interpolated lookups (ADSR_BEZIER_INTERPOLATE 1) at several table sizes.
+//
+// Every curve is swept over a 2 s stage in 1 ms steps. The reference value
+// is the curve evaluated at the exact (fractional) time position; the
+// truncated lookup is emulated by dropping the fraction bits of the same
+// position, so both modes use the library's own adsrStagePosition() and
+// adsrCurveLookup().
+//
+// Output (one line per table size and mode, tab separated, errors in LSB of maxVal):
+// size  mode  max_error  rms_error  table_bytes
+//
+// --------------------------------------------------
+
+#define ADSR_BEZIER_INTERPOLATE 1
+#include <ADSR_Bezier.h>
+
+#define ERR_MAX_VALUE 4095.0f                       // maxVal passed to the generator
+#define ERR_STAGE_TICKS 2000000UL                   // 2 s stage (micros timebase)
+#define ERR_STEP_TICKS 1000UL                       // 1 ms steps
+
+void measure(int numPoints, bool interpolate)
+{
+  int *table = (int *)malloc(sizeof(int) * numPoints);
+  if (table == NULL)
+    return;
+
+  uint64_t scale = adsrStageScale(ERR_STAGE_TICKS, numPoints);
+  uint32_t frac_mask = interpolate ? 0 : ((1UL << ADSR_BEZIER_FRAC_BITS) - 1);
+  float max_error = 0.0f;
+  double sum_sq = 0.0;
+  long count = 0;
+
+  for (int curve = 0; curve < 8; curve++) {
+    adsrBezierInitCurveFast(curve, ERR_MAX_VALUE, numPoints, table);
+
+    ADSRBezierPoint A = {0.0f, ERR_MAX_VALUE};
+    ADSRBezierPoint B = {ERR_MAX_VALUE, 0.0f};
+
+    for (unsigned long delta = 0; delta < ERR_STAGE_TICKS; delta += ERR_STEP_TICKS) {
+      uint32_t pos = adsrStagePosition(delta, ERR_STAGE_TICKS, scale, numPoints) & ~frac_mask;
+      int value = adsrCurveLookup(table, pos, numPoints);
+
+      float xTarget = (ERR_MAX_VALUE + 1.0f) * (float)delta / (float)ERR_STAGE_TICKS;
+      float reference = adsrBezierFindYForX(A, adsrBezierControlP1(curve), adsrBezierControlP2(curve), B, xTarget, 1e-6f);
+
+      float error = fabsf((float)value - reference);
+      if (error > max_error)
+        max_error = error;
+      sum_sq += (double)error * (double)error;
+      count++;
+    }
+  }
+
+  Serial.print(numPoints);
+  Serial.print(interpolate ? "\tinterpolated\t" : "\ttruncated\t");
+  Serial.print(max_error, 2);
+  Serial.print("\t");
+  Serial.print((float)sqrt(sum_sq / (double)count), 2);
+  Serial.print("\t");
+  Serial.println((long)(8 * numPoints * sizeof(int)));
+
+  free(table);
+}
+
+void setup() {
+  Serial.begin(115200);
+  delay(2000);
+
+  Serial.println("size\tmode\tmax_error\trms_error\ttable_bytes");
+  for (int numPoints = 64; numPoints <= 1024; numPoints *= 2) {
+    measure(numPoints, false);
+    measure(numPoints, true);
+  }
+}
+
+void loop() {
+}
@@ -0,0 +1,78 @@
+// --------------------------------------------------
+//
+// ADSR Bezier - table element type lookup benchmark
+//
+// Times the per-sample lookup done by getWave() (time->position, table read,
+// Q16 range mapping) on int, uint16_t and uint8_t curve tables, so the effect
+// of ADSR_BEZIER_TABLE_T can be checked on the target board. Each pass sweeps
+// all 8 curves over a stage, like 8 voices running their decay.
+//
+// Output (one line per element type, tab separated):
+// type  table_bytes  ns_per_lookup  checksum
+//
+// --------------------------------------------------
+
+#define ADSR_BEZIER_SCALE_CONTROL_POINTS 1          // keep the curve shapes in the 255 tables
+#include <ADSR_Bezier.h>
+
+#define BENCH_POINTS ARRAY_SIZE
+#define BENCH_STAGE_TICKS 100000UL                  // 100 ms stage (micros timebase)
+#define BENCH_LOOKUPS 200000L                       // lookups per element type
+
+int table_int[8][BENCH_POINTS];
+uint16_t table_u16[8][BENCH_POINTS];
+uint8_t table_u8[8][BENCH_POINTS];
+
+template <typename T>
+void benchmarkType(const char *name, T (&tables)[8][BENCH_POINTS], int maxVal)
+{
+  uint64_t scale = adsrStageScale(BENCH_STAGE_TICKS, BENCH_POINTS);
+  int32_t range_scale_q16 = (int32_t)(((int32_t)(maxVal / 2) << 16) / maxVal);
+  unsigned long step = BENCH_STAGE_TICKS / 997;     // walks the whole table in uneven steps
+  unsigned long delta = 0;
+  long checksum = 0;
+
+  unsigned long t0 = micros();
+  for (long i = 0; i < BENCH_LOOKUPS; i++) {
+    uint32_t pos = adsrStagePosition(delta, BENCH_STAGE_TICKS, scale, BENCH_POINTS);
+    int curveVal = adsrCurveLookup(tables[i & 7], pos, BENCH_POINTS);
+    checksum += maxVal / 2 + ((curveVal * range_scale_q16) >> 16);
+    delta += step;
+    if (delta >= BENCH_STAGE_TICKS)
+      delta -= BENCH_STAGE_TICKS;
+  }
+  unsigned long t1 = micros();
+
+  Serial.print(name);
+  Serial.print("\t");
+  Serial.print((long)sizeof(tables));
+  Serial.print("\t");
+  Serial.print((float)(t1 - t0) * 1000.0f / (float)BENCH_LOOKUPS, 2);
+  Serial.print("\t");
+  Serial.println(checksum);
+}
+
+void setup() {
+  Serial.begin(115200);
+  delay(2000);
+
+  int *p_int[8];
+  uint16_t *p_u16[8];
+  uint8_t *p_u8[8];
+  for (int j = 0; j < 8; j++) {
+    p_int[j] = table_int[j];
+    p_u16[j] = table_u16[j];
+    p_u8[j] = table_u8[j];
+  }
+  adsrBezierInitTablesFast(4095.0f, BENCH_POINTS, p_int);
+  adsrBezierInitTablesFast(4095.0f, BENCH_POINTS, p_u16);
+  adsrBezierInitTablesFast(255.0f, BENCH_POINTS, p_u8);
+
+  Serial.println("type\ttable_bytes\tns_per_lookup\tchecksum");
+  benchmarkType("int", table_int, 4095);
+  benchmarkType("uint16_t", table_u16, 4095);
+  benchmarkType("uint8_t", table_u8, 255);
+}
+
+void loop() {
+}
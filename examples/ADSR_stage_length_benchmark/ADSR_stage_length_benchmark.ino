@@ -0,0 +1,88 @@
+// --------------------------------------------------
+//
+// ADSR Bezier - stage length benchmark
+//
+// Times getWave(now) in the decay stage for stage lengths from 0.5 s to 60 s.
+// Stages up to ADSR_BEZIER_Q24_MAX_TICKS map time to the table with a Q24
+// scale, longer ones with a Q40 scale: both are one multiply and a shift, so
+// the cost should not depend on the length. For comparison the sketch also
+// times the 64-bit division the long stages used before (same positions),
+// which is what makes long stages slow on cores without a 64-bit divider
+// such as the RP2040. Both read the sketch's own copy of curve 2, so it also
+// builds with compile-time tables; with ADSR_BEZIER_EXP_ONLY the getWave
+// column times the exponential mode instead.
+//
+// Output (one line per stage length, tab separated):
+// stage_ms  scale  ns_per_getwave  ns_per_division_lookup  checksum
+//
+// --------------------------------------------------
+
+#include <ADSR_Bezier.h>
+
+#define BENCH_CALLS 100000L                          // getWave() calls per stage length
+
+adsr env(4000, 0, 0, true, 1, 2, 3);
+adsr_curve_t decay_table[ARRAY_SIZE];
+
+void benchmarkStage(unsigned long stage_ms)
+{
+  unsigned long stage = (unsigned long)((uint64_t)ADSR_BEZIER_Q24_MAX_TICKS * stage_ms / 2000);
+  unsigned long step = stage / BENCH_CALLS;
+  if (step == 0)
+    step = 1;
+
+  env.setAttack(0);
+  env.setDecay(stage_ms);
+  env.noteOn(0);
+  env.getWave(1);                                    // zero attack -> decay
+
+  // Library lookup
+  long checksum = 0;
+  unsigned long l_ticks = 1;
+  unsigned long t0 = micros();
+  for (long i = 0; i < BENCH_CALLS; i++) {
+    checksum += env.getWave(l_ticks);
+    l_ticks += step;
+    if (l_ticks >= stage)
+      l_ticks = 1;
+  }
+  unsigned long t1 = micros();
+
+  // Same positions through a 64-bit division
+  long checksum_div = 0;
+  unsigned long delta = 0;
+  unsigned long t2 = micros();
+  for (long i = 0; i < BENCH_CALLS; i++) {
+    uint32_t pos = (uint32_t)((((uint64_t)(ARRAY_SIZE - 1) * (uint64_t)delta) << ADSR_BEZIER_FRAC_BITS) / (uint64_t)stage);
+    checksum_div += adsrCurveLookup(decay_table, pos);
+    delta += step;
+    if (delta >= stage - 1)
+      delta = 0;
+  }
+  unsigned long t3 = micros();
+
+  Serial.print(stage_ms);
+  Serial.print(stage <= ADSR_BEZIER_Q24_MAX_TICKS ? "\tQ24\t" : "\tQ40\t");
+  Serial.print((float)(t1 - t0) * 1000.0f / (float)BENCH_CALLS, 2);
+  Serial.print("\t");
+  Serial.print((float)(t3 - t2) * 1000.0f / (float)BENCH_CALLS, 2);
+  Serial.print("\t");
+  Serial.println(checksum + checksum_div);
+}
+
+void setup() {
+  Serial.begin(115200);
+  delay(2000);
+
+  adsrBezierInitCurveFast(2, 4000.0f, ARRAY_SIZE, decay_table);
+  env.adsrCurveDecayTable(decay_table);
+
+  unsigned long lengths[] = {500, 1000, 2000, 5000, 10000, 20000, 60000};
+  Serial.println("stage_ms\tscale\tns_per_getwave\tns_per_division_lookup\tchecksum");
+  for (unsigned int k = 0; k < sizeof(lengths) / sizeof(lengths[0]); k++) {
+    benchmarkStage(lengths[k]);
+  }
+}
+
+void loop() {
+}
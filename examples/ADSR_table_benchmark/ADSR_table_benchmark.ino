@@ -0,0 +1,81 @@
+// --------------------------------------------------
+//
+// ADSR Bezier - curve table generation benchmark
+//
+// Compares the bisection generator used by adsrBezierInitTables() with the
+// monotonic sweep of adsrBezierInitCurveFast() for table sizes 256 to 16384.
+// For every size both generators build all 8 curves (one table at a time,
+// so only two tables of the largest size are ever allocated) and the sketch
+// prints the time per full set of 8 tables and the maximum difference
+// between the two results.
+//
+// Output (one line per size, tab separated):
+// size  bisection_us  fast_us  speedup  max_error
+//
+// --------------------------------------------------
+
+#include <ADSR_Bezier.h>
+
+#define BENCH_MAX_VALUE 4095.0f                     // maxVal passed to the generators
+
+void benchmarkSize(int numPoints)
+{
+  int *reference = (int *)malloc(sizeof(int) * numPoints);
+  int *fast = (int *)malloc(sizeof(int) * numPoints);
+  if (reference == NULL || fast == NULL) {
+    Serial.print(numPoints);
+    Serial.println("\tskipped (not enough RAM)");
+    free(reference);
+    free(fast);
+    return;
+  }
+
+  unsigned long t_bisection = 0;
+  unsigned long t_fast = 0;
+  int max_error = 0;
+
+  for (int curve = 0; curve < 8; curve++) {
+    unsigned long t0 = micros();
+    for (int i = 0; i < numPoints; i++) {
+      reference[i] = (int)roundf(adsrBezierCurveY(curve, BENCH_MAX_VALUE, numPoints, i));
+    }
+    unsigned long t1 = micros();
+    adsrBezierInitCurveFast(curve, BENCH_MAX_VALUE, numPoints, fast);
+    unsigned long t2 = micros();
+
+    t_bisection += t1 - t0;
+    t_fast += t2 - t1;
+
+    for (int i = 0; i < numPoints; i++) {
+      int error = abs(reference[i] - fast[i]);
+      if (error > max_error)
+        max_error = error;
+    }
+  }
+
+  Serial.print(numPoints);
+  Serial.print("\t");
+  Serial.print(t_bisection);
+  Serial.print("\t");
+  Serial.print(t_fast);
+  Serial.print("\t");
+  Serial.print((float)t_bisection / (float)t_fast, 1);
+  Serial.print("\t");
+  Serial.println(max_error);
+
+  free(reference);
+  free(fast);
+}
+
+void setup() {
+  Serial.begin(115200);
+  delay(2000);
+
+  Serial.println("size\tbisection_us\tfast_us\tspeedup\tmax_error");
+  for (int numPoints = 256; numPoints <= 16384; numPoints *= 2) {
+    benchmarkSize(numPoints);
+  }
+}
+
+void loop() {
+}
@@ -0,0 +1,820 @@
+// --------------------------------------------------
+//
+// ADSR Bezier - hot path and table generation microbenchmarks (host)
+//
+// Measures:
+//   getwave          ns per getWave(now) in each phase (attack, decay, sustain, release, idle)
+//   stage_mapping    ns per getWave(now) in decay for a stage below and above
+//                    ADSR_BEZIER_Q24_MAX_TICKS (Q24 vs Q40 scale)
+//   tick             ns per tick() (fixed-rate mode, 48 kHz) in attack, decay and release
+//   exponential      ns per getWave(now) and tick() in the table-free exponential mode
+//   render_block     ns per sample of renderBlock() over a whole note
+//   gain             ns per sample of a 128-sample VCA block over a whole note:
+//                    renderBlock() then a separate gain loop, vs applyBlock()
+//                    on int16_t, int32_t and float buffers
+//   decimation       ns per sample of renderBlockDecimated() at k = 1, 4, 16 and 64,
+//                    same notes as render_block
+//   decimation_error largest difference in LSB (at 4000) from renderBlock() at
+//                    k = 4, 16 and 64 over whole notes with every curve and
+//                    stages of 5, 50, 500 and 5000 ms, 48 kHz, 128-sample blocks
+//   segments         the getwave and render_block cases for the same envelope as an
+//                    AdsrSegmentEnvelope<4> (configureADSR())
+//   morph            decay getWave(now) and renderBlock() with every stage morphing
+//                    between two curves at 40 %
+//   note_on_off      ns per noteOn(now) + noteOff(now) pair
+//   voice_alloc      ns per AdsrVoiceAllocator noteOn + noteOff + track() with 8, 64
+//                    and 512 voices (the smaller pools steal on most notes)
+//   curve_swap       ns per AdsrCurveSwap::update() with nothing published, and per
+//                    publish() + update() + follow() for 64 voices (table not refilled)
+//   modulation       ns per stage time change during a running decay: setDecay(ms)
+//                    vs modDecay() from an AdsrTimeTable, and per setSustain()
+//   preset           ns per voice sample of renderBlock() in 16-sample blocks for 64,
+//                    4096 and 65536 voices: adsr objects vs AdsrVoiceState voices of
+//                    one AdsrPreset, and the bytes per voice of each
+//   init_tables      µs per set of 8 tables, bisection and fast generator, 256..16384 entries
+//   throughput       voice samples per second for 64 adsr objects and an AdsrBank<64>
+//
+// Every result is the best of REPEATS runs. Output is one record per line,
+// tab separated with a header (default) or JSON lines (--json):
+//   benchmark  case  value  unit
+//
+// Build (from the repository root):
+//   g++ -std=c++11 -O2 -I. extras/benchmarks/ADSR_microbench.cpp -o microbench
+//   ./microbench [--json]
+// Add -mavx2 to measure the SIMD bank kernel, and -D options (e.g.
+// -DARRAY_SIZE=512 -DADSR_BEZIER_INTERPOLATE=1) to compare configurations.
+//
+// --------------------------------------------------
+
+#include "ADSR_Bezier.h"
+#include "ADSR_Bezier_Bank.h"
+#include "ADSR_Bezier_CurveSwap.h"
+#include "ADSR_Bezier_Preset.h"
+#include "ADSR_Bezier_Segments.h"
+#include "ADSR_Bezier_Voices.h"
+#include <stdio.h>
+#include <string.h>
+#include <chrono>
+#include <vector>
+
+#define REPEATS 5
+#define CALLS 2000000UL                             // getWave() calls per run
+#define MAX_VALUE 4000
+
+static bool json = false;
+static volatile long sink;
+
+static void report(const char *benchmark, const char *name, double value, const char *unit)
+{
+    if (json)
+        printf("{\"benchmark\":\"%s\",\"case\":\"%s\",\"value\":%.3f,\"unit\":\"%s\"}\n", benchmark, name, value, unit);
+    else
+        printf("%s\t%s\t%.3f\t%s\n", benchmark, name, value, unit);
+}
+
+// Keeps the compiler from dropping stores to *p (GCC / Clang)
+static inline void escape(void *p)
+{
+    asm volatile("" : : "g"(p) : "memory");
+}
+
+static double seconds(std::chrono::steady_clock::time_point t0)
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+}
+
+static adsr makeEnvelope(unsigned long attack_ms, unsigned long decay_ms, unsigned long release_ms, bool exponential = false)
+{
+    adsr env(MAX_VALUE, 0.997f, 0.997f, true, 1, 2, 3, exponential);
+    env.setAttack(attack_ms);
+    env.setDecay(decay_ms);
+    env.setSustain(MAX_VALUE / 2);
+    env.setRelease(release_ms);
+    return env;
+}
+
+// ns per getWave() for CALLS calls at TICK_SLOTS timestamps spread evenly
+// over [from, from + span), cycled so any span (also in millis mode) works
+#define TICK_SLOTS 4096
+template <typename Env>
+static double timeGetWave(Env &env, unsigned long from, unsigned long span)
+{
+    static unsigned long ticks[TICK_SLOTS];
+    for (unsigned long i = 0; i < TICK_SLOTS; i++)
+        ticks[i] = from + (unsigned long)((unsigned long long)span * i / TICK_SLOTS);
+
+    double best = 1e30;
+    for (int r = 0; r < REPEATS; r++)
+    {
+        Env run = env;
+        long acc = 0;
+        auto t0 = std::chrono::steady_clock::now();
+        for (unsigned long i = 0; i < CALLS; i++)
+            acc += run.getWave(ticks[i & (TICK_SLOTS - 1)]);
+        double t = seconds(t0);
+        sink = acc;
+        if (t < best)
+            best = t;
+    }
+    return best * 1e9 / (double)CALLS;
+}
+
+static void benchGetWave()
+{
+    // Stage lengths in ticks of the compiled timebase; 1 s stages stay on the Q24 path
+    const unsigned long stage_ms = 1000;
+    const unsigned long stage = ADSR_BEZIER_Q24_MAX_TICKS / 2;
+
+    adsr env = makeEnvelope(stage_ms, stage_ms, stage_ms);
+    env.noteOn(0);
+    report("getwave", "attack", timeGetWave(env, 0, stage), "ns");
+
+    env.getWave(stage);
+    report("getwave", "decay", timeGetWave(env, stage, stage), "ns");
+
+    env.getWave(2 * stage);
+    report("getwave", "sustain", timeGetWave(env, 2 * stage, stage), "ns");
+
+    env.noteOff(3 * stage);
+    report("getwave", "release", timeGetWave(env, 3 * stage, stage), "ns");
+
+    env.getWave(4 * stage);
+    report("getwave", "idle", timeGetWave(env, 4 * stage, stage), "ns");
+}
+
+static void benchStageMapping()
+{
+    // Same decay curve, once below and once above the Q24 threshold
+    unsigned long short_ms = 1000;
+    unsigned long long_ms = 20000;
+    char name[32];
+
+    unsigned long lengths[2] = {short_ms, long_ms};
+    for (int k = 0; k < 2; k++)
+    {
+        adsr env = makeEnvelope(0, lengths[k], 100);
+        env.noteOn(0);
+        env.getWave(1);                            // attack of 0 -> decay
+        unsigned long stage = ADSR_BEZIER_Q24_MAX_TICKS / 2000 * lengths[k];
+        snprintf(name, sizeof(name), "decay_%lums", lengths[k]);
+        report("stage_mapping", name, timeGetWave(env, 1, stage - 2), "ns");
+    }
+}
+
+// ns per tick() while the stage runs (stages longer than CALLS calls)
+static double timeTick(adsr &env)
+{
+    double best = 1e30;
+    for (int r = 0; r < REPEATS; r++)
+    {
+        adsr run = env;
+        long acc = 0;
+        auto t0 = std::chrono::steady_clock::now();
+        for (unsigned long i = 0; i < CALLS; i++)
+            acc += run.tick();
+        double t = seconds(t0);
+        sink = acc;
+        if (t < best)
+            best = t;
+    }
+    return best * 1e9 / (double)CALLS;
+}
+
+static void benchTick()
+{
+    // 60 s stages at 48 kHz: 2.88M calls each
+    adsr env = makeEnvelope(60000, 60000, 60000);
+    env.setTickRate(48000);
+    env.noteOn(0);
+    report("tick", "attack", timeTick(env), "ns");
+
+    env = makeEnvelope(0, 60000, 60000);
+    env.setTickRate(48000);
+    env.noteOn(0);
+    env.tick();                                    // zero attack -> decay
+    report("tick", "decay", timeTick(env), "ns");
+
+    env.noteOff(0);
+    report("tick", "release", timeTick(env), "ns");
+}
+
+// ns per getWave() for CALLS calls at from, from + step, ... (stage longer than CALLS steps)
+static double timeGetWaveSteps(adsr &env, unsigned long from, unsigned long step)
+{
+    double best = 1e30;
+    for (int r = 0; r < REPEATS; r++)
+    {
+        adsr run = env;
+        long acc = 0;
+        unsigned long l_ticks = from;
+        auto t0 = std::chrono::steady_clock::now();
+        for (unsigned long i = 0; i < CALLS; i++, l_ticks += step)
+            acc += run.getWave(l_ticks);
+        double t = seconds(t0);
+        sink = acc;
+        if (t < best)
+            best = t;
+    }
+    return best * 1e9 / (double)CALLS;
+}
+
+static void benchExponential()
+{
+    // getWave() once per recurrence step; stages of 1.5x CALLS steps
+    const unsigned long step = ADSR_BEZIER_EXP_STEP_TICKS;
+    const unsigned long stage = CALLS * step / 2 * 3;
+    const unsigned long stage_ms = ADSR_BEZIER_USE_MICROS ? stage / 1000 : stage;
+
+    adsr env = makeEnvelope(stage_ms, stage_ms, stage_ms, true);
+    env.noteOn(0);
+    report("exponential", "getwave_attack", timeGetWaveSteps(env, 0, step), "ns");
+
+    env.getWave(stage);
+    report("exponential", "getwave_decay", timeGetWaveSteps(env, stage, step), "ns");
+
+    env.noteOff(3 * stage);
+    report("exponential", "getwave_release", timeGetWaveSteps(env, 3 * stage, step), "ns");
+
+    env = makeEnvelope(60000, 60000, 60000, true);
+    env.setTickRate(48000);
+    env.noteOn(0);
+    report("exponential", "tick_attack", timeTick(env), "ns");
+}
+
+// ns per sample of renderBlock() in 128-sample blocks, a note every 2000 blocks
+template <typename Env>
+static double timeRenderBlock(const Env &proto)
+{
+    const size_t block = 128;
+    const unsigned long step = ADSR_BEZIER_USE_MICROS ? 21 : 1;
+    std::vector<int> out(block);
+    size_t blocks = CALLS / block;
+
+    double best = 1e30;
+    for (int r = 0; r < REPEATS; r++)
+    {
+        Env env = proto;
+        unsigned long l_ticks = 0;
+        long acc = 0;
+        auto t0 = std::chrono::steady_clock::now();
+        for (size_t b = 0; b < blocks; b++)
+        {
+            if (b % 2000 == 0)
+                env.noteOn(l_ticks);
+            else if (b % 2000 == 1000)
+                env.noteOff(l_ticks);
+            env.renderBlock(out.data(), block, l_ticks, step);
+            acc += out[block - 1];
+            l_ticks += block * step;
+        }
+        double t = seconds(t0);
+        sink = acc;
+        if (t < best)
+            best = t;
+    }
+    return best * 1e9 / (double)(blocks * block);
+}
+
+static void benchRenderBlock()
+{
+    report("render_block", "block_128", timeRenderBlock(makeEnvelope(500, 500, 1000)), "ns");
+}
+
+// ns per sample of renderBlockDecimated(), same notes as timeRenderBlock()
+static double timeDecimated(unsigned k)
+{
+    const size_t block = 128;
+    const unsigned long step = ADSR_BEZIER_USE_MICROS ? 21 : 1;
+    std::vector<int> out(block);
+    size_t blocks = CALLS / block;
+
+    double best = 1e30;
+    for (int r = 0; r < REPEATS; r++)
+    {
+        adsr env = makeEnvelope(500, 500, 1000);
+        unsigned long l_ticks = 0;
+        long acc = 0;
+        auto t0 = std::chrono::steady_clock::now();
+        for (size_t b = 0; b < blocks; b++)
+        {
+            if (b % 2000 == 0)
+                env.noteOn(l_ticks);
+            else if (b % 2000 == 1000)
+                env.noteOff(l_ticks);
+            env.renderBlockDecimated(out.data(), block, l_ticks, step, k);
+            acc += out[block - 1];
+            l_ticks += block * step;
+        }
+        double t = seconds(t0);
+        sink = acc;
+        if (t < best)
+            best = t;
+    }
+    return best * 1e9 / (double)(blocks * block);
+}
+
+// Largest |renderBlockDecimated() - renderBlock()| over one note per curve:
+// attack, decay and release of stage_ms each, sustain at half level
+static int decimationError(unsigned k, unsigned long stage_ms)
+{
+    const size_t block = 128;
+    const unsigned long step = ADSR_BEZIER_USE_MICROS ? 21 : 1;
+    const unsigned long ms = ADSR_BEZIER_USE_MICROS ? 1000 : 1;
+    std::vector<int> exact(block), ramp(block);
+    int worst = 0;
+
+    for (int curve = 0; curve < 8; curve++)
+    {
+        adsr a = makeEnvelope(stage_ms, stage_ms, stage_ms);
+        a.adsrCurveAttack(curve);
+        a.adsrCurveDecay(curve);
+        a.adsrCurveRelease(curve);
+        adsr b = a;
+
+        unsigned long l_ticks = 0;
+        unsigned long off = (2 * stage_ms + stage_ms / 2) * ms;
+        unsigned long end = off + 2 * stage_ms * ms;
+        a.noteOn(l_ticks);
+        b.noteOn(l_ticks);
+        bool released = false;
+        for (; l_ticks < end; l_ticks += block * step)
+        {
+            if (!released && l_ticks >= off)
+            {
+                a.noteOff(l_ticks);
+                b.noteOff(l_ticks);
+                released = true;
+            }
+            a.renderBlock(exact.data(), block, l_ticks, step);
+            b.renderBlockDecimated(ramp.data(), block, l_ticks, step, k);
+            for (size_t i = 0; i < block; i++)
+            {
+                int d = ramp[i] > exact[i] ? ramp[i] - exact[i] : exact[i] - ramp[i];
+                if (d > worst)
+                    worst = d;
+            }
+        }
+    }
+    return worst;
+}
+
+static void benchDecimation()
+{
+    report("decimation", "k1", timeDecimated(1), "ns");
+    report("decimation", "k4", timeDecimated(4), "ns");
+    report("decimation", "k16", timeDecimated(16), "ns");
+    report("decimation", "k64", timeDecimated(64), "ns");
+
+    static const unsigned ks[] = {4, 16, 64};
+    static const unsigned long stages[] = {5, 50, 500, 5000};
+    char name[32];
+    for (size_t k = 0; k < sizeof(ks) / sizeof(ks[0]); k++)
+    {
+        for (size_t s = 0; s < sizeof(stages) / sizeof(stages[0]); s++)
+        {
+            snprintf(name, sizeof(name), "k%u_%lums", ks[k], stages[s]);
+            report("decimation_error", name, decimationError(ks[k], stages[s]), "lsb");
+        }
+    }
+}
+
+// ns per sample of enveloping a 128-sample signal block, same notes as timeRenderBlock()
+template <typename T>
+static double timeGain(bool fused)
+{
+    const size_t block = 128;
+    const unsigned long step = ADSR_BEZIER_USE_MICROS ? 21 : 1;
+    const uint32_t recip = adsrGainReciprocal(MAX_VALUE);
+    std::vector<T> buf(block);
+    std::vector<int> levels(block);
+    size_t blocks = CALLS / block;
+
+    double best = 1e30;
+    for (int r = 0; r < REPEATS; r++)
+    {
+        adsr env = makeEnvelope(500, 500, 1000);
+        unsigned long l_ticks = 0;
+        auto t0 = std::chrono::steady_clock::now();
+        for (size_t b = 0; b < blocks; b++)
+        {
+            if (b % 2000 == 0)
+                env.noteOn(l_ticks);
+            else if (b % 2000 == 1000)
+                env.noteOff(l_ticks);
+            for (size_t i = 0; i < block; i++)
+                buf[i] = (T)(1000 + (int)i);
+            if (fused)
+            {
+                env.applyBlock(buf.data(), block, l_ticks, step);
+            }
+            else
+            {
+                env.renderBlock(levels.data(), block, l_ticks, step);
+                for (size_t i = 0; i < block; i++)
+                    buf[i] = adsrGainSample(buf[i], adsrGainQ15(levels[i], recip));
+            }
+            escape(buf.data());
+            l_ticks += block * step;
+        }
+        double t = seconds(t0);
+        sink = (long)buf[block - 1];
+        if (t < best)
+            best = t;
+    }
+    return best * 1e9 / (double)(blocks * block);
+}
+
+static void benchGain()
+{
+    report("gain", "two_pass_i16", timeGain<int16_t>(false), "ns");
+    report("gain", "apply_i16", timeGain<int16_t>(true), "ns");
+    report("gain", "two_pass_i32", timeGain<int32_t>(false), "ns");
+    report("gain", "apply_i32", timeGain<int32_t>(true), "ns");
+    report("gain", "two_pass_f32", timeGain<float>(false), "ns");
+    report("gain", "apply_f32", timeGain<float>(true), "ns");
+}
+
+static void benchMorph()
+{
+    const unsigned long stage_ms = 1000;
+    const unsigned long stage = ADSR_BEZIER_Q24_MAX_TICKS / 2;
+
+    adsr env = makeEnvelope(stage_ms, stage_ms, stage_ms);
+    env.adsrCurveDecayMorph(2, 5, 26214);
+    env.noteOn(0);
+    env.getWave(stage);
+    report("morph", "getwave_decay", timeGetWave(env, stage, stage), "ns");
+
+    env = makeEnvelope(500, 500, 1000);
+    env.adsrCurveAttackMorph(1, 4, 26214);
+    env.adsrCurveDecayMorph(2, 5, 26214);
+    env.adsrCurveReleaseMorph(3, 6, 26214);
+    report("morph", "render_block_128", timeRenderBlock(env), "ns");
+}
+
+// makeEnvelope() as four segments
+static AdsrSegmentEnvelope<4> makeSegments(unsigned long attack_ms, unsigned long decay_ms, unsigned long release_ms)
+{
+    AdsrSegmentEnvelope<4> env(MAX_VALUE);
+    env.configureADSR(attack_ms, decay_ms, MAX_VALUE / 2, release_ms, 1, 2, 3);
+    return env;
+}
+
+static void benchSegments()
+{
+    // Same stages and timestamps as benchGetWave()
+    const unsigned long stage_ms = 1000;
+    const unsigned long stage = ADSR_BEZIER_Q24_MAX_TICKS / 2;
+
+    AdsrSegmentEnvelope<4> env = makeSegments(stage_ms, stage_ms, stage_ms);
+    env.noteOn(0);
+    report("segments", "attack", timeGetWave(env, 0, stage), "ns");
+
+    env.getWave(stage);
+    report("segments", "decay", timeGetWave(env, stage, stage), "ns");
+
+    env.getWave(2 * stage);
+    report("segments", "sustain", timeGetWave(env, 2 * stage, stage), "ns");
+
+    env.noteOff(3 * stage);
+    report("segments", "release", timeGetWave(env, 3 * stage, stage), "ns");
+
+    report("segments", "render_block_128", timeRenderBlock(makeSegments(500, 500, 1000)), "ns");
+}
+
+static void benchNoteOnOff()
+{
+    double best = 1e30;
+    for (int r = 0; r < REPEATS; r++)
+    {
+        adsr env = makeEnvelope(10, 10, 10);
+        unsigned long l_ticks = 0;
+        auto t0 = std::chrono::steady_clock::now();
+        for (unsigned long i = 0; i < CALLS; i++)
+        {
+            env.noteOn(l_ticks);
+            escape(&env);
+            env.noteOff(l_ticks + 1);
+            escape(&env);
+            l_ticks += 2;
+        }
+        double t = seconds(t0);
+        sink = env.getWave(l_ticks);
+        if (t < best)
+            best = t;
+    }
+    report("note_on_off", "pair", best * 1e9 / (double)CALLS, "ns");
+}
+
+// ns per call of set(env, i) for CALLS calls while a long decay runs
+template <typename Set>
+static double timeSetter(Set set)
+{
+    double best = 1e30;
+    for (int r = 0; r < REPEATS; r++)
+    {
+        adsr env = makeEnvelope(0, 1000, 1000);
+        env.noteOn(0);
+        env.getWave(1);                                // zero attack -> decay
+        auto t0 = std::chrono::steady_clock::now();
+        for (unsigned long i = 0; i < CALLS; i++)
+        {
+            set(env, i);
+            escape(&env);
+        }
+        double t = seconds(t0);
+        sink = env.getWave(2);
+        if (t < best)
+            best = t;
+    }
+    return best * 1e9 / (double)CALLS;
+}
+
+// Notes cycle through all 128 keys, four held at a time; every call also
+// tracks one voice at a falling level so the releasing buckets change
+template <size_t N>
+static double timeVoiceAlloc()
+{
+    std::vector<adsr> env(N, makeEnvelope(10, 10, 2000));
+    std::vector<adsr *> ptr;
+    for (size_t v = 0; v < N; v++)
+        ptr.push_back(&env[v]);
+
+    double best = 1e30;
+    for (int r = 0; r < REPEATS; r++)
+    {
+        AdsrVoiceAllocator<N> voices(ptr.data(), MAX_VALUE);
+        long acc = 0;
+        auto t0 = std::chrono::steady_clock::now();
+        for (unsigned long i = 0; i < CALLS; i++)
+        {
+            acc += voices.noteOn((uint8_t)((i * 37) & 127), i);
+            acc += voices.noteOff((uint8_t)(((i - 4) * 37) & 127), i);
+            voices.track((i * 13) % N, MAX_VALUE - (int)(i & 4095) % MAX_VALUE);
+        }
+        double t = seconds(t0);
+        sink = acc + (long)voices.steals();
+        if (t < best)
+            best = t;
+    }
+    return best * 1e9 / (double)CALLS;
+}
+
+static void benchVoiceAlloc()
+{
+    report("voice_alloc", "voices_8", timeVoiceAlloc<8>(), "ns");
+    report("voice_alloc", "voices_64", timeVoiceAlloc<64>(), "ns");
+    report("voice_alloc", "voices_512", timeVoiceAlloc<512>(), "ns");
+}
+
+static void benchCurveSwap()
+{
+    const size_t VOICES = 64;
+    static AdsrCurveSwap<> swap;
+    swap.publishBuiltin(1, (float)MAX_VALUE);
+    swap.update();
+
+    double best_idle = 1e30, best_swap = 1e30;
+    for (int r = 0; r < REPEATS; r++)
+    {
+        long acc = 0;
+        auto t0 = std::chrono::steady_clock::now();
+        for (unsigned long i = 0; i < CALLS; i++)
+            acc += swap.update();
+        double t = seconds(t0);
+        if (t < best_idle)
+            best_idle = t;
+
+        // Buffer exchange and voice hand-over only: the table is published as it was left
+        const adsr_curve_t *held[VOICES] = {};
+        t0 = std::chrono::steady_clock::now();
+        for (unsigned long i = 0; i < CALLS / VOICES; i++)
+        {
+            if (swap.beginUpdate() != nullptr)
+                swap.publish();
+            acc += swap.update();
+            for (size_t v = 0; v < VOICES; v++)
+                held[v] = swap.follow(held[v]);
+            escape(held);
+        }
+        t = seconds(t0);
+        if (t < best_swap)
+            best_swap = t;
+        for (size_t v = 0; v < VOICES; v++)
+            swap.release(held[v]);
+        sink = acc;
+    }
+    report("curve_swap", "update_idle", best_idle * 1e9 / (double)CALLS, "ns");
+    report("curve_swap", "swap_64", best_swap * 1e9 / (double)(CALLS / VOICES), "ns");
+}
+
+static void benchModulation()
+{
+    AdsrTimeTable<256> times(1.0f, 20000.0f);
+    report("modulation", "set_decay", timeSetter([](adsr &env, unsigned long i) { env.setDecay(1 + (i & 4095)); }), "ns");
+    report("modulation", "mod_decay", timeSetter([&](adsr &env, unsigned long i) { env.modDecay(times, (uint16_t)(i * 40503UL)); }), "ns");
+    report("modulation", "set_sustain", timeSetter([](adsr &env, unsigned long i) { env.setSustain((int)(i & 4095)); }), "ns");
+}
+
+static void benchInitTables()
+{
+    char name[32];
+    for (int numPoints = 256; numPoints <= 16384; numPoints *= 2)
+    {
+        std::vector<adsr_curve_t> storage((size_t)8 * numPoints);
+        adsr_curve_t *tables[8];
+        for (int j = 0; j < 8; j++)
+            tables[j] = storage.data() + (size_t)j * numPoints;
+
+        double best_bisection = 1e30;
+        double best_fast = 1e30;
+        for (int r = 0; r < REPEATS; r++)
+        {
+            auto t0 = std::chrono::steady_clock::now();
+            adsrBezierInitTables((float)MAX_VALUE, numPoints, tables);
+            double t = seconds(t0);
+            if (t < best_bisection)
+                best_bisection = t;
+
+            t0 = std::chrono::steady_clock::now();
+            adsrBezierInitTablesFast((float)MAX_VALUE, numPoints, tables);
+            t = seconds(t0);
+            if (t < best_fast)
+                best_fast = t;
+            sink = tables[7][numPoints / 2];
+        }
+
+        snprintf(name, sizeof(name), "bisection_%d", numPoints);
+        report("init_tables", name, best_bisection * 1e6, "us");
+        snprintf(name, sizeof(name), "fast_%d", numPoints);
+        report("init_tables", name, best_fast * 1e6, "us");
+    }
+}
+
+// 64 voices with staggered notes; returns voice samples per second
+template <typename Step>
+static double timeVoices(Step stepAll, size_t samples, unsigned long step)
+{
+    auto t0 = std::chrono::steady_clock::now();
+    unsigned long l_ticks = 0;
+    for (size_t i = 0; i < samples; i++)
+    {
+        stepAll(i, l_ticks);
+        l_ticks += step;
+    }
+    return (double)samples * 64.0 / seconds(t0);
+}
+
+static void benchThroughput()
+{
+    const unsigned long step = ADSR_BEZIER_USE_MICROS ? 21 : 1;
+    const size_t samples = CALLS / 16;
+
+    double best_objects = 0.0;
+    double best_bank = 0.0;
+    for (int r = 0; r < REPEATS; r++)
+    {
+        std::vector<adsr> voices;
+        AdsrBank<64> bank(MAX_VALUE, 1, 2, 3);
+        for (size_t v = 0; v < 64; v++)
+        {
+            voices.push_back(makeEnvelope(20 + v, 50 + v, 200 + 3 * v));
+            bank.setAttack(v, 20 + v);
+            bank.setDecay(v, 50 + v);
+            bank.setSustain(v, MAX_VALUE / 2);
+            bank.setRelease(v, 200 + 3 * v);
+        }
+
+        long acc = 0;
+        double vps = timeVoices([&](size_t i, unsigned long l_ticks) {
+            for (size_t v = 0; v < 64; v++)
+            {
+                size_t phase = (i + v * 97) % 24000;
+                if (phase == 0)
+                    voices[v].noteOn(l_ticks);
+                else if (phase == 12000)
+                    voices[v].noteOff(l_ticks);
+                acc += voices[v].getWave(l_ticks);
+            }
+        }, samples, step);
+        if (vps > best_objects)
+            best_objects = vps;
+
+        vps = timeVoices([&](size_t i, unsigned long l_ticks) {
+            for (size_t v = 0; v < 64; v++)
+            {
+                size_t phase = (i + v * 97) % 24000;
+                if (phase == 0)
+                    bank.noteOn(v, l_ticks);
+                else if (phase == 12000)
+                    bank.noteOff(v, l_ticks);
+            }
+            acc += bank.getWave(l_ticks)[0];
+        }, samples, step);
+        if (vps > best_bank)
+            best_bank = vps;
+        sink = acc;
+    }
+    report("throughput", "adsr_x64", best_objects, "voice_samples_per_s");
+    report("throughput", "bank_64", best_bank, "voice_samples_per_s");
+}
+
+// ns per voice sample for `voices` voices rendered in 16-sample blocks, one
+// note per voice every 1500 blocks (staggered), as adsr objects or preset voices
+static double timePreset(size_t voices, bool shared)
+{
+    const size_t block = 16;
+    const unsigned long step = ADSR_BEZIER_USE_MICROS ? 21 : 1;
+    const size_t blocks = CALLS * 4 / (block * voices) + 1;
+    std::vector<int> out(block);
+
+    AdsrPreset preset(MAX_VALUE, 1, 2, 3);
+    preset.setAttack(20);
+    preset.setDecay(50);
+    preset.setSustain(MAX_VALUE / 2);
+    preset.setRelease(200);
+    std::vector<AdsrVoiceState> states(voices);
+    std::vector<adsr> objects(voices, makeEnvelope(20, 50, 200));
+
+    double best = 1e30;
+    for (int r = 0; r < REPEATS; r++)
+    {
+        unsigned long l_ticks = 0;
+        long acc = 0;
+        auto t0 = std::chrono::steady_clock::now();
+        for (size_t b = 0; b < blocks; b++)
+        {
+            for (size_t v = 0; v < voices; v++)
+            {
+                size_t phase = (b + v * 7) % 1500;
+                if (shared)
+                {
+                    if (phase == 0)
+                        preset.noteOn(states[v], l_ticks);
+                    else if (phase == 750)
+                        preset.noteOff(states[v], l_ticks);
+                    preset.renderBlock(states[v], out.data(), block, l_ticks, step);
+                }
+                else
+                {
+                    if (phase == 0)
+                        objects[v].noteOn(l_ticks);
+                    else if (phase == 750)
+                        objects[v].noteOff(l_ticks);
+                    objects[v].renderBlock(out.data(), block, l_ticks, step);
+                }
+                acc += out[block - 1];
+            }
+            l_ticks += block * step;
+        }
+        double t = seconds(t0);
+        sink = acc;
+        if (t < best)
+            best = t;
+    }
+    return best * 1e9 / (double)(blocks * block * voices);
+}
+
+static void benchPreset()
+{
+    report("preset", "adsr_x64", timePreset(64, false), "ns");
+    report("preset", "preset_x64", timePreset(64, true), "ns");
+    report("preset", "adsr_x4096", timePreset(4096, false), "ns");
+    report("preset", "preset_x4096", timePreset(4096, true), "ns");
+    report("preset", "adsr_x65536", timePreset(65536, false), "ns");
+    report("preset", "preset_x65536", timePreset(65536, true), "ns");
+    report("preset", "adsr_bytes", (double)sizeof(adsr), "bytes");
+    report("preset", "state_bytes", (double)sizeof(AdsrVoiceState), "bytes");
+}
+
+int main(int argc, char **argv)
+{
+    for (int i = 1; i < argc; i++)
+        if (strcmp(argv[i], "--json") == 0)
+            json = true;
+
+#if !ADSR_BEZIER_CONSTEXPR_TABLES
+    // compile-time tables are built with ADSR_BEZIER_TABLE_MAX_VALUE instead
+    adsrBezierInitTablesFast((float)MAX_VALUE, ARRAY_SIZE, _curve_tables);
+#endif
+
+    if (!json)
+        printf("benchmark\tcase\tvalue\tunit\n");
+    benchGetWave();
+    benchStageMapping();
+    benchTick();
+    benchExponential();
+    benchRenderBlock();
+    benchGain();
+    benchDecimation();
+    benchSegments();
+    benchMorph();
+    benchNoteOnOff();
+    benchVoiceAlloc();
+    benchCurveSwap();
+    benchModulation();
+    benchPreset();
+    benchInitTables();
+    benchThroughput();
+    return 0;
+}
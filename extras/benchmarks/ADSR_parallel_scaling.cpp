@@ -0,0 +1,115 @@
+// --------------------------------------------------
+//
+// ADSR Bezier - multi-threaded rendering scaling (host)
+//
+// Renders VOICES adsr envelopes in 128-sample blocks with AdsrRenderPool at
+// 1..max threads, checks every run against a serial render (bit-identical
+// output required) and prints the throughput. Voices get staggered notes and
+// mixed stage lengths, so per-voice cost differs from block to block.
+//
+// Build (from the repository root):
+//   g++ -std=c++11 -O2 -pthread -I. extras/benchmarks/ADSR_parallel_scaling.cpp -o parallel_scaling
+//   ./parallel_scaling [max_threads]
+//
+// Output (one line per thread count, tab separated):
+// threads  ms_per_second_of_audio  voice_samples_per_sec  speedup  identical
+//
+// --------------------------------------------------
+
+#include "ADSR_Bezier_Parallel.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <vector>
+
+#define VOICES 512
+#define BLOCK 128
+#define TICK_STEP 21UL                              // ~48 kHz in micros mode
+#define BLOCKS 375                                  // 1 s of audio
+
+struct Voices
+{
+    std::vector<adsr *> env;
+
+    Voices()
+    {
+        srand(1);
+        for (int v = 0; v < VOICES; v++)
+        {
+            adsr *a = new adsr(4000, 0, 0, true, v % 8, (v / 8) % 8, (v / 64) % 8);
+            a->setAttack(1 + rand() % 200);
+            a->setDecay(1 + rand() % 400);
+            a->setSustain(rand() % 4000);
+            a->setRelease(1 + rand() % 3000);
+            env.push_back(a);
+        }
+    }
+
+    ~Voices()
+    {
+        for (size_t v = 0; v < env.size(); v++)
+            delete env[v];
+    }
+};
+
+// Renders BLOCKS blocks, retriggering voices in a fixed pattern; returns seconds
+static double run(AdsrRenderPool *pool, std::vector<int> &out)
+{
+    Voices voices;
+    std::vector<int> block((size_t)VOICES * BLOCK);
+    out.assign((size_t)VOICES * BLOCK * BLOCKS, 0);
+
+    double seconds = 0.0;
+    for (int b = 0; b < BLOCKS; b++)
+    {
+        unsigned long start = (unsigned long)b * BLOCK * TICK_STEP;
+        for (int v = b % 7; v < VOICES; v += 7)
+        {
+            if ((b / 7 + v) % 3 == 0)
+                voices.env[v]->noteOn(start);
+            else
+                voices.env[v]->noteOff(start);
+        }
+
+        auto t0 = std::chrono::steady_clock::now();
+        if (pool)
+            adsrRenderVoices(*pool, voices.env.data(), VOICES, block.data(), BLOCK, start, TICK_STEP);
+        else
+            for (int v = 0; v < VOICES; v++)
+                voices.env[v]->renderBlock(block.data() + (size_t)v * BLOCK, BLOCK, start, TICK_STEP);
+        auto t1 = std::chrono::steady_clock::now();
+        seconds += std::chrono::duration<double>(t1 - t0).count();
+
+        memcpy(out.data() + (size_t)b * VOICES * BLOCK, block.data(), block.size() * sizeof(int));
+    }
+    return seconds;
+}
+
+int main(int argc, char **argv)
+{
+    adsrBezierInitTablesFast(4000.0f, ARRAY_SIZE, _curve_tables);
+
+    size_t max_threads = std::thread::hardware_concurrency();
+    if (argc > 1)
+        max_threads = (size_t)atoi(argv[1]);
+    if (max_threads < 1)
+        max_threads = 1;
+
+    std::vector<int> reference, out;
+    double serial = run(nullptr, reference);
+    double audio_seconds = (double)BLOCKS * BLOCK * TICK_STEP / 1e6;
+
+    printf("threads\tms_per_second_of_audio\tvoice_samples_per_sec\tspeedup\tidentical\n");
+    printf("serial\t%.2f\t%.0f\t1.00\tyes\n", serial * 1e3 / audio_seconds, VOICES * BLOCK * BLOCKS / serial);
+
+    for (size_t threads = 1; threads <= max_threads; threads++)
+    {
+        AdsrRenderPool pool(threads);
+        double t = run(&pool, out);
+        bool identical = (out == reference);
+        printf("%zu\t%.2f\t%.0f\t%.2f\t%s\n", threads, t * 1e3 / audio_seconds, VOICES * BLOCK * BLOCKS / t,
+               serial / t, identical ? "yes" : "NO");
+    }
+    return 0;
+}
@@ -0,0 +1,491 @@
+// --------------------------------------------------
+//
+// ADSR Bezier - equivalence test (host)
+//
+// Plays random note and parameter sequences through AdsrBank,
+// AdsrSegmentEnvelope::configureADSR() and AdsrPreset next to one adsr
+// object per voice, and compares every sample with the adsr output. Each
+// trial picks a random patch, then alternates note events, patch changes
+// (stage times through the setters and mod*(), sustain, curves, morphs,
+// reset attack) and renders of one sample (getWave()) or a block
+// (renderBlock(); the bank steps getWave() over the same ticks). Stage times
+// go up to 3 s, so both the Q24 and the Q40 stage scales are covered.
+//
+// Build (from the repository root) once per kernel and table type:
+//   g++ -std=c++11 -O2 -I. extras/tests/ADSR_equivalence.cpp -o adsr_equivalence
+//   g++ -std=c++11 -O2 -msse4.1 -I. extras/tests/ADSR_equivalence.cpp -o adsr_equivalence_sse41
+//   g++ -std=c++11 -O2 -mavx2 -I. extras/tests/ADSR_equivalence.cpp -o adsr_equivalence_avx2
+//   g++ -std=c++11 -O2 -mavx2 -DADSR_BEZIER_TABLE_T=uint8_t -I. extras/tests/ADSR_equivalence.cpp -o adsr_equivalence_u8
+//   g++ -std=c++11 -O2 -mavx2 -DADSR_BEZIER_TABLE_T=uint16_t -I. extras/tests/ADSR_equivalence.cpp -o adsr_equivalence_u16
+//
+// The bank uses the widest kernel the flags allow (scalar without them).
+// Tables are generated for a vertical resolution of 4095, or 255 with
+// uint8_t tables.
+//
+// Options:
+//   --trials N         random sequences (default 50)
+//   --seed N           first seed (default 1); trial k uses seed + k
+//
+// Exit status: 0 when every sample matches, 1 on a mismatch, 2 on errors.
+// The first mismatches and a summary go to stderr.
+//
+// --------------------------------------------------
+
+#include "ADSR_Bezier_Bank.h"
+#include "ADSR_Bezier_Preset.h"
+#include "ADSR_Bezier_Segments.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+#define VOICES 16                                   // two AVX2 lane groups
+#define STEPS 2000                                  // events + renders per trial
+#define BLOCK_MAX 256                               // longest rendered block
+#define REPORT_MAX 10                               // mismatches printed
+
+#if ADSR_BEZIER_USE_MICROS
+#define TICKS_PER_MS 1000UL
+#else
+#define TICKS_PER_MS 1UL
+#endif
+
+struct Options
+{
+    int trials = 50;
+    unsigned long seed = 1;
+};
+
+// Engines under test and their mismatch counts
+enum Engine
+{
+    ENGINE_BANK,
+    ENGINE_SEGMENTS,
+    ENGINE_PRESET,
+    ENGINE_COUNT
+};
+
+static const char *const engine_names[ENGINE_COUNT] = {"AdsrBank", "AdsrSegmentEnvelope", "AdsrPreset"};
+
+static void fail(const char *message, const char *detail = "")
+{
+    fprintf(stderr, "adsr_equivalence: %s%s\n", message, detail);
+    exit(2);
+}
+
+static void usage()
+{
+    fputs("usage: adsr_equivalence [--trials N] [--seed N]\n"
+          "(see the comment at the top of extras/tests/ADSR_equivalence.cpp)\n",
+          stderr);
+    exit(2);
+}
+
+static Options parseOptions(int argc, char **argv)
+{
+    Options o;
+    for (int i = 1; i < argc; i++)
+    {
+        const char *arg = argv[i];
+        auto value = [&]() -> const char * {
+            if (i + 1 >= argc)
+                fail("missing value for ", arg);
+            return argv[++i];
+        };
+
+        if (strcmp(arg, "--trials") == 0)
+            o.trials = atoi(value());
+        else if (strcmp(arg, "--seed") == 0)
+            o.seed = strtoul(value(), nullptr, 10);
+        else
+            usage();
+    }
+
+    if (o.trials < 1)
+        fail("--trials must be at least 1");
+    return o;
+}
+
+// xorshift32: the same sequence on every host
+struct Random
+{
+    uint32_t state;
+
+    explicit Random(unsigned long seed) : state((uint32_t)seed * 2654435761UL + 1) {}
+
+    uint32_t next()
+    {
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        return state;
+    }
+
+    uint32_t below(uint32_t n) { return next() % n; }
+};
+
+static const char *kernelName()
+{
+#if ADSR_BEZIER_BANK_SIMD && defined(__AVX2__)
+    return "avx2";
+#elif ADSR_BEZIER_BANK_SIMD
+    return "sse4.1";
+#else
+    return "scalar";
+#endif
+}
+
+static const char *tableTypeName()
+{
+    return sizeof(adsr_curve_t) == 1 ? "uint8_t" : sizeof(adsr_curve_t) == 2 ? "uint16_t" : "int";
+}
+
+// Stage time in ms: mostly up to 3 s, sometimes 0 or 1 (jump / one-tick stages)
+static unsigned long randomTime(Random &random)
+{
+    if (random.below(8) == 0)
+        return random.below(2);
+    return random.below(3000);
+}
+
+// Every engine for one trial, driven with the same calls
+class Trial
+{
+public:
+    Trial(int vres, Random &random)
+        : _vres(vres), _random(random), _bank(vres, 0, 0, 0), _preset(vres, 0, 0, 0), _times(1.0f, 3000.0f)
+    {
+        for (size_t v = 0; v < VOICES; ++v)
+        {
+            _ref.push_back(adsr(vres, 0.0f, 0.0f, true, 0, 0, 0));
+            _segments.push_back(AdsrSegmentEnvelope<4>(vres));
+        }
+        _states.resize(VOICES);
+
+        // Random patch: the same settings through each engine's own setters
+        unsigned long attack = randomTime(random);
+        unsigned long decay = randomTime(random);
+        unsigned long release = randomTime(random);
+        int sustain = (int)random.below((uint32_t)vres + 1);
+        uint8_t curves[3] = {(uint8_t)random.below(8), (uint8_t)random.below(8), (uint8_t)random.below(8)};
+        bool reset_attack = random.below(2) != 0;
+
+        _preset.setAttack(attack);
+        _preset.setDecay(decay);
+        _preset.setRelease(release);
+        _preset.setSustain(sustain);
+        _preset.adsrCurveAttack(curves[0]);
+        _preset.adsrCurveDecay(curves[1]);
+        _preset.adsrCurveRelease(curves[2]);
+        _preset.setResetAttack(reset_attack);
+        for (size_t v = 0; v < VOICES; ++v)
+        {
+            adsr &env = _ref[v];
+            env.setAttack(attack);
+            env.setDecay(decay);
+            env.setRelease(release);
+            env.setSustain(sustain);
+            env.adsrCurveAttack(curves[0]);
+            env.adsrCurveDecay(curves[1]);
+            env.adsrCurveRelease(curves[2]);
+            env.setResetAttack(reset_attack);
+
+            _bank.setAttack(v, attack);
+            _bank.setDecay(v, decay);
+            _bank.setRelease(v, release);
+            _bank.setSustain(v, sustain);
+            _bank.adsrCurveAttack(v, curves[0]);
+            _bank.adsrCurveDecay(v, curves[1]);
+            _bank.adsrCurveRelease(v, curves[2]);
+            _bank.setResetAttack(v, reset_attack);
+
+            _segments[v].configureADSR(attack, decay, sustain, release, curves[0], curves[1], curves[2]);
+            _segments[v].setResetAttack(reset_attack);
+        }
+    }
+
+    // One random note event or patch change, applied to every engine
+    void event(unsigned long now, unsigned long last)
+    {
+        uint32_t r = _random.below(100);
+        size_t v = _random.below(VOICES);
+
+        if (r < 20)
+        {
+            _ref[v].noteOn(now);
+            _bank.noteOn(v, now);
+            _segments[v].noteOn(now);
+            _preset.noteOn(_states[v], now);
+        }
+        else if (r < 40)
+        {
+            _ref[v].noteOff(now);
+            _bank.noteOff(v, now);
+            _segments[v].noteOff(now);
+            _preset.noteOff(_states[v], now);
+        }
+        else if (r < 52)
+        {
+            // A stage time, set while voices may be running that stage
+            int stage = (int)_random.below(3);
+            unsigned long ms = randomTime(_random);
+            bool mod = _random.below(2) != 0;
+            uint16_t value = (uint16_t)_random.next();
+            _setTime(stage, ms, mod, value, last);
+        }
+        else if (r < 56)
+        {
+            int sustain = (int)_random.below((uint32_t)_vres + 200) - 100;
+            _preset.setSustain(sustain);
+            for (size_t k = 0; k < VOICES; ++k)
+            {
+                _ref[k].setSustain(sustain);
+                _bank.setSustain(k, sustain);
+                _segments[k].setSustainLevel(sustain);
+            }
+        }
+        else if (r < 60)
+        {
+            int stage = (int)_random.below(3);
+            uint8_t from = (uint8_t)_random.below(8);
+            uint8_t to = (uint8_t)_random.below(8);
+            uint16_t amount = _random.below(3) == 0 ? 0 : (uint16_t)_random.next();
+            _setCurve(stage, from, to, amount);
+        }
+        else if (r < 62)
+        {
+            bool reset_attack = _random.below(2) != 0;
+            _preset.setResetAttack(reset_attack);
+            for (size_t k = 0; k < VOICES; ++k)
+            {
+                _ref[k].setResetAttack(reset_attack);
+                _bank.setResetAttack(k, reset_attack);
+                _segments[k].setResetAttack(reset_attack);
+            }
+        }
+    }
+
+    // n samples from start, every tick_step; returns the samples compared per engine
+    unsigned long render(size_t n, unsigned long start, unsigned long tick_step, unsigned long *mismatches)
+    {
+        static int expected[VOICES][BLOCK_MAX];
+        static int out[BLOCK_MAX];
+
+        for (size_t v = 0; v < VOICES; ++v)
+        {
+            if (n == 1)
+                expected[v][0] = _ref[v].getWave(start);
+            else
+                _ref[v].renderBlock(expected[v], n, start, tick_step);
+        }
+
+        for (size_t i = 0; i < n; ++i)
+        {
+            unsigned long now = start + (unsigned long)i * tick_step;
+            const int *levels = _bank.getWave(now);
+            for (size_t v = 0; v < VOICES; ++v)
+                _compare(ENGINE_BANK, v, now, expected[v][i], levels[v], mismatches);
+        }
+
+        for (size_t v = 0; v < VOICES; ++v)
+        {
+            if (n == 1)
+                out[0] = _segments[v].getWave(start);
+            else
+                _segments[v].renderBlock(out, n, start, tick_step);
+            for (size_t i = 0; i < n; ++i)
+                _compare(ENGINE_SEGMENTS, v, start + (unsigned long)i * tick_step, expected[v][i], out[i], mismatches);
+
+            if (n == 1)
+                out[0] = _preset.getWave(_states[v], start);
+            else
+                _preset.renderBlock(_states[v], out, n, start, tick_step);
+            for (size_t i = 0; i < n; ++i)
+                _compare(ENGINE_PRESET, v, start + (unsigned long)i * tick_step, expected[v][i], out[i], mismatches);
+        }
+        return (unsigned long)(n * VOICES);
+    }
+
+private:
+    void _setTime(int stage, unsigned long ms, bool mod, uint16_t value, unsigned long last)
+    {
+        // Segments of configureADSR(): 0 attack, 1 decay, 2 sustain, 3 release
+        static const size_t segment_of_stage[3] = {0, 1, 3};
+        AdsrVoiceState *states = _states.data();
+
+        for (size_t k = 0; k < VOICES; ++k)
+        {
+            if (mod)
+                _segments[k].modTime(segment_of_stage[stage], _times, value);
+            else
+                _segments[k].setTime(segment_of_stage[stage], ms);
+        }
+
+        switch (stage)
+        {
+        case 0:
+            if (mod)
+                _preset.modAttack(_times, value, states, VOICES, last);
+            else
+                _preset.setAttack(ms, states, VOICES, last);
+            for (size_t k = 0; k < VOICES; ++k)
+            {
+                if (mod)
+                {
+                    _ref[k].modAttack(_times, value);
+                    _bank.modAttack(k, _times, value);
+                }
+                else
+                {
+                    _ref[k].setAttack(ms);
+                    _bank.setAttack(k, ms);
+                }
+            }
+            break;
+        case 1:
+            if (mod)
+                _preset.modDecay(_times, value, states, VOICES, last);
+            else
+                _preset.setDecay(ms, states, VOICES, last);
+            for (size_t k = 0; k < VOICES; ++k)
+            {
+                if (mod)
+                {
+                    _ref[k].modDecay(_times, value);
+                    _bank.modDecay(k, _times, value);
+                }
+                else
+                {
+                    _ref[k].setDecay(ms);
+                    _bank.setDecay(k, ms);
+                }
+            }
+            break;
+        default:
+            if (mod)
+                _preset.modRelease(_times, value, states, VOICES, last);
+            else
+                _preset.setRelease(ms, states, VOICES, last);
+            for (size_t k = 0; k < VOICES; ++k)
+            {
+                if (mod)
+                {
+                    _ref[k].modRelease(_times, value);
+                    _bank.modRelease(k, _times, value);
+                }
+                else
+                {
+                    _ref[k].setRelease(ms);
+                    _bank.setRelease(k, ms);
+                }
+            }
+            break;
+        }
+    }
+
+    void _setCurve(int stage, uint8_t from, uint8_t to, uint16_t amount)
+    {
+        static const size_t segment_of_stage[3] = {0, 1, 3};
+
+        switch (stage)
+        {
+        case 0:
+            _preset.adsrCurveAttackMorph(from, to, amount);
+            break;
+        case 1:
+            _preset.adsrCurveDecayMorph(from, to, amount);
+            break;
+        default:
+            _preset.adsrCurveReleaseMorph(from, to, amount);
+            break;
+        }
+
+        for (size_t k = 0; k < VOICES; ++k)
+        {
+            _segments[k].setCurveMorph(segment_of_stage[stage], from, to, amount);
+            switch (stage)
+            {
+            case 0:
+                _ref[k].adsrCurveAttackMorph(from, to, amount);
+                _bank.adsrCurveAttackMorph(k, from, to, amount);
+                break;
+            case 1:
+                _ref[k].adsrCurveDecayMorph(from, to, amount);
+                _bank.adsrCurveDecayMorph(k, from, to, amount);
+                break;
+            default:
+                _ref[k].adsrCurveReleaseMorph(from, to, amount);
+                _bank.adsrCurveReleaseMorph(k, from, to, amount);
+                break;
+            }
+        }
+    }
+
+    void _compare(Engine engine, size_t voice, unsigned long now, int expected, int actual, unsigned long *mismatches)
+    {
+        if (expected == actual)
+            return;
+        if (mismatches[engine]++ < REPORT_MAX)
+            fprintf(stderr, "%s voice %zu tick %lu: adsr %d, got %d\n", engine_names[engine], voice, now, expected, actual);
+    }
+
+    int _vres;
+    Random &_random;
+    std::vector<adsr> _ref;
+    AdsrBank<VOICES> _bank;
+    std::vector<AdsrSegmentEnvelope<4> > _segments;
+    AdsrPreset _preset;
+    std::vector<AdsrVoiceState> _states;
+    AdsrTimeTable<64> _times;
+};
+
+int main(int argc, char **argv)
+{
+    Options options = parseOptions(argc, argv);
+
+#if ADSR_BEZIER_CONSTEXPR_TABLES
+    const int vres = ADSR_BEZIER_TABLE_MAX_VALUE;
+#else
+    const int vres = sizeof(adsr_curve_t) == 1 ? 255 : 4095;
+#endif
+    if (!adsrBezierInitTablesFast((float)vres, ARRAY_SIZE, _curve_tables))
+        fail("cannot generate the curve tables");
+
+    unsigned long mismatches[ENGINE_COUNT] = {};
+    unsigned long samples = 0;
+    for (int trial = 0; trial < options.trials; trial++)
+    {
+        Random random(options.seed + (unsigned long)trial);
+        Trial engines(vres, random);
+
+        // Every other trial starts just before the 32-bit tick wrap
+        unsigned long now = (trial & 1) ? 0xFFFFFFFFUL - 2000UL * TICKS_PER_MS : random.below(1000);
+        unsigned long tick_step = 1 + random.below(ADSR_BEZIER_USE_MICROS ? 100 : 2);
+        bool blocks = random.below(2) != 0;
+        unsigned long last = now;
+
+        for (int step = 0; step < STEPS; step++)
+        {
+            engines.event(now, last);
+            size_t n = blocks ? 1 + random.below(BLOCK_MAX) : 1;
+            samples += engines.render(n, now, tick_step, mismatches);
+            last = now + (unsigned long)(n - 1) * tick_step;
+            now = last + tick_step;
+
+            // Gaps that end stages between two samples
+            if (random.below(4) == 0)
+                now += random.below(1000) * TICKS_PER_MS;
+        }
+    }
+
+    bool ok = true;
+    fprintf(stderr, "adsr_equivalence: %s kernel, %s tables, vres %d, %d trials\n", kernelName(), tableTypeName(), vres,
+            options.trials);
+    for (int e = 0; e < ENGINE_COUNT; e++)
+    {
+        fprintf(stderr, "  %-20s %lu mismatches of %lu samples\n", engine_names[e], mismatches[e], samples);
+        if (mismatches[e] != 0)
+            ok = false;
+    }
+    return ok ? 0 : 1;
+}
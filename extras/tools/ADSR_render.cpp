@@ -0,0 +1,746 @@
+// --------------------------------------------------
+//
+// ADSR Bezier - offline envelope renderer (host)
+//
+// Renders adsr envelopes (tables from adsrBezierInitTables()) driven by a
+// note-event script and streams the result as raw PCM, WAV or CSV, for
+// previewing patches and regression checks without hardware. Output is
+// produced in chunks of --chunk frames: memory use does not grow with the
+// length of the render or of the script, which is read one line at a time.
+//
+// Build (from the repository root):
+//   g++ -std=c++11 -O2 -I. extras/tools/ADSR_render.cpp -o adsr_render
+//
+// Examples:
+//   ./adsr_render -a 10 -d 200 -s 2000 -r 500 --note 400 -o note.wav
+//   ./adsr_render --voices 16 --script song.txt --format csv -o - | less
+//   ./adsr_render --voices 64 --mix --normalize --length 600000 --mmap -o long.raw --script song.txt
+//
+// Options:
+//   -o PATH            output file, "-" for stdout (default)
+//   --format F         raw, wav or csv (default: from the -o extension, else raw)
+//   --bits 16|32       PCM sample size for raw / wav (default 16, little endian)
+//   --normalize        scale 0..vertical resolution to full scale (default: levels as is)
+//   --mix              one channel with the sum of all voices (default: one channel per voice)
+//   --mmap             write raw / wav through a memory-mapped file (needs --length)
+//   --chunk N          frames rendered and written per chunk (default 4096)
+//   --voices N         number of adsr voices (default 1)
+//   --rate HZ          sample rate (default 50000); ticks per sample = timebase / rate
+//   --length MS        render length; default: up to the first frame at or after
+//                      the last script event where no voice is in attack, decay
+//                      or release
+//   --script PATH      note-event script, "-" for stdin (see below)
+//   --note MS          without a script: note on at 0 and off after MS on every voice (default 500)
+//   -a/-d/-r MS        attack, decay, release time (default 100)
+//   -s LEVEL           sustain level (default vertical resolution / 2)
+//   --curves A,D,R     Bezier curve per stage, 0..7 (default 0,0,0)
+//   --vres N           vertical resolution (default 4000)
+//   --exponential      table-free exponential mode instead of Bezier curves
+//   --trace PATH       record voice 0 to a trace file for extras/tools/ADSR_replay.cpp
+//
+// Script: one event per line, in time order, '#' starts a comment:
+//   <time_ms> <event> [voice] [value]
+//   0      on       0
+//   120.5  sustain  0  3000
+//   400    off      0
+// Events: on, off, attack, decay, release (value ms), sustain (value level),
+// reset (0 / 1), curve_a, curve_d, curve_r (0..7). Voice defaults to 0.
+// Each event is applied at its own tick (adsrRenderBlock()), so the output
+// matches calling the adsr methods directly.
+//
+// A summary (frames, voice samples per second) goes to stderr.
+//
+// --------------------------------------------------
+
+#include "ADSR_Bezier_Trace.h"
+#include "ADSR_Bezier_EventQueue.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <algorithm>
+#include <memory>
+#include <new>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#define RENDER_HAVE_MMAP 1
+#else
+#define RENDER_HAVE_MMAP 0
+#endif
+
+#if ADSR_BEZIER_USE_MICROS
+#define TICKS_PER_SECOND 1000000UL
+#else
+#define TICKS_PER_SECOND 1000UL
+#endif
+#define QUEUE_CAPACITY 256                          // pending events per voice and chunk
+#define WAV_HEADER_BYTES 44
+
+typedef AdsrEventQueue<QUEUE_CAPACITY> EventQueue;
+
+enum Format
+{
+    FORMAT_RAW = 0,
+    FORMAT_WAV,
+    FORMAT_CSV
+};
+
+struct Options
+{
+    const char *output = "-";
+    const char *script = nullptr;
+    int format = -1;
+    int bits = 16;
+    bool normalize = false;
+    bool mix = false;
+    bool mmap = false;
+    size_t chunk = 4096;
+    int voices = 1;
+    unsigned long rate = 50000;
+    double length_ms = -1;
+    double note_ms = 500;
+    unsigned long attack_ms = 100;
+    unsigned long decay_ms = 100;
+    unsigned long release_ms = 100;
+    int sustain = -1;
+    int curves[3] = {0, 0, 0};
+    int vres = 4000;
+    bool exponential = false;
+    const char *trace = nullptr;
+};
+
+static void fail(const char *message, const char *detail = "")
+{
+    fprintf(stderr, "adsr_render: %s%s\n", message, detail);
+    exit(1);
+}
+
+static unsigned long msToTicks(double ms)
+{
+    return (unsigned long)(ms * (TICKS_PER_SECOND / 1000.0) + 0.5);
+}
+
+// --------------------------------------------------
+// Event source: the script, read one line at a time, or the --note default
+
+static const struct
+{
+    const char *name;
+    AdsrEventType type;
+    bool value;
+} EVENT_NAMES[] = {
+    {"on", ADSR_EVENT_NOTE_ON, false},
+    {"off", ADSR_EVENT_NOTE_OFF, false},
+    {"attack", ADSR_EVENT_ATTACK, true},
+    {"decay", ADSR_EVENT_DECAY, true},
+    {"sustain", ADSR_EVENT_SUSTAIN, true},
+    {"release", ADSR_EVENT_RELEASE, true},
+    {"reset", ADSR_EVENT_RESET_ATTACK, true},
+    {"curve_a", ADSR_EVENT_CURVE_ATTACK, true},
+    {"curve_d", ADSR_EVENT_CURVE_DECAY, true},
+    {"curve_r", ADSR_EVENT_CURVE_RELEASE, true},
+};
+
+class EventSource
+{
+public:
+    explicit EventSource(const Options &options) : _options(options)
+    {
+        if (options.script == nullptr)
+            return;
+        _file = strcmp(options.script, "-") == 0 ? stdin : fopen(options.script, "r");
+        if (_file == nullptr)
+            fail("cannot open script ", options.script);
+    }
+
+    ~EventSource()
+    {
+        if (_file != nullptr && _file != stdin)
+            fclose(_file);
+    }
+
+    // Next event in tick order; false when there are no more
+    bool next(AdsrEvent &event)
+    {
+        if (_options.script == nullptr)
+            return _nextNote(event);
+
+        char line[256];
+        while (fgets(line, sizeof(line), _file) != nullptr)
+        {
+            _line++;
+            char *comment = strchr(line, '#');
+            if (comment != nullptr)
+                *comment = '\0';
+
+            double ms;
+            char name[16];
+            long voice = 0, value = 0;
+            int fields = sscanf(line, "%lf %15s %ld %ld", &ms, name, &voice, &value);
+            if (fields <= 0)
+                continue; // blank or comment line
+            if (fields < 2 || ms < 0)
+                _error("expected <time_ms> <event> [voice] [value]");
+
+            size_t e = 0;
+            while (e < sizeof(EVENT_NAMES) / sizeof(EVENT_NAMES[0]) && strcmp(EVENT_NAMES[e].name, name) != 0)
+                e++;
+            if (e == sizeof(EVENT_NAMES) / sizeof(EVENT_NAMES[0]))
+                _error("unknown event");
+            if (EVENT_NAMES[e].value && fields < 4)
+                _error("event needs a voice and a value");
+            if (voice < 0 || voice >= _options.voices)
+                _error("voice out of range (see --voices)");
+
+            event.tick = msToTicks(ms);
+            event.type = (uint8_t)EVENT_NAMES[e].type;
+            event.voice = (uint16_t)voice;
+            event.value = (int32_t)value;
+            if (event.tick < _last_tick)
+                _error("events must be in time order");
+            _last_tick = event.tick;
+            return true;
+        }
+        return false;
+    }
+
+private:
+    // No script: note on at 0 on every voice, note off after --note ms
+    bool _nextNote(AdsrEvent &event)
+    {
+        size_t voices = (size_t)_options.voices;
+        if (_generated >= 2 * voices)
+            return false;
+
+        bool off = _generated >= voices;
+        event.tick = off ? msToTicks(_options.note_ms) : 0;
+        event.type = off ? ADSR_EVENT_NOTE_OFF : ADSR_EVENT_NOTE_ON;
+        event.voice = (uint16_t)(_generated % voices);
+        event.value = 0;
+        _generated++;
+        return true;
+    }
+
+    void _error(const char *message)
+    {
+        fprintf(stderr, "adsr_render: %s:%lu: %s\n", _options.script, _line, message);
+        exit(1);
+    }
+
+    const Options &_options;
+    FILE *_file = nullptr;
+    unsigned long _line = 0;
+    unsigned long _last_tick = 0;
+    size_t _generated = 0;
+};
+
+// --------------------------------------------------
+// Output: converts one rendered chunk (voice-major levels) to the output format
+
+static inline void putLE16(uint8_t *p, int32_t v)
+{
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+}
+
+static inline void putLE32(uint8_t *p, int32_t v)
+{
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+    p[2] = (uint8_t)(v >> 16);
+    p[3] = (uint8_t)(v >> 24);
+}
+
+// Decimal digits of v at p, returns the end
+static inline char *putInt(char *p, unsigned long long v, bool negative = false)
+{
+    char digits[24];
+    int n = 0;
+    do
+    {
+        digits[n++] = (char)('0' + v % 10);
+        v /= 10;
+    } while (v != 0);
+    if (negative)
+        *p++ = '-';
+    while (n > 0)
+        *p++ = digits[--n];
+    return p;
+}
+
+class Writer
+{
+public:
+    Writer(const Options &options, unsigned long step, unsigned long long frames)
+        : _options(options), _step(step), _frames(frames)
+    {
+        _channels = options.mix ? 1 : options.voices;
+        _bytes = options.bits / 8;
+        _max = options.bits == 16 && options.format != FORMAT_CSV ? 32767 : 2147483647;
+        _min = -_max - 1;
+        if (options.normalize)
+            _scale_q32 = (((uint64_t)_max << 32) + (uint64_t)options.vres - 1) / (uint64_t)options.vres;
+        else if (options.format != FORMAT_CSV && options.vres > _max)
+            fail("vertical resolution does not fit the sample size (use --bits 32 or --normalize)");
+
+        bool to_stdout = strcmp(options.output, "-") == 0;
+        if (options.mmap)
+        {
+            if (to_stdout || frames == 0 || options.format == FORMAT_CSV)
+                fail("--mmap needs -o PATH, --length and raw or wav output");
+            _openMapped();
+        }
+        else
+        {
+            _file = to_stdout ? stdout : fopen(options.output, "wb");
+            if (_file == nullptr)
+                fail("cannot create ", options.output);
+            if (options.format == FORMAT_CSV)
+                _writeCsvHeader();
+            else if (options.format == FORMAT_WAV)
+                _writeWavHeader(_header, frames);
+            if (options.format == FORMAT_WAV)
+                _put(_header, WAV_HEADER_BYTES);
+        }
+    }
+
+    // n frames of levels[voice * stride + i], first one at start_tick
+    void write(const int *levels, size_t stride, size_t n, unsigned long start_tick)
+    {
+        if (_options.format == FORMAT_CSV)
+        {
+            _writeCsv(levels, stride, n, start_tick);
+            return;
+        }
+
+        size_t bytes = n * (size_t)_channels * (size_t)_bytes;
+        uint8_t *out;
+        if (_map != nullptr)
+        {
+            out = _map + _offset;
+        }
+        else
+        {
+            if (_buffer.size() < bytes)
+                _buffer.resize(bytes);
+            out = _buffer.data();
+        }
+
+        uint8_t *p = out;
+        for (size_t i = 0; i < n; ++i)
+        {
+            for (int c = 0; c < _channels; ++c, p += _bytes)
+            {
+                int32_t v = _sample(levels, stride, i, c);
+                if (_bytes == 2)
+                    putLE16(p, v);
+                else
+                    putLE32(p, v);
+            }
+        }
+
+        if (_map != nullptr)
+            _offset += bytes;
+        else
+            _put(out, bytes);
+        _written += n;
+    }
+
+    // Fixes up the WAV sizes (unknown length) and flushes
+    void close()
+    {
+#if RENDER_HAVE_MMAP
+        if (_map != nullptr)
+        {
+            munmap(_map, _map_bytes);
+            ::close(_fd);
+            _map = nullptr;
+            return;
+        }
+#endif
+        if (_options.format == FORMAT_WAV && _frames != _written)
+        {
+            _writeWavHeader(_header, _written);
+            if (fseek(_file, 0, SEEK_SET) == 0)
+                _put(_header, WAV_HEADER_BYTES);
+            else
+                fprintf(stderr, "adsr_render: output is not seekable, WAV sizes left open\n");
+        }
+        if (fflush(_file) != 0 || ferror(_file))
+            fail("write error on ", _options.output);
+        if (_file != stdout)
+            fclose(_file);
+    }
+
+private:
+    // Output value of channel c at frame i
+    int32_t _sample(const int *levels, size_t stride, size_t i, int c) const
+    {
+        int64_t v = 0;
+        if (_options.mix)
+        {
+            for (int voice = 0; voice < _options.voices; ++voice)
+                v += levels[(size_t)voice * stride + i];
+        }
+        else
+        {
+            v = levels[(size_t)c * stride + i];
+        }
+
+        if (_scale_q32 != 0)
+        {
+            if (v > _options.vres)
+                v = _options.vres; // full scale is one voice at full level
+            v = (int64_t)(((uint64_t)v * _scale_q32) >> 32);
+        }
+        if (v > _max)
+            v = _max;
+        else if (v < _min)
+            v = _min;
+        return (int32_t)v;
+    }
+
+    void _writeCsvHeader()
+    {
+        fputs("frame,tick", _file);
+        if (_options.mix)
+            fputs(",mix", _file);
+        else
+            for (int c = 0; c < _channels; ++c)
+                fprintf(_file, ",voice%d", c);
+        fputc('\n', _file);
+    }
+
+    void _writeCsv(const int *levels, size_t stride, size_t n, unsigned long start_tick)
+    {
+        size_t line_max = 48 + (size_t)_channels * 13;
+        if (_text.size() < n * line_max)
+            _text.resize(n * line_max);
+
+        char *p = _text.data();
+        unsigned long tick = start_tick;
+        for (size_t i = 0; i < n; ++i, tick += _step)
+        {
+            p = putInt(p, _written + i);
+            *p++ = ',';
+            p = putInt(p, tick);
+            for (int c = 0; c < _channels; ++c)
+            {
+                int32_t v = _sample(levels, stride, i, c);
+                *p++ = ',';
+                p = putInt(p, v < 0 ? 0ULL - (unsigned long long)(int64_t)v : (unsigned long long)v, v < 0);
+            }
+            *p++ = '\n';
+        }
+        _put(_text.data(), (size_t)(p - _text.data()));
+        _written += n;
+    }
+
+    // 44-byte PCM header; sizes above 4 GiB are left at the maximum
+    void _writeWavHeader(uint8_t *h, unsigned long long frames) const
+    {
+        unsigned long long data = frames * (unsigned long long)_channels * (unsigned long long)_bytes;
+        if (data > 0xFFFFFFFFULL - 36)
+            data = 0xFFFFFFFFULL - 36;
+        unsigned block = (unsigned)_channels * (unsigned)_bytes;
+
+        memcpy(h, "RIFF", 4);
+        putLE32(h + 4, (int32_t)(uint32_t)(data + 36));
+        memcpy(h + 8, "WAVEfmt ", 8);
+        putLE32(h + 16, 16);
+        putLE16(h + 20, 1); // PCM
+        putLE16(h + 22, _channels);
+        putLE32(h + 24, (int32_t)_options.rate);
+        putLE32(h + 28, (int32_t)(_options.rate * block));
+        putLE16(h + 32, (int32_t)block);
+        putLE16(h + 34, _options.bits);
+        memcpy(h + 36, "data", 4);
+        putLE32(h + 40, (int32_t)(uint32_t)data);
+    }
+
+    void _openMapped()
+    {
+#if RENDER_HAVE_MMAP
+        size_t header = _options.format == FORMAT_WAV ? WAV_HEADER_BYTES : 0;
+        _map_bytes = header + (size_t)_frames * (size_t)_channels * (size_t)_bytes;
+        _fd = open(_options.output, O_RDWR | O_CREAT | O_TRUNC, 0644);
+        if (_fd < 0 || ftruncate(_fd, (off_t)_map_bytes) != 0)
+            fail("cannot create ", _options.output);
+        void *map = ::mmap(nullptr, _map_bytes, PROT_READ | PROT_WRITE, MAP_SHARED, _fd, 0);
+        if (map == MAP_FAILED)
+            fail("cannot map ", _options.output);
+        _map = (uint8_t *)map;
+        madvise(_map, _map_bytes, MADV_SEQUENTIAL);
+        if (header != 0)
+            _writeWavHeader(_map, _frames);
+        _offset = header;
+#else
+        fail("--mmap is not available on this platform");
+#endif
+    }
+
+    void _put(const void *data, size_t bytes)
+    {
+        if (fwrite(data, 1, bytes, _file) != bytes)
+            fail("write error on ", _options.output);
+    }
+
+    const Options &_options;
+    unsigned long _step;
+    unsigned long long _frames; // 0: unknown
+    unsigned long long _written = 0;
+    int _channels;
+    int _bytes;
+    int64_t _max, _min;
+    uint64_t _scale_q32 = 0;
+
+    FILE *_file = nullptr;
+    std::vector<uint8_t> _buffer;
+    std::vector<char> _text;
+    uint8_t _header[WAV_HEADER_BYTES];
+
+    uint8_t *_map = nullptr;
+    size_t _map_bytes = 0;
+    size_t _offset = 0;
+    int _fd = -1;
+};
+
+// --------------------------------------------------
+
+static void usage()
+{
+    fputs("usage: adsr_render [-o PATH] [--format raw|wav|csv] [--bits 16|32] [--normalize] [--mix]\n"
+          "                   [--mmap] [--chunk N] [--voices N] [--rate HZ] [--length MS]\n"
+          "                   [--script PATH | --note MS] [-a MS] [-d MS] [-s LEVEL] [-r MS]\n"
+          "                   [--curves A,D,R] [--vres N] [--exponential] [--trace PATH]\n"
+          "(see the comment at the top of extras/tools/ADSR_render.cpp)\n",
+          stderr);
+    exit(1);
+}
+
+static Options parseOptions(int argc, char **argv)
+{
+    Options o;
+    for (int i = 1; i < argc; i++)
+    {
+        const char *arg = argv[i];
+        auto value = [&]() -> const char * {
+            if (i + 1 >= argc)
+                fail("missing value for ", arg);
+            return argv[++i];
+        };
+
+        if (strcmp(arg, "-o") == 0)
+            o.output = value();
+        else if (strcmp(arg, "--format") == 0)
+        {
+            const char *f = value();
+            o.format = strcmp(f, "raw") == 0 ? FORMAT_RAW : strcmp(f, "wav") == 0 ? FORMAT_WAV : strcmp(f, "csv") == 0 ? FORMAT_CSV : -2;
+            if (o.format == -2)
+                fail("unknown format ", f);
+        }
+        else if (strcmp(arg, "--bits") == 0)
+            o.bits = atoi(value());
+        else if (strcmp(arg, "--normalize") == 0)
+            o.normalize = true;
+        else if (strcmp(arg, "--mix") == 0)
+            o.mix = true;
+        else if (strcmp(arg, "--mmap") == 0)
+            o.mmap = true;
+        else if (strcmp(arg, "--chunk") == 0)
+            o.chunk = (size_t)atol(value());
+        else if (strcmp(arg, "--voices") == 0)
+            o.voices = atoi(value());
+        else if (strcmp(arg, "--rate") == 0)
+            o.rate = strtoul(value(), nullptr, 10);
+        else if (strcmp(arg, "--length") == 0)
+            o.length_ms = atof(value());
+        else if (strcmp(arg, "--script") == 0)
+            o.script = value();
+        else if (strcmp(arg, "--note") == 0)
+            o.note_ms = atof(value());
+        else if (strcmp(arg, "-a") == 0)
+            o.attack_ms = strtoul(value(), nullptr, 10);
+        else if (strcmp(arg, "-d") == 0)
+            o.decay_ms = strtoul(value(), nullptr, 10);
+        else if (strcmp(arg, "-s") == 0)
+            o.sustain = atoi(value());
+        else if (strcmp(arg, "-r") == 0)
+            o.release_ms = strtoul(value(), nullptr, 10);
+        else if (strcmp(arg, "--curves") == 0)
+        {
+            if (sscanf(value(), "%d,%d,%d", &o.curves[0], &o.curves[1], &o.curves[2]) != 3)
+                fail("--curves expects A,D,R");
+        }
+        else if (strcmp(arg, "--vres") == 0)
+            o.vres = atoi(value());
+        else if (strcmp(arg, "--exponential") == 0)
+            o.exponential = true;
+        else if (strcmp(arg, "--trace") == 0)
+            o.trace = value();
+        else
+            usage();
+    }
+
+    if (o.format < 0)
+    {
+        const char *dot = strrchr(o.output, '.');
+        o.format = dot == nullptr ? FORMAT_RAW : strcmp(dot, ".wav") == 0 ? FORMAT_WAV : strcmp(dot, ".csv") == 0 ? FORMAT_CSV : FORMAT_RAW;
+    }
+    if (o.bits != 16 && o.bits != 32)
+        fail("--bits must be 16 or 32");
+    if (o.voices < 1 || o.voices > 65535)
+        fail("--voices must be 1..65535");
+    if (o.rate < 1 || o.rate > TICKS_PER_SECOND)
+        fail("--rate must be between 1 Hz and the timebase rate");
+    if (o.chunk < 1)
+        fail("--chunk must be at least 1");
+    if (o.vres < 1 || o.vres > 65535)
+        fail("--vres must be 1..65535");
+    for (int s = 0; s < 3; s++)
+        if (o.curves[s] < 0 || o.curves[s] > 7)
+            fail("curves must be 0..7");
+    if (o.sustain < 0)
+        o.sustain = o.vres / 2;
+    return o;
+}
+
+int main(int argc, char **argv)
+{
+    Options options = parseOptions(argc, argv);
+
+    // Ticks per sample; rates that do not divide the timebase are rounded
+    unsigned long step = (TICKS_PER_SECOND + options.rate / 2) / options.rate;
+    if (TICKS_PER_SECOND % options.rate != 0)
+        fprintf(stderr, "adsr_render: %lu Hz is rendered at %lu ticks per sample (%.1f Hz)\n",
+                options.rate, step, (double)TICKS_PER_SECOND / step);
+
+    unsigned long long frames = 0;
+    if (options.length_ms >= 0)
+    {
+        frames = (msToTicks(options.length_ms) + step - 1) / step;
+        if (frames == 0)
+            fail("--length is shorter than one sample");
+    }
+
+#if !ADSR_BEZIER_EXP_ONLY
+    if (!adsrBezierInitTables((float)options.vres, ARRAY_SIZE, _curve_tables))
+        fprintf(stderr, "adsr_render: the compile-time tables were built for maxVal %d, not --vres %d\n",
+                ADSR_BEZIER_TABLE_MAX_VALUE, options.vres);
+#endif
+
+    std::vector<adsr> voices;
+    voices.reserve((size_t)options.voices);
+    for (int v = 0; v < options.voices; v++)
+    {
+        voices.push_back(adsr(options.vres, 0.997f, 0.997f, true,
+                              options.curves[0], options.curves[1], options.curves[2], options.exponential));
+        voices.back().setAttack(options.attack_ms);
+        voices.back().setDecay(options.decay_ms);
+        voices.back().setSustain(options.sustain);
+        voices.back().setRelease(options.release_ms);
+    }
+    FILE *trace_file = nullptr;
+    std::unique_ptr<AdsrTraceFile> trace;
+    if (options.trace != nullptr)
+    {
+        trace_file = fopen(options.trace, "wb");
+        if (trace_file == nullptr)
+            fail("cannot open ", options.trace);
+        trace.reset(new AdsrTraceFile(trace_file));
+        voices[0].setTrace(trace.get());
+    }
+    // One queue per voice. new[] ignores their cache-line alignment before C++17,
+    // so they are placed in an over-allocated buffer.
+    std::vector<uint8_t> queue_storage(sizeof(EventQueue) * (size_t)options.voices + alignof(EventQueue));
+    EventQueue *queues = (EventQueue *)(((uintptr_t)queue_storage.data() + alignof(EventQueue) - 1) & ~(uintptr_t)(alignof(EventQueue) - 1));
+    for (int v = 0; v < options.voices; v++)
+        new (&queues[v]) EventQueue();
+
+    EventSource source(options);
+    Writer writer(options, step, frames);
+    std::vector<int> levels((size_t)options.voices * options.chunk);
+
+    AdsrEvent event;
+    bool pending = source.next(event);
+    unsigned long long frame = 0;
+    auto t0 = std::chrono::steady_clock::now();
+
+    unsigned long last_event = 0;
+    while (frames == 0 || frame < frames)
+    {
+        size_t n = options.chunk;
+        if (frames != 0 && frames - frame < n)
+            n = (size_t)(frames - frame);
+        unsigned long start = (unsigned long)(frame * step);
+
+        // Without --length: after the script's last event and the end of the
+        // last attack, decay or release, the output is constant. The frame at
+        // or after the later of the two is the last one written.
+        if (frames == 0 && !pending)
+        {
+            bool settled = true;
+            unsigned long end = last_event, tick;
+            for (int v = 0; v < options.voices; v++)
+            {
+                if (voices[v].nextChange(tick))
+                {
+                    settled = false;
+                    if ((long)(tick - end) > 0)
+                        end = tick;
+                }
+            }
+            if ((long)(end - start) >= 0)
+                n = (size_t)std::min<unsigned long>(n, (end - start + step - 1) / step + 1);
+            else if (settled)
+                break;
+        }
+
+        // Queue the events that fall in this chunk. A full queue ends the chunk
+        // before that event, so the script is never read further ahead than that.
+        while (pending && event.tick < start + (unsigned long)n * step)
+        {
+            EventQueue &queue = queues[event.voice];
+            if (!queue.push(event))
+            {
+                if (event.tick > start)
+                {
+                    n = (size_t)((event.tick - start + step - 1) / step);
+                    break;
+                }
+                // All queued events are due now: apply them and make room
+                adsr &env = voices[event.voice];
+                queue.drainUntil(start, [&env](const AdsrEvent &e) { adsrApplyEvent(env, e); });
+                queue.push(event);
+            }
+            last_event = event.tick;
+            pending = source.next(event);
+        }
+        if (frames == 0 && !pending && (long)(last_event - start) >= 0)
+            n = (size_t)std::min<unsigned long>(n, (last_event - start + step - 1) / step + 1);
+
+        for (int v = 0; v < options.voices; v++)
+            adsrRenderBlock(queues[v], voices[v], levels.data() + (size_t)v * options.chunk, n, start, step);
+
+        writer.write(levels.data(), options.chunk, n, start);
+        frame += n;
+    }
+    writer.close();
+    if (trace_file != nullptr)
+    {
+        if (!trace->ok() || fclose(trace_file) != 0)
+            fail("cannot write ", options.trace);
+        fprintf(stderr, "adsr_render: %lu trace records in %s\n", trace->written(), options.trace);
+    }
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+    double samples = (double)frame * options.voices;
+    fprintf(stderr, "adsr_render: %llu frames x %d voices (%.3f s of audio) in %.3f s, %.1f M voice samples/s\n",
+            frame, options.voices, (double)frame * step / TICKS_PER_SECOND, seconds,
+            seconds > 0 ? samples / seconds / 1e6 : 0.0);
+    return 0;
+}
@@ -0,0 +1,196 @@
+// --------------------------------------------------
+//
+// ADSR Bezier - trace replay (host)
+//
+// Runs a trace recorded with adsr::setTrace() (an AdsrTraceFile,
+// adsr_render --trace, or an AdsrTraceRing dumped raw from a target) against
+// the adsr of this build and reports the first output, block or keyframe
+// that differs from the recording. Build it with the changes and -D options
+// under test: a trace recorded before a change then shows whether and where
+// the change moves the envelope, and with git bisect run the commit that did.
+//
+// Build (from the repository root):
+//   g++ -std=c++11 -O2 -I. extras/tools/ADSR_replay.cpp -o adsr_replay
+//
+// Examples:
+//   ./adsr_render --script song.txt --trace song.trc -o /dev/null
+//   ./adsr_replay song.trc
+//   ./adsr_replay --repeat 50 song.trc              (replay speed)
+//   git bisect run sh -c 'g++ -std=c++11 -O2 -I. extras/tools/ADSR_replay.cpp -o /tmp/adsr_replay && /tmp/adsr_replay song.trc'
+//
+// Options:
+//   --repeat N         replay N times and report the best time (default 1)
+//   --context N        records printed before a divergence (default 8)
+//   --vres N           generate the built-in curves for vertical resolution N
+//                      (default: that of the trace's first keyframe)
+//
+// Traces with external curve tables (adsrCurve*Table()) replay up to the
+// first one: the tool knows only the built-in curves.
+//
+// Exit status: 0 when the replay matches, 1 at a divergence, 2 on errors.
+// A summary (records, samples per second) goes to stderr.
+//
+// --------------------------------------------------
+
+#include "ADSR_Bezier_Trace.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <vector>
+
+#if ADSR_BEZIER_USE_MICROS
+#define TICKS_PER_SECOND 1000000UL
+#else
+#define TICKS_PER_SECOND 1000UL
+#endif
+
+struct Options
+{
+    const char *input = nullptr;
+    int repeat = 1;
+    int context = 8;
+    int vres = -1;
+};
+
+static void fail(const char *message, const char *detail = "")
+{
+    fprintf(stderr, "adsr_replay: %s%s\n", message, detail);
+    exit(2);
+}
+
+static void usage()
+{
+    fputs("usage: adsr_replay [--repeat N] [--context N] [--vres N] TRACE\n"
+          "(see the comment at the top of extras/tools/ADSR_replay.cpp)\n",
+          stderr);
+    exit(2);
+}
+
+static Options parseOptions(int argc, char **argv)
+{
+    Options o;
+    for (int i = 1; i < argc; i++)
+    {
+        const char *arg = argv[i];
+        auto value = [&]() -> const char * {
+            if (i + 1 >= argc)
+                fail("missing value for ", arg);
+            return argv[++i];
+        };
+
+        if (strcmp(arg, "--repeat") == 0)
+            o.repeat = atoi(value());
+        else if (strcmp(arg, "--context") == 0)
+            o.context = atoi(value());
+        else if (strcmp(arg, "--vres") == 0)
+            o.vres = atoi(value());
+        else if ((arg[0] == '-' && arg[1] != '\0') || o.input != nullptr)
+            usage();
+        else
+            o.input = arg;
+    }
+
+    if (o.input == nullptr)
+        usage();
+    if (o.repeat < 1)
+        fail("--repeat must be at least 1");
+    if (o.context < 0)
+        fail("--context must not be negative");
+    return o;
+}
+
+static const char *opName(uint8_t op)
+{
+    static const char *const names[] = {
+        "?", "note_on", "note_off", "get_wave", "block", "tick", "stage", "stage_scale", "sustain",
+        "curve", "morph", "reset_attack", "tick_rate", "key_begin", "key_exp", "key_state",
+        "key_levels", "key_tick_acc", "key_exp_state", "key_end"};
+    return op < sizeof(names) / sizeof(names[0]) ? names[op] : "?";
+}
+
+static void printRecord(size_t index, const AdsrTraceRecord &r, const char *mark)
+{
+    fprintf(stderr, "%s %8zu  %-13s sub %3u  n %5u  tick %10lu  a %10lu  b %10lu\n", mark, index, opName(r.op),
+            (unsigned)r.sub, (unsigned)r.n, (unsigned long)r.tick, (unsigned long)r.a, (unsigned long)r.b);
+}
+
+int main(int argc, char **argv)
+{
+    Options options = parseOptions(argc, argv);
+
+    FILE *file = strcmp(options.input, "-") == 0 ? stdin : fopen(options.input, "rb");
+    if (file == nullptr)
+        fail("cannot open ", options.input);
+    std::vector<AdsrTraceRecord> records;
+    AdsrTraceFileHeader header;
+    if (!adsrTraceRead(file, records, &header))
+        fail("cannot read a trace from ", options.input);
+    if (file != stdin)
+        fclose(file);
+
+    if (header.ticks_per_second != 0 && header.ticks_per_second != TICKS_PER_SECOND)
+        fprintf(stderr, "adsr_replay: recorded at %lu ticks per second, this build has %lu\n",
+                (unsigned long)header.ticks_per_second, TICKS_PER_SECOND);
+    if (header.array_size != 0 && header.array_size != ARRAY_SIZE)
+        fprintf(stderr, "adsr_replay: recorded with %lu-entry tables, this build has %lu\n",
+                (unsigned long)header.array_size, (unsigned long)ARRAY_SIZE);
+
+#if !ADSR_BEZIER_EXP_ONLY
+    int vres = options.vres;
+    for (size_t i = 0; vres < 0 && i < records.size(); ++i)
+        if (records[i].op == ADSR_TRACE_KEY_BEGIN)
+            vres = (int)records[i].a;
+    if (vres > 0 && !adsrBezierInitTables((float)vres, ARRAY_SIZE, _curve_tables))
+        fprintf(stderr, "adsr_replay: the compile-time tables were built for maxVal %d, not %d\n",
+                ADSR_BEZIER_TABLE_MAX_VALUE, vres);
+#endif
+
+    AdsrTraceReplay replay;
+    AdsrTraceResult result = ADSR_TRACE_MATCH;
+    double best = 0;
+    for (int r = 0; r < options.repeat; r++)
+    {
+        auto t0 = std::chrono::steady_clock::now();
+        result = replay.run(records);
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+        if (r == 0 || seconds < best)
+            best = seconds;
+        if (result != ADSR_TRACE_MATCH)
+            break;
+    }
+
+    switch (result)
+    {
+    case ADSR_TRACE_MATCH:
+        break;
+    case ADSR_TRACE_NO_KEYFRAME:
+        fail("no complete keyframe to start from in ", options.input);
+        break;
+    case ADSR_TRACE_UNRESOLVED_TABLE:
+    case ADSR_TRACE_BAD_RECORD:
+    case ADSR_TRACE_DIVERGED:
+    {
+        const AdsrTraceDivergence &d = replay.divergence();
+        if (result == ADSR_TRACE_DIVERGED)
+            fprintf(stderr, "adsr_replay: diverged at record %zu (%s, tick %lu): recorded %lu (0x%08lx), replayed %lu (0x%08lx)\n",
+                    d.record, opName(d.op), (unsigned long)d.tick, (unsigned long)d.expected, (unsigned long)d.expected,
+                    (unsigned long)d.actual, (unsigned long)d.actual);
+        else
+            fprintf(stderr, "adsr_replay: %s at record %zu\n",
+                    result == ADSR_TRACE_BAD_RECORD ? "bad record" : "external curve table", d.record);
+
+        size_t first = d.record > (size_t)options.context ? d.record - (size_t)options.context : 0;
+        if (first < replay.start())
+            first = replay.start();
+        for (size_t i = first; i <= d.record && i < records.size(); i++)
+            printRecord(i, records[i], i == d.record ? ">" : " ");
+        break;
+    }
+    }
+
+    fprintf(stderr, "adsr_replay: %zu records from #%zu, %llu samples in %.3f ms, %.2f M records/s, %.1f M samples/s\n",
+            replay.replayed(), replay.start(), replay.samples(), best * 1e3,
+            best > 0 ? replay.replayed() / best / 1e6 : 0.0, best > 0 ? replay.samples() / best / 1e6 : 0.0);
+    return result == ADSR_TRACE_MATCH ? 0 : result == ADSR_TRACE_DIVERGED ? 1 : 2;
+}